@@ -103,8 +103,8 @@ char *basefilename(char *filename){
 int main (int argc, char **argv) {
 
 
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " problemfile scale {CHAIN, POP_TABU, POP_CHAIN, POP_TABU_CHAIN}" << std::endl;
+    if (argc != 4 && argc != 5) {
+        std::cerr << "Usage: " << argv[0] << " problemfile scale {CHAIN, POP_TABU, POP_CHAIN, POP_TABU_CHAIN, BRANCH_AND_BOUND} [time budget (s)]" << std::endl;
         return -1;
     }
 
@@ -116,6 +116,8 @@ int main (int argc, char **argv) {
 
     double scale = strtod (argv[2], NULL);
 
+    double timeBudget = (argc == 5 ? strtod (argv[4], NULL) : -1);
+
     std::filebuf fb;
     fb.open (filename, std::ios::in);
     std::istream is (&fb);
@@ -137,6 +139,8 @@ int main (int argc, char **argv) {
         method = pal::POPMUSIC_CHAIN;
     } else if (strcmp (methodString, "CHAIN") == 0) {
         method = pal::CHAIN;
+    } else if (strcmp (methodString, "BRANCH_AND_BOUND") == 0) {
+        method = pal::BRANCH_AND_BOUND;
     } else {
         std::cerr << "Unknown search method..." << std::endl;
         exit (-1);
@@ -339,7 +343,7 @@ int main (int argc, char **argv) {
 
     std::cerr << basename << "\t";
 
-    std::list<pal::Label*> * labels = pal->labeller (scale, bbox, &stats, false);
+    std::list<pal::Label*> * labels = pal->labeller (scale, bbox, &stats, false, timeBudget);
 
     while (labels->size()>0){
         delete labels->front();
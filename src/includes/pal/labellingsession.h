@@ -0,0 +1,195 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _LABELLINGSESSION_H
+#define _LABELLINGSESSION_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <pal/pal.h>
+
+namespace pal {
+
+    class Feature;
+    class Problem;
+    struct _sessionfeat;
+    struct _sessionlabel;
+
+    /**
+     * \brief successive labellings of a moving map extent
+     *
+     * A session remembers the label retained for each feature by the
+     * previous call to labeller(). On the next call, features which left
+     * the extent are forgotten and the search starts from the previous
+     * labels: clusters of features whose labels are still valid are not
+     * optimized again. Candidates of features which are not clipped by the
+     * extent come from Pal's candidates cache, so only entering features
+     * and features crossing the border get new ones.
+     *
+     * A zoom starts a new solution. The session must be deleted before its
+     * Pal object and must not be used concurrently.
+     *
+     * The labels of another labelling, such as the previous frame of an
+     * animation whose features are registered again at each frame, can be
+     * given with setPreviousLabels().
+     */
+    class LabellingSession {
+
+        friend class Pal;
+
+    private:
+        Pal *pal;
+
+        /**
+         * features of the last labelling
+         */
+        std::map<Feature*, struct _sessionfeat*> *feats;
+
+        /**
+         * scale of the last labelling
+         */
+        double scale;
+        int layersGeneration;
+
+        long cacheHits;
+        int nbReused;
+        int nbWarm;
+
+        /**
+         * labels given by setPreviousLabels(), by layer name and feature id
+         */
+        std::map<std::pair<std::string, std::string>, struct _sessionlabel*> *labels;
+
+        /**
+         * \brief forget everything if the previous labelling can't be reused
+         * Called by Pal::labeller before extracting the problem. A pan keeps
+         * the session: features are tracked one by one (see see())
+         */
+        void begin (double scale);
+
+        /**
+         * \brief the feature is in the current problem
+         */
+        void see (Feature *feat);
+
+        /**
+         * \brief set the initial solution of prob from the previous labels
+         */
+        void warmStart (Problem *prob);
+
+        /**
+         * \brief remember the solution of prob and forget features which left the extent
+         */
+        void end (Problem *prob);
+
+        void clear ();
+
+        void clearLabels ();
+
+        /**
+         * \brief candidate of feature i of prob nearest to the given labels
+         * @return the candidate, -1 if the label would move too far
+         */
+        int nearestCandidate (Problem *prob, int i, struct _sessionlabel *sl);
+
+    public:
+        /**
+         * \brief create a new session
+         * @param pal the labelling engine
+         */
+        LabellingSession (Pal *pal);
+
+        ~LabellingSession();
+
+        /**
+         * \brief label all active layers, reusing the previous labelling
+         *
+         * @param scale map scale is 1:scale
+         * @param bbox map extent
+         * @param stats A PalStat object (can be NULL)
+         * @param displayAll if true, all feature will be labelled evan though overlaps occurs
+         * @param timeBudget wall-clock time allowed to the call [s], negative for no limit
+         *
+         * @return A list of label to display on map
+         */
+        std::list<Label*> *labeller (double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget = -1);
+
+        /**
+         * \brief label given layers, reusing the previous labelling
+         *
+         * @param nbLayers # layers
+         * @param layersName names of layers to label
+         * @param layersFactor layers priorities array
+         * @param scale map scale is  '1:scale'
+         * @param bbox map extent
+         * @param stats will be filled with labelling process statistics, can be NULL
+         * @param displayAll if true, all feature will be labelled evan though overlaps occurs
+         * @param timeBudget wall-clock time allowed to the call [s], negative for no limit
+         *
+         * @return A list of label to display on map
+         */
+        std::list<Label*> *labeller (int nbLayers, char **layersName, double *layersFactor,
+                                     double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget = -1);
+
+        /**
+         * \brief start the next labelling from the given labels
+         *
+         * Features are matched by layer name and id. Each one starts with
+         * its candidate nearest to its label, unless the label would move by
+         * more than half its width. Other features of the layers of the
+         * labels are taken as hidden. These labels are used by the next call
+         * to labeller() only, in place of the ones the session remembers for
+         * the same features, whatever the scale.
+         *
+         * @param previousLabels labels of another labelling, can be deleted once the call returns
+         */
+        void setPreviousLabels (std::list<Label*> *previousLabels);
+
+        /**
+         * \brief forget the previous labelling
+         */
+        void reset ();
+
+        /**
+         * \brief # features whose candidates were found in the cache by the last labelling
+         */
+        int getNbReusedFeatures ();
+
+        /**
+         * \brief # features the last labelling started with their previous label
+         */
+        int getNbWarmFeatures ();
+    };
+
+} // end namespace pal
+
+#endif
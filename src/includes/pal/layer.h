@@ -43,11 +43,13 @@ namespace pal {
     template <class Type> class Cell;
     template <typename Data> class HashTable;
 
-    template<class DATATYPE, class ELEMTYPE, int NUMDIMS, class ELEMTYPEREAL, int TMAXNODES, int TMINNODES> class RTree;
+    class RTreePool;
+    template<class DATATYPE, class ELEMTYPE, int NUMDIMS, class ELEMTYPEREAL, int TMAXNODES, int TMINNODES, class ALLOCATOR> class RTree;
 
     class Feature;
     class Pal;
     class SimpleMutex;
+    class MappedFile;
 
     struct Feat;
 
@@ -66,6 +68,7 @@ namespace pal {
 
         friend class LabelPosition;
         friend bool extractFeatCallback (Feature *ft_ptr, void *ctx);
+        friend void generateCandidatesJob (int job, int thread, void *ctx);
         friend bool pruneLabelPositionCallback (LabelPosition *lp, void *ctx);
         friend bool obstacleCallback (PointSet *feat, void *ctx);
         friend void toSVGPath (int nbPoints, double *x, double *y, int dpi, Layer *layer, int type, char *uid, std::ostream &out, double scale, Units unit, int xmin, int xmax, int ymax, bool exportInfo, char *color);
@@ -93,11 +96,16 @@ namespace pal {
         Arrangement arrangement;
 
         // indexes (spatial and id)
-        RTree<Feature*, double, 2, double, 8, 4> *rtree;
+        RTree<Feature*, double, 2, double, 8, 4, RTreePool> *rtree;
         HashTable<Cell<Feature*>*> *hashtable;
 
         SimpleMutex *modMutex;
 
+        /**
+         * \brief snapshot the layer was loaded from (NULL if none)
+         */
+        MappedFile *snapshot;
+
         /**
          * \brief Create a new layer
          *
@@ -127,6 +135,24 @@ namespace pal {
          */
         Cell<Feature*> *getFeatureIt (const char * geom_id);
 
+        /**
+         * \brief forget cached candidates of all features (layer settings have changed)
+         */
+        void invalidateCandidates ();
+
+        /**
+         * \brief fill the layer with the features of a snapshot
+         *
+         * The layer takes ownership of file.
+         * @param file mapped snapshot, its header has been checked
+         * @param getGeometry see Pal::loadLayer()
+         * @param ctx given to getGeometry
+         *
+         * @throws PalException::InvalidSnapshot
+         * @throws PalException::UnknownFeature
+         */
+        void loadSnapshot (MappedFile *file, PalGeometry * (*getGeometry) (const char *geom_id, void *ctx), void *ctx);
+
         /**
          * \brief check if the scal is in the scale range min_scale -> max_scale
          * @param scale the scale to check
@@ -274,6 +300,22 @@ namespace pal {
          */
         void registerFeature (const char *geom_id, PalGeometry *userGeom, double label_x =-1, double label_y = -1);
 
+        /**
+         * \brief save features of the layer in a snapshot file, to be loaded by Pal::loadLayer()
+         *
+         * The snapshot holds layer settings, features ids, bounding boxes, label
+         * sizes, distlabels, parts, the spatial index and optionally the
+         * coordinates. Loading a snapshot is much faster than registering
+         * features again.
+         *
+         * @param fileName file to write
+         * @param withCoordinates save coordinates too, loaded features then
+         * don't need their PalGeometry to be labelled
+         *
+         * @throws PalException::InvalidSnapshot if the file can't be written
+         */
+        void saveSnapshot (const char *fileName, bool withCoordinates = true);
+
         // TODO implement
         //void unregisterFeature (const char *geom_id);
 
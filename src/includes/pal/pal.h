@@ -33,6 +33,7 @@
 #include <pal/label.h>
 #include <pal/palstat.h>
 
+#include <cstddef>
 #include <list>
 #include <iostream>
 #include <ctime>
@@ -57,6 +58,9 @@ namespace pal {
     class Problem;
     class PointSet;
     class SimpleMutex;
+    class CoordCache;
+    class CandidateCache;
+    class LabellingSession;
 
     /** Units for label sizes and distlabel */
     enum _Units {
@@ -74,7 +78,8 @@ namespace pal {
         CHAIN = 0, /**< is the worst but fastest method */
         POPMUSIC_TABU_CHAIN = 1, /**< is the best but slowest */
         POPMUSIC_TABU = 2, /**< is a little bit better than CHAIN but slower*/
-        POPMUSIC_CHAIN = 3 /**< is slower and best than TABU, worse and faster than TABU_CHAIN */
+        POPMUSIC_CHAIN = 3, /**< is slower and best than TABU, worse and faster than TABU_CHAIN */
+        BRANCH_AND_BOUND = 4 /**< solves every component exactly, CHAIN for the components too large */
     };
 
     /** Typedef for _Units enumeration */
@@ -110,15 +115,14 @@ namespace pal {
         friend class Layer;
         friend class LabelPosition;
         friend class PointSet;
+        friend class LabellingSession;
         friend bool pruneLabelPositionCallback (LabelPosition *lp, void *ctx);
+        friend class ExactSearchTest;
     private:
         std::list<Layer*> * layers;
 
         SimpleMutex *lyrsMutex;
 
-        // TODO remove after tests !!!
-        clock_t tmpTime;
-
         Units map_unit;
 
         /**
@@ -148,10 +152,55 @@ namespace pal {
 
         int dpi;
 
+        /**
+         * \brief largest move of a simplified vertex [px]
+         */
+        double simplifyTolerance;
+
         int ejChainDeg;
         int tenure;
         double candListSize;
 
+        /**
+         * \brief # threads used to generate candidates
+         */
+        int nbThreads;
+
+        /**
+         * \brief # independent searches of the multi-start mode (1 : plain search)
+         */
+        int nbStarts;
+
+        /**
+         * \brief # features of the largest component solved exactly
+         */
+        int exactSearchSize;
+
+        /**
+         * \brief the solution does not depend on the number of threads
+         */
+        bool deterministic;
+
+        /**
+         * \brief seed of the random perturbations of the search
+         */
+        unsigned int seed;
+
+        /**
+         * \brief features coordinates, kept between two labelling
+         */
+        CoordCache *coordCache;
+
+        /**
+         * \brief features candidates, kept between two labelling
+         */
+        CandidateCache *candidateCache;
+
+        /**
+         * \brief incremented each time a layer is removed
+         */
+        int layersGeneration;
+
         /**
          * \brief Problem factory
          * Extract features to label and generates candidates for them,
@@ -166,11 +215,33 @@ namespace pal {
          * @param phi_max yMax bounding-box
          * @param scale the scale (1:scale)
          * @param svgmap stream to wrtie the svg map (need _EXPORT_MAP_ #defined to work)
+         * @param session reuse candidates of the previous labelling (can be NULL)
          */
         Problem* extract (int nbLayers, char **layersName, double *layersFactor,
                           double lambda_min, double phi_min,
                           double lambda_max, double phi_max,
-                          double scale, std::ofstream *svgmap);
+                          double scale, std::ofstream *svgmap,
+                          LabellingSession *session);
+
+        /**
+         * \brief the labeling machine, within a labelling session
+         * @see labeller (double, double[4], PalStat**, bool)
+         */
+        std::list<Label*> *labeller (double scale, double bbox[4], PalStat **stats, bool displayAll,
+                                     LabellingSession *session, double timeBudget);
+
+        /**
+         * \brief the labeling machine, within a labelling session
+         * @see labeller (int, char**, double*, double, double[4], PalStat**, bool)
+         */
+        std::list<Label*> *labeller (int nbLayers,
+                                     char **layersName,
+                                     double *layersFactor,
+                                     double scale, double bbox[4],
+                                     PalStat **stat,
+                                     bool displayAll,
+                                     LabellingSession *session,
+                                     double timeBudget);
 
 
         /**
@@ -255,6 +326,28 @@ namespace pal {
          */
         Layer * addLayer (const char *lyrName, double min_scale, double max_scale, Arrangement arrangement, Units label_unit, double defaultPriority, bool obstacle, bool active, bool toLabel);
 
+        /**
+         * \brief add a layer saved by Layer::saveSnapshot()
+         *
+         * The snapshot file is mapped in memory and used in place as long as
+         * the layer lives: it must not be changed or removed meanwhile.
+         *
+         * Loaded features need a PalGeometry to be labelled when coordinates
+         * were not saved, and labels of features without PalGeometry have no
+         * geometry (see Label::getGeometry()).
+         *
+         * @param fileName snapshot file
+         * @param getGeometry called once per feature id to get its geometry, can be NULL
+         * @param ctx given to getGeometry
+         *
+         * @throws PalException::LayerExists
+         * @throws PalException::InvalidSnapshot if the file can't be read or was not written by this version of Pal
+         * @throws PalException::UnknownFeature if coordinates were not saved and getGeometry gives no geometry for a feature
+         *
+         * @return the new layer
+         */
+        Layer * loadLayer (const char *fileName, PalGeometry * (*getGeometry) (const char *geom_id, void *ctx) = NULL, void *ctx = NULL);
+
         /**
          * \brief Look for a layer
          *
@@ -288,10 +381,12 @@ namespace pal {
          * @param bbox map extent
          * @param stats A PalStat object (can be NULL)
          * @param displayAll if true, all feature will be labelled evan though overlaps occurs
+         * @param timeBudget wall-clock time allowed to the call [s], negative for no limit.
+         * The initial solution is always computed, then improved until the budget is spent
          *
          * @return A list of label to display on map
          */
-        std::list<Label*> *labeller (double scale, double bbox[4], PalStat **stats, bool displayAll);
+        std::list<Label*> *labeller (double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget = -1);
 
 
         /**
@@ -306,6 +401,8 @@ namespace pal {
          * @param bbox map extent
          * @param stat will be filled with labelling process statistics, can be NULL
          * @param displayAll if true, all feature will be labelled evan though overlaps occurs
+         * @param timeBudget wall-clock time allowed to the call [s], negative for no limit.
+         * The initial solution is always computed, then improved until the budget is spent
          *
          * @todo UnknownLayer will be ignored ? should throw exception or not ???
          *
@@ -316,7 +413,8 @@ namespace pal {
                                      double *layersFactor,
                                      double scale, double bbox[4],
                                      PalStat **stat,
-                                     bool displayAll);
+                                     bool displayAll,
+                                     double timeBudget = -1);
 
         /**
          * \brief Set map resolution
@@ -332,6 +430,25 @@ namespace pal {
          */
         int getDpi ();
 
+        /**
+         * \brief Set the tolerance of the geometries simplification
+         *
+         * Lines and polygons are simplified (Douglas-Peucker) before their
+         * candidates are generated and before obstacles are tested against
+         * candidates. Simplified geometries are kept for the next labellings
+         * at a close scale. Default is 0.5 pixel.
+         *
+         * @param tolerance largest move of a vertex [px], 0 to disable the simplification
+         */
+        void setSimplifyTolerance (double tolerance);
+
+        /**
+         * \brief get the tolerance of the geometries simplification
+         *
+         * @return tolerance [px]
+         */
+        double getSimplifyTolerance ();
+
 
 
         /**
@@ -399,6 +516,158 @@ namespace pal {
          * @return the search method
          */
         SearchMethod getSearch();
+
+        /**
+         * \brief Set the number of threads used to generate candidates
+         *
+         * With more than one thread, PalGeometry::getGeosGeometry() and
+         * PalGeometry::releaseGeosGeometry() may be called concurrently
+         * for distinct geometries, never for the same one (even for parts
+         * of a multi-geometry). The result does not depend on the number
+         * of threads.
+         *
+         * @param nbThreads # threads (1 to disable multi-threading)
+         */
+        void setNbThreads (int nbThreads);
+
+        /**
+         * \brief get the number of threads used to generate candidates
+         *
+         * @return # threads
+         */
+        int getNbThreads ();
+
+        /**
+         * \brief Set the number of independent searches run by labeller()
+         *
+         * With more than one start, the search is run nbStarts times on
+         * Pal's threads. The first start is the plain search, the others
+         * begin from a perturbed initial solution and optimize the problem
+         * parts in another order. The lowest cost solution is retained.
+         *
+         * @param nbStarts # starts (1 to disable the multi-start search)
+         */
+        void setNbStarts (int nbStarts);
+
+        /**
+         * \brief get the number of independent searches run by labeller()
+         *
+         * @return # starts
+         */
+        int getNbStarts ();
+
+        /**
+         * \brief Set the size of the components solved exactly
+         *
+         * Connected components of the conflict graph with at most size
+         * features are solved by branch and bound before the search, which
+         * then leaves them alone. A component whose search tree is too large
+         * is still improved by the search. BRANCH_AND_BOUND solves every
+         * component this way. Default is 20.
+         *
+         * @param size # features of the largest component (below 2 to disable)
+         */
+        void setExactSearchSize (int size);
+
+        /**
+         * \brief get the size of the components solved exactly
+         *
+         * @return # features
+         */
+        int getExactSearchSize ();
+
+        /**
+         * \brief Make labeller() results independent of the number of threads
+         *
+         * In deterministic mode, POPMUSIC sub parts are optimized by rounds
+         * of sub parts which do not share any feature, merged in a fixed
+         * order. The same layers, extent, settings and seed always give the
+         * same labels, whatever the number of threads, unless the time
+         * budget of labeller() is spent. Default is false.
+         *
+         * @param deterministic true to enable the deterministic mode
+         */
+        void setDeterministic (bool deterministic);
+
+        /**
+         * \brief is the deterministic mode enabled ?
+         */
+        bool isDeterministic ();
+
+        /**
+         * \brief Set the seed of the random perturbations of the search
+         *
+         * The seed drives the perturbations of the multi-start search
+         * (see setNbStarts()). Default is 0.
+         *
+         * @param seed any value
+         */
+        void setSeed (unsigned int seed);
+
+        /**
+         * \brief get the seed of the random perturbations of the search
+         */
+        unsigned int getSeed ();
+
+        /**
+         * \brief Set the memory budget of the coordinates cache
+         *
+         * Coordinates of features are kept between calls to labeller() so
+         * that PalGeometry::getGeosGeometry() is called only once per geometry.
+         * Least recently used coordinates are freed once the budget is exceeded.
+         * Default is 64 MB.
+         *
+         * @param size budget in bytes (0 to disable the cache)
+         */
+        void setCoordCacheSize (size_t size);
+
+        /**
+         * \brief get the memory budget of the coordinates cache
+         *
+         * @return budget in bytes
+         */
+        size_t getCoordCacheSize ();
+
+        /**
+         * \brief # times coordinates were found in the cache
+         */
+        long getCoordCacheHits ();
+
+        /**
+         * \brief # times coordinates had to be extracted from a geometry
+         */
+        long getCoordCacheMisses ();
+
+        /**
+         * \brief Set the memory budget of the candidates cache
+         *
+         * Candidates of features which are not clipped by the map extent are
+         * kept between calls to labeller(), for each scale. They are generated
+         * again when the resolution, the map unit, the feature's label size or
+         * distlabel or the layer's arrangement change.
+         * Least recently used candidates are freed once the budget is exceeded.
+         * Default is 64 MB.
+         *
+         * @param size budget in bytes (0 to disable the cache)
+         */
+        void setCandidateCacheSize (size_t size);
+
+        /**
+         * \brief get the memory budget of the candidates cache
+         *
+         * @return budget in bytes
+         */
+        size_t getCandidateCacheSize ();
+
+        /**
+         * \brief # times candidates were found in the cache
+         */
+        long getCandidateCacheHits ();
+
+        /**
+         * \brief # times candidates had to be generated for a feature which was not clipped
+         */
+        long getCandidateCacheMisses ();
     };
 } // end namespace pal
 #endif
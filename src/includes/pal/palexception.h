@@ -80,6 +80,14 @@ namespace pal {
             }
         };
 
+        /** \brief a layer snapshot can't be written, read or is not valid
+        */
+        class InvalidSnapshot : public std::exception {
+            const char * what() const throw() {
+                return "Layer snapshot can't be used";
+            }
+        };
+
         /** \brief thrown when a value is not in the valid scale range
          *
          *  It can be thrown by :
@@ -60,6 +60,61 @@ namespace pal {
          */
         virtual void releaseGeosGeometry (GEOSGeometry *the_geom) = 0;
 
+        /**
+         * \brief Direct access to coordinates (optional)
+         *
+         * Geometries whose coordinates already live in memory can implement
+         * getNbParts(), getPartType(), getNbRings() and getRing(); Pal then reads
+         * them without calling getGeosGeometry().
+         *
+         * Rings are used in place, without any copy, when x and y are contiguous
+         * (stride 1), the ring has no consecutive duplicated point (first and last
+         * points included) and polygon rings are counterclockwise. Otherwise Pal
+         * works on a copy. Arrays must stay valid and unchanged as long as the
+         * geometry is registered in a layer.
+         *
+         * @return # parts (simple geometries) or -1 if direct access is not
+         * supported (default)
+         */
+        virtual int getNbParts () {
+            return -1;
+        }
+
+        /**
+         * \brief type of a part
+         * @param part part index (0 <= part < getNbParts())
+         * @return GEOS_POINT, GEOS_LINESTRING or GEOS_POLYGON
+         */
+        virtual int getPartType (int /*part*/) {
+            return -1;
+        }
+
+        /**
+         * \brief # rings of a part
+         * Points and linestrings have one ring, polygons have their exterior
+         * ring plus one ring per hole.
+         * @param part part index
+         */
+        virtual int getNbRings (int /*part*/) {
+            return 0;
+        }
+
+        /**
+         * \brief coordinates of a ring
+         * Ring 0 is the point, the linestring or the exterior ring, other rings
+         * are holes. The ith point is (x[i*stride], y[i*stride]), so interleaved
+         * coordinates are given with y = x + 1 and stride = 2.
+         * @param part part index
+         * @param ring ring index
+         * @param x set to the first x coordinate
+         * @param y set to the first y coordinate
+         * @param stride # doubles between two points, 1 when left unchanged
+         * @return # points in the ring
+         */
+        virtual int getRing (int /*part*/, int /*ring*/, const double ** /*x*/, const double ** /*y*/, int * /*stride*/) {
+            return 0;
+        }
+
 
         /*
          * \brief Called by Pal when it doesn't need the coordinates anymore
@@ -51,6 +51,29 @@ namespace pal {
         int *layersNbObjects; // [nbLayers]
         int *layersNbLabelledObjects; // [nbLayers]
 
+        long nbCoordCacheHits;
+        long nbCoordCacheMisses;
+
+        long nbCandidateCacheHits;
+        long nbCandidateCacheMisses;
+
+        /* phases durations [s] */
+        double extractTime;
+        double filterTime;
+        double conflictGraphTime;
+        double reduceTime;
+        double initSolTime;
+        double searchTime;
+
+        long nbCandidates;
+        long nbPrunedCandidates;
+        long nbConflicts;
+        long nbRTreeQueries;
+        long nbConflictTests;
+        long nbSearchIterations;
+        double solutionCost;
+        bool budgetHit;
+
         PalStat();
 
     public:
@@ -90,6 +113,96 @@ namespace pal {
          * \brief get the number of object in layer 'layerId' which are labelled
          */
         int getLayerNbLabelledObjects (int layerId);
+
+        /**
+         * \brief # times features coordinates were found in Pal's cache (since Pal creation)
+         */
+        long getNbCoordCacheHits();
+
+        /**
+         * \brief # times features coordinates were extracted from geometries (since Pal creation)
+         */
+        long getNbCoordCacheMisses();
+
+        /**
+         * \brief # times features candidates were found in Pal's cache (since Pal creation)
+         */
+        long getNbCandidateCacheHits();
+
+        /**
+         * \brief # times features candidates missed Pal's cache (since Pal creation)
+         */
+        long getNbCandidateCacheMisses();
+
+        /**
+         * \brief wall-clock time spent extracting features and generating candidates [s]
+         */
+        double getExtractTime();
+
+        /**
+         * \brief wall-clock time spent filtering candidates against obstacles and setting their cost [s]
+         */
+        double getFilteringTime();
+
+        /**
+         * \brief wall-clock time spent looking up overlapping candidates [s]
+         */
+        double getConflictGraphTime();
+
+        /**
+         * \brief wall-clock time spent reducing the problem and splitting it into components [s]
+         */
+        double getReduceTime();
+
+        /**
+         * \brief wall-clock time spent computing the initial solution [s]
+         */
+        double getInitialSolutionTime();
+
+        /**
+         * \brief wall-clock time spent improving the initial solution [s]
+         */
+        double getSearchTime();
+
+        /**
+         * \brief # candidates generated within the map extent
+         */
+        long getNbCandidates();
+
+        /**
+         * \brief # generated candidates dropped before the search (worst ones, conflicting ones)
+         */
+        long getNbPrunedCandidates();
+
+        /**
+         * \brief # pairs of overlapping candidates in the problem
+         */
+        long getNbConflicts();
+
+        /**
+         * \brief # spatial index look ups
+         */
+        long getNbRTreeQueries();
+
+        /**
+         * \brief # overlap tests between two candidates
+         */
+        long getNbConflictTests();
+
+        /**
+         * \brief # sub parts (POPMUSIC) or components (CHAIN) optimizations
+         */
+        long getNbSearchIterations();
+
+        /**
+         * \brief cost of the retained solution
+         */
+        double getSolutionCost();
+
+        /**
+         * \brief true if the search was stopped by the time budget before converging
+         */
+        bool isBudgetHit();
     };
 
 } // end namespace pal
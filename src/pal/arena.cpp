@@ -0,0 +1,122 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstring>
+
+#include "arena.h"
+
+namespace pal {
+
+    Arena::Arena (size_t blockSize) : blockSize (blockSize) {
+        blocks = NULL;
+        nbBlocks = 0;
+        maxBlocks = 0;
+        cur = NULL;
+        avail = 0;
+        nbAllocs = 0;
+        size = 0;
+    }
+
+    Arena::~Arena() {
+        for (int i = 0;i < nbBlocks;i++)
+            delete[] blocks[i];
+        delete[] blocks;
+    }
+
+    char *Arena::newBlock (size_t bytes) {
+        if (nbBlocks == maxBlocks) {
+            maxBlocks = (maxBlocks == 0 ? 16 : maxBlocks * 2);
+            char **tmp = new char*[maxBlocks];
+            if (blocks) {
+                memcpy (tmp, blocks, sizeof (char*) * nbBlocks);
+                delete[] blocks;
+            }
+            blocks = tmp;
+        }
+
+        // big objects get their own block, the current one stays in use
+        if (bytes > blockSize / 4) {
+            char *block = new char[bytes];
+            size += bytes;
+            blocks[nbBlocks++] = block;
+            return block;
+        }
+
+        cur = new char[blockSize];
+        size += blockSize;
+        blocks[nbBlocks++] = cur;
+
+        char *p = cur;
+        cur += bytes;
+        avail = blockSize - bytes;
+        return p;
+    }
+
+    void Arena::adopt (Arena *other) {
+        int i;
+
+        for (i = 0;i < other->nbBlocks;i++) {
+            if (nbBlocks == maxBlocks) {
+                maxBlocks = (maxBlocks == 0 ? 16 : maxBlocks * 2);
+                char **tmp = new char*[maxBlocks];
+                if (blocks) {
+                    memcpy (tmp, blocks, sizeof (char*) * nbBlocks);
+                    delete[] blocks;
+                }
+                blocks = tmp;
+            }
+            blocks[nbBlocks++] = other->blocks[i];
+        }
+
+        nbAllocs += other->nbAllocs;
+        size += other->size;
+
+        delete[] other->blocks;
+        other->blocks = NULL;
+        other->nbBlocks = 0;
+        other->maxBlocks = 0;
+        other->cur = NULL;
+        other->avail = 0;
+        other->nbAllocs = 0;
+        other->size = 0;
+    }
+
+    long Arena::getNbAllocs () {
+        return nbAllocs;
+    }
+
+    int Arena::getNbBlocks () {
+        return nbBlocks;
+    }
+
+    size_t Arena::getSize () {
+        return size;
+    }
+
+} // end namespace pal
@@ -0,0 +1,139 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+
+namespace pal {
+
+    /**
+     * \brief monotonic memory buffer
+     *
+     * Objects are carved one after the other from large blocks and are
+     * never freed one by one : all the memory is released at once when
+     * the arena is deleted. Objects allocated from an arena must not be
+     * deleted, their destructor is never called.
+     *
+     * An arena is not thread-safe, each thread fills its own one and
+     * hands it over with adopt().
+     */
+    class Arena {
+    private:
+        char **blocks;
+        int nbBlocks;
+        int maxBlocks;
+
+        char *cur;       // free space of the current block
+        size_t avail;
+
+        size_t blockSize;
+
+        long nbAllocs;
+        size_t size;
+
+        char *newBlock (size_t bytes);
+
+    public:
+        /**
+         * \brief create an empty arena
+         * @param blockSize # bytes requested to the system at once
+         */
+        Arena (size_t blockSize = 65536);
+
+        ~Arena();
+
+        /**
+         * \brief allocate bytes, aligned for any type
+         */
+        void *alloc (size_t bytes) {
+            bytes = (bytes + 15) & ~ (size_t) 15;
+            nbAllocs++;
+            if (bytes > avail)
+                return newBlock (bytes);
+            void *p = cur;
+            cur += bytes;
+            avail -= bytes;
+            return p;
+        }
+
+        /**
+         * \brief allocate an uninitialized array
+         */
+        template <typename T> T *allocArray (int n) {
+            return (T*) alloc (sizeof (T) * (n > 0 ? n : 1));
+        }
+
+        /**
+         * \brief allocate an uninitialized array
+         * @param n # elements
+         * @param align alignment of the first element, a power of 2
+         */
+        template <typename T> T *allocArray (int n, size_t align) {
+            size_t p = (size_t) alloc (sizeof (T) * (n > 0 ? n : 1) + align);
+            return (T*) ( (p + align - 1) & ~ (align - 1));
+        }
+
+        /**
+         * \brief take over all the memory of another arena
+         *
+         * other is left empty, objects it gave keep living in this arena
+         */
+        void adopt (Arena *other);
+
+        /**
+         * \brief # objects allocated from the arena
+         */
+        long getNbAllocs ();
+
+        /**
+         * \brief # blocks requested to the system
+         */
+        int getNbBlocks ();
+
+        /**
+         * \brief # bytes held by the arena
+         */
+        size_t getSize ();
+    };
+
+} // end namespace pal
+
+/**
+ * \brief construct an object into an arena : new (arena) T (...)
+ */
+inline void *operator new (size_t size, pal::Arena *arena) {
+    return arena->alloc (size);
+}
+
+// only called when a constructor throws
+inline void operator delete (void *, pal::Arena *) {
+}
+
+#endif
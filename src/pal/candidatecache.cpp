@@ -0,0 +1,205 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cfloat>
+#include <new>
+
+#include "arena.h"
+#include "candidatecache.h"
+#include "labelposition.h"
+#include "simplemutex.h"
+
+namespace pal {
+
+    static bool sameKey (CandidateKey *a, CandidateKey *b) {
+        return a->scale == b->scale && a->dpi == b->dpi && a->mapUnit == b->mapUnit
+               && a->width == b->width
+               && a->label_x == b->label_x && a->label_y == b->label_y
+               && a->distlabel == b->distlabel && a->arrangement == b->arrangement
+               && a->labelUnit == b->labelUnit && a->point_p == b->point_p
+               && a->simplifyTolerance == b->simplifyTolerance;
+    }
+
+    CandidateCache::CandidateCache (size_t maxSize) : maxSize (maxSize) {
+        first = NULL;
+        last = NULL;
+        size = 0;
+        nbHits = 0;
+        nbMisses = 0;
+        mutex = new SimpleMutex();
+    }
+
+    CandidateCache::~CandidateCache() {
+        CandidateEntry *entry = first;
+        while (entry) {
+            CandidateEntry *next = entry->next;
+            freeEntry (entry);
+            entry = next;
+        }
+        delete mutex;
+    }
+
+    void CandidateCache::unlink (CandidateEntry *entry) {
+        if (entry->prev)
+            entry->prev->next = entry->next;
+        else
+            first = entry->next;
+
+        if (entry->next)
+            entry->next->prev = entry->prev;
+        else
+            last = entry->prev;
+
+        entry->prev = entry->next = NULL;
+    }
+
+    void CandidateCache::pushFront (CandidateEntry *entry) {
+        entry->prev = NULL;
+        entry->next = first;
+        if (first)
+            first->prev = entry;
+        else
+            last = entry;
+        first = entry;
+    }
+
+    void CandidateCache::freeEntry (CandidateEntry *entry) {
+        // LabelPosition owns nothing
+        ::operator delete (entry->lPos);
+        delete entry;
+    }
+
+    void CandidateCache::evict () {
+        while (size > maxSize && last) {
+            CandidateEntry *entry = last;
+            unlink (entry);
+            entries.erase (std::make_pair (entry->feature, entry->key.scale));
+            size -= entry->size;
+            freeEntry (entry);
+        }
+    }
+
+    int CandidateCache::get (Feature *feat, CandidateKey *key, LabelPosition ***lPos, Arena *arena) {
+        int i;
+        int nblp = -1;
+
+        mutex->lock();
+        std::map<std::pair<Feature*, double>, CandidateEntry*>::iterator it = entries.find (std::make_pair (feat, key->scale));
+        if (it != entries.end() && sameKey (&it->second->key, key)) {
+            CandidateEntry *entry = it->second;
+            nblp = entry->nblp;
+            *lPos = arena->allocArray<LabelPosition*> (nblp);
+            for (i = 0;i < nblp;i++)
+                (*lPos) [i] = new (arena) LabelPosition (entry->lPos[i]);
+            unlink (entry);
+            pushFront (entry);
+            nbHits++;
+        } else {
+            nbMisses++;
+        }
+        mutex->unlock();
+
+        return nblp;
+    }
+
+    void CandidateCache::insert (Feature *feat, CandidateKey *key, int nblp, LabelPosition **lPos) {
+        int i;
+
+        size_t entrySize = sizeof (CandidateEntry) + nblp * sizeof (LabelPosition);
+
+        // would be evicted at once, with everything else
+        if (entrySize > maxSize)
+            return;
+
+        CandidateEntry *entry = new CandidateEntry();
+        entry->feature = feat;
+        entry->key = *key;
+        entry->nblp = nblp;
+        entry->lPos = (LabelPosition*) ::operator new (nblp * sizeof (LabelPosition));
+        for (i = 0;i < nblp;i++)
+            new (entry->lPos + i) LabelPosition (*lPos[i]);
+        entry->size = entrySize;
+        entry->prev = entry->next = NULL;
+
+        mutex->lock();
+        std::map<std::pair<Feature*, double>, CandidateEntry*>::iterator it = entries.find (std::make_pair (feat, key->scale));
+        if (it != entries.end()) {
+            // generated with other parameters
+            CandidateEntry *old = it->second;
+            unlink (old);
+            size -= old->size;
+            freeEntry (old);
+            it->second = entry;
+        } else {
+            entries[std::make_pair (feat, key->scale)] = entry;
+        }
+        size += entry->size;
+        pushFront (entry);
+
+        evict();
+        mutex->unlock();
+    }
+
+    void CandidateCache::invalidate (Feature *feat) {
+        mutex->lock();
+        std::map<std::pair<Feature*, double>, CandidateEntry*>::iterator it = entries.lower_bound (std::make_pair (feat, -DBL_MAX));
+        while (it != entries.end() && it->first.first == feat) {
+            CandidateEntry *entry = it->second;
+            entries.erase (it++);
+            unlink (entry);
+            size -= entry->size;
+            freeEntry (entry);
+        }
+        mutex->unlock();
+    }
+
+    void CandidateCache::setMaxSize (size_t maxSize) {
+        mutex->lock();
+        this->maxSize = maxSize;
+        evict();
+        mutex->unlock();
+    }
+
+    size_t CandidateCache::getMaxSize () {
+        return maxSize;
+    }
+
+    size_t CandidateCache::getSize () {
+        return size;
+    }
+
+    long CandidateCache::getNbHits () {
+        return nbHits;
+    }
+
+    long CandidateCache::getNbMisses () {
+        return nbMisses;
+    }
+
+} // namespace pal
@@ -0,0 +1,174 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _CANDIDATECACHE_H_
+#define _CANDIDATECACHE_H_
+
+#include <cstddef>
+#include <map>
+#include <utility>
+
+#include <pal/pal.h>
+
+namespace pal {
+
+    class Arena;
+    class Feature;
+    class LabelPosition;
+    class SimpleMutex;
+
+    /**
+     * \brief parameters candidates of a feature depend on
+     */
+    typedef struct _candidatekey {
+        double scale;
+        int dpi;
+        Units mapUnit;
+        /**
+         * map extent width, only used to convert sizes to degrees (0 otherwise)
+         */
+        double width;
+        double label_x;
+        double label_y;
+        int distlabel;
+        Arrangement arrangement;
+        Units labelUnit;
+        int point_p;
+        double simplifyTolerance; // [px]
+    } CandidateKey;
+
+    /**
+     * \brief candidates of a feature for one set of parameters
+     */
+    typedef struct _candidateentry {
+        Feature *feature;
+        CandidateKey key;
+
+        int nblp;
+        LabelPosition *lPos; // [nblp] copies, in a single block
+
+        /**
+         * # bytes held by the entry
+         */
+        size_t size;
+
+        /**
+         * LRU list, most recently used first
+         */
+        struct _candidateentry *prev;
+        struct _candidateentry *next;
+    } CandidateEntry;
+
+    /**
+     * \brief Feature candidates cache
+     *
+     * Keep candidates generated for features which were not clipped by the
+     * map extent, before they are filtered against the extent and the
+     * obstacles, so that labelling the same features at the same scale does
+     * not generate them again. Entries are keyed by (feature, scale) and the
+     * least recently used ones are freed once the cache holds more than its
+     * memory budget.
+     */
+    class CandidateCache {
+    private:
+        std::map<std::pair<Feature*, double>, CandidateEntry*> entries;
+
+        CandidateEntry *first;
+        CandidateEntry *last;
+
+        size_t size;
+        size_t maxSize;
+
+        long nbHits;
+        long nbMisses;
+
+        SimpleMutex *mutex;
+
+        void unlink (CandidateEntry *entry);
+        void pushFront (CandidateEntry *entry);
+        void freeEntry (CandidateEntry *entry);
+
+        /**
+         * \brief free entries until the budget is respected (mutex held)
+         */
+        void evict ();
+
+    public:
+        /**
+         * \brief create an empty cache
+         * @param maxSize memory budget in bytes
+         */
+        CandidateCache (size_t maxSize);
+
+        ~CandidateCache();
+
+        /**
+         * \brief look up candidates
+         * @param feat the feature
+         * @param key parameters of the labelling
+         * @param lPos filled with a copy of the cached candidates
+         * @param arena the copy is allocated from it
+         * @return # candidates in *lPos, -1 if the feature is not cached for key
+         */
+        int get (Feature *feat, CandidateKey *key, LabelPosition ***lPos, Arena *arena);
+
+        /**
+         * \brief add a copy of candidates to the cache
+         * @param feat the feature
+         * @param key parameters candidates were generated with
+         * @param nblp # candidates in lPos
+         * @param lPos the candidates
+         */
+        void insert (Feature *feat, CandidateKey *key, int nblp, LabelPosition **lPos);
+
+        /**
+         * \brief forget candidates of a feature (it has changed or is about to be deleted)
+         */
+        void invalidate (Feature *feat);
+
+        /**
+         * \brief change the memory budget
+         * @param maxSize budget in bytes (0 disables the cache)
+         */
+        void setMaxSize (size_t maxSize);
+
+        size_t getMaxSize ();
+
+        /**
+         * \brief # bytes currently held
+         */
+        size_t getSize ();
+
+        long getNbHits ();
+        long getNbMisses ();
+    };
+
+} // namespace pal
+
+#endif
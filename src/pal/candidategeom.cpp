@@ -0,0 +1,294 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define _CONFLICT_SIMD_
+#include <immintrin.h>
+#endif
+
+#include "arena.h"
+#include "candidategeom.h"
+#include "labelposition.h"
+
+namespace pal {
+
+    typedef unsigned int (*ConflictKernel) (CandidateGeom *geom, int a, const int *ids, int n);
+
+    static unsigned int scalarConflictMask (CandidateGeom *geom, int a, const int *ids, int n) {
+        unsigned int mask = 0;
+        int k;
+
+        for (k = 0;k < n;k++) {
+            if (geom->isInConflict<RotatedRect> (a, ids[k]))
+                mask |= 1u << k;
+        }
+        return mask;
+    }
+
+#ifdef _CONFLICT_SIMD_
+    /*
+     * Kernels compute the very same cross products as isInConflict(),
+     * without contraction into FMA, so results are bitwise identical.
+     * Lane k tests a against ids[k] : a's corners are broadcast, corners
+     * of the batch are gathered.
+     */
+
+    __attribute__ ( (target ("sse2")))
+    static unsigned int sse2ConflictMask (CandidateGeom *geom, int a, const int *ids, int n) {
+        unsigned int mask = 0;
+        int k, i, i2, j;
+        int fa = geom->feat[a];
+
+        const __m128d zero = _mm_setzero_pd();
+        __m128d bx[4], by[4];
+        __m128d x1, y1, dx, dy, cp, d1, d2, ok;
+
+        for (k = 0;k + 2 <= n;k += 2) {
+            for (j = 0;j < 4;j++) {
+                bx[j] = _mm_set_pd (geom->x[j][ids[k+1]], geom->x[j][ids[k]]);
+                by[j] = _mm_set_pd (geom->y[j][ids[k+1]], geom->y[j][ids[k]]);
+            }
+
+            ok = _mm_cmpeq_pd (zero, zero);
+            for (i = 0;i < 4;i++) {
+                i2 = (i + 1) % 4;
+
+                // edge i of a against corners of the batch
+                x1 = _mm_set1_pd (geom->x[i][a]);
+                y1 = _mm_set1_pd (geom->y[i][a]);
+                dx = _mm_sub_pd (_mm_set1_pd (geom->x[i2][a]), x1);
+                dy = _mm_sub_pd (_mm_set1_pd (geom->y[i2][a]), y1);
+                d1 = zero;
+                for (j = 0;j < 4;j++) {
+                    cp = _mm_sub_pd (_mm_mul_pd (dx, _mm_sub_pd (by[j], y1)), _mm_mul_pd (_mm_sub_pd (bx[j], x1), dy));
+                    d1 = _mm_or_pd (d1, _mm_cmpgt_pd (cp, zero));
+                }
+
+                // edge i of the batch against corners of a
+                dx = _mm_sub_pd (bx[i2], bx[i]);
+                dy = _mm_sub_pd (by[i2], by[i]);
+                d2 = zero;
+                for (j = 0;j < 4;j++) {
+                    cp = _mm_sub_pd (_mm_mul_pd (dx, _mm_sub_pd (_mm_set1_pd (geom->y[j][a]), by[i])),
+                                     _mm_mul_pd (_mm_sub_pd (_mm_set1_pd (geom->x[j][a]), bx[i]), dy));
+                    d2 = _mm_or_pd (d2, _mm_cmpgt_pd (cp, zero));
+                }
+
+                ok = _mm_and_pd (ok, _mm_and_pd (d1, d2));
+            }
+
+            mask |= (unsigned int) _mm_movemask_pd (ok) << k;
+        }
+
+        for (;k < n;k++) {
+            if (geom->isInConflict<RotatedRect> (a, ids[k]))
+                mask |= 1u << k;
+        }
+
+        // a candidate never conflicts with one of its own feature
+        for (k = 0;k < n;k++) {
+            if (geom->feat[ids[k]] == fa)
+                mask &= ~ (1u << k);
+        }
+
+        return mask;
+    }
+
+    __attribute__ ( (target ("avx2")))
+    static unsigned int avx2ConflictMask (CandidateGeom *geom, int a, const int *ids, int n) {
+        unsigned int mask = 0;
+        int k, i, i2, j;
+        int fa = geom->feat[a];
+
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d all = _mm256_cmp_pd (zero, zero, _CMP_EQ_OQ);
+        __m128i idx;
+        __m256d bx[4], by[4];
+        __m256d x1, y1, dx, dy, cp, d1, d2, ok;
+
+        for (k = 0;k + 4 <= n;k += 4) {
+            idx = _mm_loadu_si128 ( (const __m128i*) (ids + k));
+            for (j = 0;j < 4;j++) {
+                bx[j] = _mm256_mask_i32gather_pd (zero, geom->x[j], idx, all, 8);
+                by[j] = _mm256_mask_i32gather_pd (zero, geom->y[j], idx, all, 8);
+            }
+
+            ok = all;
+            for (i = 0;i < 4;i++) {
+                i2 = (i + 1) % 4;
+
+                // edge i of a against corners of the batch
+                x1 = _mm256_set1_pd (geom->x[i][a]);
+                y1 = _mm256_set1_pd (geom->y[i][a]);
+                dx = _mm256_sub_pd (_mm256_set1_pd (geom->x[i2][a]), x1);
+                dy = _mm256_sub_pd (_mm256_set1_pd (geom->y[i2][a]), y1);
+                d1 = zero;
+                for (j = 0;j < 4;j++) {
+                    cp = _mm256_sub_pd (_mm256_mul_pd (dx, _mm256_sub_pd (by[j], y1)), _mm256_mul_pd (_mm256_sub_pd (bx[j], x1), dy));
+                    d1 = _mm256_or_pd (d1, _mm256_cmp_pd (cp, zero, _CMP_GT_OQ));
+                }
+
+                // edge i of the batch against corners of a
+                dx = _mm256_sub_pd (bx[i2], bx[i]);
+                dy = _mm256_sub_pd (by[i2], by[i]);
+                d2 = zero;
+                for (j = 0;j < 4;j++) {
+                    cp = _mm256_sub_pd (_mm256_mul_pd (dx, _mm256_sub_pd (_mm256_set1_pd (geom->y[j][a]), by[i])),
+                                        _mm256_mul_pd (_mm256_sub_pd (_mm256_set1_pd (geom->x[j][a]), bx[i]), dy));
+                    d2 = _mm256_or_pd (d2, _mm256_cmp_pd (cp, zero, _CMP_GT_OQ));
+                }
+
+                ok = _mm256_and_pd (ok, _mm256_and_pd (d1, d2));
+            }
+
+            mask |= (unsigned int) _mm256_movemask_pd (ok) << k;
+        }
+
+        if (k < n)
+            mask |= sse2ConflictMask (geom, a, ids + k, n - k) << k;
+
+        // a candidate never conflicts with one of its own feature
+        for (k = 0;k < n;k++) {
+            if (geom->feat[ids[k]] == fa)
+                mask &= ~ (1u << k);
+        }
+
+        return mask;
+    }
+#endif
+
+    typedef struct {
+        ConflictKernel kernel;
+        const char *name;
+    } ConflictKernelChoice;
+
+    static ConflictKernelChoice selectConflictKernel () {
+        ConflictKernelChoice choice;
+#ifdef _CONFLICT_SIMD_
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports ("avx2")) {
+            choice.name = "avx2";
+            choice.kernel = avx2ConflictMask;
+            return choice;
+        }
+        if (__builtin_cpu_supports ("sse2")) {
+            choice.name = "sse2";
+            choice.kernel = sse2ConflictMask;
+            return choice;
+        }
+#endif
+        choice.name = "scalar";
+        choice.kernel = scalarConflictMask;
+        return choice;
+    }
+
+    /*
+     * kernel of this cpu, selected once : the initialisation of a local
+     * static is thread-safe, problems of several Pal may be built at once
+     */
+    static const ConflictKernelChoice &conflictKernel () {
+        static const ConflictKernelChoice choice = selectConflictKernel();
+        return choice;
+    }
+
+    CandidateGeom::CandidateGeom (int nblp, LabelPosition **lPos, Arena *arena) : nblp (nblp), lPos (lPos) {
+        int i, c;
+        LabelPosition *lp;
+        double amin[2];
+        double amax[2];
+
+        for (c = 0;c < 4;c++) {
+            x[c] = arena->allocArray<double> (nblp, 32);
+            y[c] = arena->allocArray<double> (nblp, 32);
+        }
+        xmin = arena->allocArray<double> (nblp, 32);
+        ymin = arena->allocArray<double> (nblp, 32);
+        xmax = arena->allocArray<double> (nblp, 32);
+        ymax = arena->allocArray<double> (nblp, 32);
+        cosAlpha = arena->allocArray<double> (nblp, 32);
+        sinAlpha = arena->allocArray<double> (nblp, 32);
+        feat = arena->allocArray<int> (nblp, 32);
+
+        allAxisAligned = true;
+        for (i = 0;i < nblp;i++) {
+            lp = lPos[i];
+            for (c = 0;c < 4;c++) {
+                x[c][i] = lp->x[c];
+                y[c][i] = lp->y[c];
+            }
+            lp->getBoundingBox (amin, amax);
+            xmin[i] = amin[0];
+            ymin[i] = amin[1];
+            xmax[i] = amax[0];
+            ymax[i] = amax[1];
+            cosAlpha[i] = cos (lp->alpha);
+            sinAlpha[i] = sin (lp->alpha);
+            feat[i] = lp->probFeat;
+            if (!lp->axisAligned)
+                allAxisAligned = false;
+        }
+    }
+
+    template <>
+    unsigned int CandidateGeom::conflictMask<RotatedRect> (int a, const int *ids, int n) {
+        return conflictKernel().kernel (this, a, ids, n);
+    }
+
+    template <class Shape>
+    int CandidateGeom::conflicts (int a, LabelPosition **hits, int nbHits, int *ids) {
+        int i, k, n;
+        int nb = 0;
+        unsigned int mask;
+        int batch[batchSize];
+
+        for (i = 0;i < nbHits;i += batchSize) {
+            n = (nbHits - i < batchSize ? nbHits - i : batchSize);
+            for (k = 0;k < n;k++)
+                batch[k] = hits[i+k]->id;
+
+            mask = conflictMask<Shape> (a, batch, n);
+            for (k = 0;mask;k++, mask >>= 1) {
+                if (mask & 1)
+                    ids[nb++] = batch[k];
+            }
+        }
+
+        return nb;
+    }
+
+    template int CandidateGeom::conflicts<RotatedRect> (int a, LabelPosition **hits, int nbHits, int *ids);
+    template int CandidateGeom::conflicts<AxisAlignedRect> (int a, LabelPosition **hits, int nbHits, int *ids);
+
+    const char *CandidateGeom::getKernelName () {
+        return conflictKernel().name;
+    }
+
+} // end namespace pal
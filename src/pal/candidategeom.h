@@ -0,0 +1,208 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _CANDIDATEGEOM_H_
+#define _CANDIDATEGEOM_H_
+
+#include "rtree.hpp"
+#include "geomfunction.h"
+
+namespace pal {
+
+    class Arena;
+    class LabelPosition;
+
+    /**
+     * \brief geometry of the candidates of a problem, as arrays indexed by candidate id
+     *
+     * Corners are stored corner by corner : x[c][id] is the c-th corner of
+     * candidate id, so that a kernel reads the same corner of consecutive
+     * candidates from consecutive addresses. All arrays are carved from the
+     * problem's arena and aligned on 32 bytes.
+     */
+    class CandidateGeom {
+    public:
+        /**
+         * max # candidates tested at once by conflictMask()
+         */
+        static const int batchSize = 32;
+
+        int nblp;
+
+        double *x[4];
+        double *y[4];
+
+        /**
+         * bounding boxes
+         */
+        double *xmin;
+        double *ymin;
+        double *xmax;
+        double *ymax;
+
+        double *cosAlpha;
+        double *sinAlpha;
+
+        /**
+         * feature (problem id) of each candidate
+         */
+        int *feat;
+
+        /**
+         * the candidates themselves, as stored in the indexes
+         */
+        LabelPosition **lPos;
+
+        /**
+         * no candidate is rotated, AxisAlignedRect tests can be used
+         */
+        bool allAxisAligned;
+
+        /**
+         * \brief copy the geometry of candidates
+         * @param nblp # candidates
+         * @param lPos candidates, lPos[i]->id must be i
+         * @param arena arrays are allocated from it
+         */
+        CandidateGeom (int nblp, LabelPosition **lPos, Arena *arena);
+
+        void getBoundingBox (int id, double amin[2], double amax[2]) {
+            amin[0] = xmin[id];
+            amin[1] = ymin[id];
+            amax[0] = xmax[id];
+            amax[1] = ymax[id];
+        }
+
+        void insertIntoIndex (int id, RTree<LabelPosition*, double, 2, double> *index) {
+            double amin[2];
+            double amax[2];
+            getBoundingBox (id, amin, amax);
+            index->Insert (amin, amax, lPos[id]);
+        }
+
+        void removeFromIndex (int id, RTree<LabelPosition*, double, 2, double> *index) {
+            double amin[2];
+            double amax[2];
+            getBoundingBox (id, amin, amax);
+            index->Remove (amin, amax, lPos[id]);
+        }
+
+        /**
+         * \brief do candidates a and b overlap ?
+         * Same test as LabelPosition::isInConflict()
+         */
+        template <class Shape>
+        bool isInConflict (int a, int b) {
+            int i, i2, j;
+            int d1, d2;
+
+            if (feat[a] == feat[b])
+                return false;
+
+            for (i = 0;i < 4;i++) {
+                i2 = (i + 1) % 4;
+                d1 = -1;
+                d2 = -1;
+                for (j = 0;j < 4;j++) {
+                    if (cross_product (x[i][a], y[i][a], x[i2][a], y[i2][a], x[j][b], y[j][b]) > 0)
+                        d1 = 1;
+                    if (cross_product (x[i][b], y[i][b], x[i2][b], y[i2][b], x[j][a], y[j][a]) > 0)
+                        d2 = 1;
+                }
+
+                if (d1 == -1 || d2 == -1) // disjoint
+                    return false;
+            }
+            return true;
+        }
+
+        /**
+         * \brief test candidate a against a batch of candidates
+         *
+         * Same test as isInConflict(). Rotated candidates are tested with
+         * the widest SIMD instructions the CPU supports (AVX2, SSE2,
+         * scalar otherwise).
+         *
+         * @param a candidate id
+         * @param ids candidates to test
+         * @param n # candidates in ids, at most batchSize
+         * @return bit k is set if a and ids[k] overlap
+         */
+        template <class Shape>
+        unsigned int conflictMask (int a, const int *ids, int n);
+
+        /**
+         * \brief keep candidates overlapping candidate a
+         *
+         * @param a candidate id
+         * @param hits candidates to test, as found in an index
+         * @param nbHits # candidates in hits
+         * @param ids filled with ids of candidates overlapping a, in hits order (room for nbHits)
+         * @return # candidates overlapping a
+         */
+        template <class Shape>
+        int conflicts (int a, LabelPosition **hits, int nbHits, int *ids);
+
+        /**
+         * \brief name of the conflictMask() kernel in use : "avx2", "sse2" or "scalar"
+         */
+        static const char *getKernelName ();
+    };
+
+    /*
+     * Unrotated rectangles overlap iff their bounding boxes strictly
+     * overlap, which is what the separating axis test reduces to
+     */
+    template <>
+    inline bool CandidateGeom::isInConflict<AxisAlignedRect> (int a, int b) {
+        return feat[a] != feat[b]
+               && xmin[b] < xmax[a] && xmax[b] > xmin[a]
+               && ymin[b] < ymax[a] && ymax[b] > ymin[a];
+    }
+
+    template <>
+    unsigned int CandidateGeom::conflictMask<RotatedRect> (int a, const int *ids, int n);
+
+    template <>
+    inline unsigned int CandidateGeom::conflictMask<AxisAlignedRect> (int a, const int *ids, int n) {
+        unsigned int mask = 0;
+        int k, b;
+
+        // no branch : let the compiler vectorize the comparisons
+        for (k = 0;k < n;k++) {
+            b = ids[k];
+            mask |= (unsigned int) ( (feat[a] != feat[b])
+                                     & (xmin[b] < xmax[a]) & (xmax[b] > xmin[a])
+                                     & (ymin[b] < ymax[a]) & (ymax[b] > ymin[a])) << k;
+        }
+        return mask;
+    }
+
+} // end namespace pal
+
+#endif
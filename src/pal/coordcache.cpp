@@ -0,0 +1,349 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "coordcache.h"
+#include "pointset.h"
+#include "simplemutex.h"
+
+namespace pal {
+
+    CoordCache::CoordCache (size_t maxSize) : maxSize (maxSize) {
+        first = NULL;
+        last = NULL;
+        size = 0;
+        nbHits = 0;
+        nbMisses = 0;
+        mutex = new SimpleMutex();
+    }
+
+    CoordCache::~CoordCache() {
+        CoordEntry *entry = first;
+        while (entry) {
+            CoordEntry *next = entry->next;
+            freeEntry (entry);
+            entry = next;
+        }
+        delete mutex;
+    }
+
+    void CoordCache::unlink (CoordEntry *entry) {
+        if (entry->prev)
+            entry->prev->next = entry->next;
+        else
+            first = entry->next;
+
+        if (entry->next)
+            entry->next->prev = entry->prev;
+        else
+            last = entry->prev;
+
+        entry->prev = entry->next = NULL;
+    }
+
+    void CoordCache::pushFront (CoordEntry *entry) {
+        entry->prev = NULL;
+        entry->next = first;
+        if (first)
+            first->prev = entry;
+        else
+            last = entry;
+        first = entry;
+    }
+
+    void CoordCache::freeEntry (CoordEntry *entry) {
+        int i;
+        if (!entry->borrowed) {
+            delete[] entry->x;
+            delete[] entry->y;
+            for (i = 0;i < entry->nbHoles;i++) {
+                delete[] entry->holesX[i];
+                delete[] entry->holesY[i];
+            }
+        }
+        delete[] entry->holesX;
+        delete[] entry->holesY;
+        trimSimplified (entry, 0);
+        delete entry;
+    }
+
+    void CoordCache::trimSimplified (CoordEntry *entry, int nbKept) {
+        int i;
+        SimplifiedCoords **link = &entry->simplified;
+
+        while (*link && nbKept > 0) {
+            link = & (*link)->next;
+            nbKept--;
+        }
+
+        SimplifiedCoords *copies = *link;
+        *link = NULL;
+        while (copies) {
+            SimplifiedCoords *next = copies->next;
+            for (i = 0;i <= entry->nbHoles;i++)
+                delete copies->shapes[i];
+            delete[] copies->shapes;
+            entry->size -= copies->size;
+            delete copies;
+            copies = next;
+        }
+    }
+
+    void CoordCache::evict () {
+        CoordEntry *entry = last;
+        while (size > maxSize && entry) {
+            CoordEntry *prev = entry->prev;
+            if (entry->nbUsers == 0) {
+                unlink (entry);
+                entries.erase (std::make_pair (entry->geom, entry->part));
+                size -= entry->size;
+                freeEntry (entry);
+            }
+            entry = prev;
+        }
+    }
+
+    CoordEntry *CoordCache::acquire (PalGeometry *geom, int part, bool count) {
+        CoordEntry *entry = NULL;
+
+        mutex->lock();
+        std::map<std::pair<PalGeometry*, int>, CoordEntry*>::iterator it = entries.find (std::make_pair (geom, part));
+        if (it != entries.end()) {
+            entry = it->second;
+            entry->nbUsers++;
+            unlink (entry);
+            pushFront (entry);
+            if (count)
+                nbHits++;
+        } else if (count) {
+            nbMisses++;
+        }
+        mutex->unlock();
+
+        return entry;
+    }
+
+    void CoordCache::lockGeometry (PalGeometry *geom) {
+        FetchLock *lock;
+
+        mutex->lock();
+        std::map<PalGeometry*, FetchLock*>::iterator it = fetching.find (geom);
+        if (it != fetching.end()) {
+            lock = it->second;
+        } else {
+            lock = new FetchLock();
+            lock->mutex = new SimpleMutex();
+            lock->nbThreads = 0;
+            fetching[geom] = lock;
+        }
+        lock->nbThreads++;
+        mutex->unlock();
+
+        // wait for the thread reading the geometry
+        lock->mutex->lock();
+    }
+
+    void CoordCache::unlockGeometry (PalGeometry *geom) {
+        mutex->lock();
+        std::map<PalGeometry*, FetchLock*>::iterator it = fetching.find (geom);
+        FetchLock *lock = it->second;
+        lock->mutex->unlock();
+        lock->nbThreads--;
+        if (lock->nbThreads == 0) {
+            fetching.erase (it);
+            delete lock->mutex;
+            delete lock;
+        }
+        mutex->unlock();
+    }
+
+    CoordEntry *CoordCache::insert (PalGeometry *geom, int part, int nbPoints, double *x, double *y,
+                                    int nbHoles, PointSet **holes, bool borrowed, bool use) {
+        int i;
+        CoordEntry *entry = new CoordEntry();
+
+        entry->geom = geom;
+        entry->part = part;
+        entry->x = x;
+        entry->y = y;
+        entry->nbHoles = nbHoles;
+        entry->borrowed = borrowed;
+        entry->holesX = new double*[nbHoles];
+        entry->holesY = new double*[nbHoles];
+        entry->size = sizeof (CoordEntry) + 2 * nbHoles * sizeof (double*);
+        if (!borrowed)
+            entry->size += 2 * nbPoints * sizeof (double);
+        for (i = 0;i < nbHoles;i++) {
+            entry->holesX[i] = holes[i]->x;
+            entry->holesY[i] = holes[i]->y;
+            if (!borrowed)
+                entry->size += 2 * holes[i]->nbPoints * sizeof (double);
+            holes[i]->x = NULL;
+            holes[i]->y = NULL;
+        }
+        entry->simplified = NULL;
+        entry->nbUsers = 0;
+        entry->prev = entry->next = NULL;
+
+        mutex->lock();
+        std::pair<std::map<std::pair<PalGeometry*, int>, CoordEntry*>::iterator, bool> ret;
+        ret = entries.insert (std::make_pair (std::make_pair (geom, part), entry));
+        if (ret.second) {
+            size += entry->size;
+            pushFront (entry);
+        } else {
+            // already fetched by someone else
+            freeEntry (entry);
+            entry = ret.first->second;
+            unlink (entry);
+            pushFront (entry);
+        }
+
+        if (use)
+            entry->nbUsers++;
+        else
+            entry = NULL;
+
+        evict();
+        mutex->unlock();
+
+        return entry;
+    }
+
+    /*
+     * copies for tolerance moved to the front of the list, NULL if not computed (mutex held)
+     */
+    static SimplifiedCoords *findSimplified (CoordEntry *entry, double tolerance) {
+        SimplifiedCoords **link = &entry->simplified;
+
+        while (*link && (*link)->tolerance != tolerance)
+            link = & (*link)->next;
+
+        SimplifiedCoords *copies = *link;
+        if (copies) {
+            *link = copies->next;
+            copies->next = entry->simplified;
+            entry->simplified = copies;
+        }
+        return copies;
+    }
+
+    PointSet **CoordCache::getSimplified (CoordEntry *entry, PointSet *shape, PointSet **holes, double tolerance) {
+        int i;
+        SimplifiedCoords *copies;
+
+        mutex->lock();
+        copies = findSimplified (entry, tolerance);
+        mutex->unlock();
+
+        if (copies)
+            return copies->shapes;
+
+        // simplified out of the lock, other parts remain available
+        copies = new SimplifiedCoords();
+        copies->tolerance = tolerance;
+        copies->shapes = new PointSet*[entry->nbHoles + 1];
+        copies->size = sizeof (SimplifiedCoords) + (entry->nbHoles + 1) * sizeof (PointSet*);
+        for (i = 0;i <= entry->nbHoles;i++) {
+            copies->shapes[i] = (i == 0 ? shape : holes[i-1])->simplify (tolerance);
+            if (copies->shapes[i])
+                copies->size += sizeof (PointSet) + 2 * copies->shapes[i]->nbPoints * sizeof (double);
+        }
+
+        mutex->lock();
+        SimplifiedCoords *found = findSimplified (entry, tolerance);
+        if (found) {
+            // already simplified by someone else
+            for (i = 0;i <= entry->nbHoles;i++)
+                delete copies->shapes[i];
+            delete[] copies->shapes;
+            delete copies;
+            copies = found;
+        } else {
+            // copies for other tolerances may still be used by other threads
+            copies->next = entry->simplified;
+            entry->simplified = copies;
+            entry->size += copies->size;
+            size += copies->size;
+            evict();
+        }
+        mutex->unlock();
+
+        return copies->shapes;
+    }
+
+    void CoordCache::release (CoordEntry *entry) {
+        mutex->lock();
+        entry->nbUsers--;
+        if (entry->nbUsers == 0) {
+            // nobody holds copies anymore
+            size -= entry->size;
+            trimSimplified (entry, 1);
+            size += entry->size;
+            evict();
+        }
+        mutex->unlock();
+    }
+
+    void CoordCache::remove (PalGeometry *geom, int part) {
+        mutex->lock();
+        std::map<std::pair<PalGeometry*, int>, CoordEntry*>::iterator it = entries.find (std::make_pair (geom, part));
+        if (it != entries.end()) {
+            CoordEntry *entry = it->second;
+            entries.erase (it);
+            unlink (entry);
+            size -= entry->size;
+            freeEntry (entry);
+        }
+        mutex->unlock();
+    }
+
+    void CoordCache::setMaxSize (size_t maxSize) {
+        mutex->lock();
+        this->maxSize = maxSize;
+        evict();
+        mutex->unlock();
+    }
+
+    size_t CoordCache::getMaxSize () {
+        return maxSize;
+    }
+
+    size_t CoordCache::getSize () {
+        return size;
+    }
+
+    long CoordCache::getNbHits () {
+        return nbHits;
+    }
+
+    long CoordCache::getNbMisses () {
+        return nbMisses;
+    }
+
+} // namespace pal
@@ -0,0 +1,260 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _COORDCACHE_H_
+#define _COORDCACHE_H_
+
+#include <cstddef>
+#include <map>
+#include <utility>
+
+namespace pal {
+
+    class PalGeometry;
+    class PointSet;
+    class SimpleMutex;
+
+    /**
+     * \brief simplified copies of a part and of its holes for one tolerance
+     */
+    typedef struct _simplifiedcoords {
+        double tolerance;
+
+        /**
+         * part [0] and holes [1..nbHoles], NULL items when no point can be removed
+         */
+        PointSet **shapes;
+
+        /**
+         * # bytes held by the copies
+         */
+        size_t size;
+
+        struct _simplifiedcoords *next;
+    } SimplifiedCoords;
+
+    /**
+     * \brief coordinates of one part of a user geometry
+     */
+    typedef struct _coordentry {
+        PalGeometry *geom;
+        int part;
+
+        double *x;
+        double *y;
+
+        int nbHoles;
+        double **holesX; // [nbHoles]
+        double **holesY; // [nbHoles]
+
+        /**
+         * if true, coordinates belong to the user geometry and are not freed
+         */
+        bool borrowed;
+
+        /**
+         * simplified copies by tolerance, most recently used first
+         * (see CoordCache::getSimplified())
+         */
+        SimplifiedCoords *simplified;
+
+        /**
+         * # bytes held by the entry
+         */
+        size_t size;
+
+        /**
+         * # features using the coordinates, the entry cannot be evicted while > 0
+         */
+        int nbUsers;
+
+        /**
+         * LRU list, most recently used first
+         */
+        struct _coordentry *prev;
+        struct _coordentry *next;
+    } CoordEntry;
+
+    /**
+     * \brief user geometry being read by one thread, others wait for it
+     */
+    typedef struct _fetchlock {
+        SimpleMutex *mutex;
+
+        /**
+         * # threads holding or waiting for the lock
+         */
+        int nbThreads;
+    } FetchLock;
+
+    /**
+     * \brief Feature coordinates cache
+     *
+     * Keep coordinates extracted from user geometries so that features
+     * do not have to go through PalGeometry::getGeosGeometry() each time
+     * they are labelled. Entries are keyed by (geometry, part) and the least
+     * recently used ones are freed once the cache holds more than its
+     * memory budget. Entries in use are never freed.
+     *
+     * A user geometry is read by one thread at a time (see lockGeometry()),
+     * so that parts of a multi-geometry labelled by distinct threads do
+     * not call the same PalGeometry concurrently.
+     */
+    class CoordCache {
+    private:
+        std::map<std::pair<PalGeometry*, int>, CoordEntry*> entries;
+        std::map<PalGeometry*, FetchLock*> fetching;
+
+        CoordEntry *first;
+        CoordEntry *last;
+
+        size_t size;
+        size_t maxSize;
+
+        long nbHits;
+        long nbMisses;
+
+        SimpleMutex *mutex;
+
+        void unlink (CoordEntry *entry);
+        void pushFront (CoordEntry *entry);
+        void freeEntry (CoordEntry *entry);
+
+        /**
+         * \brief free the simplified copies of an entry but the first nbKept ones
+         */
+        void trimSimplified (CoordEntry *entry, int nbKept);
+
+        /**
+         * \brief free unused entries until the budget is respected (mutex held)
+         */
+        void evict ();
+
+    public:
+        /**
+         * \brief create an empty cache
+         * @param maxSize memory budget in bytes
+         */
+        CoordCache (size_t maxSize);
+
+        ~CoordCache();
+
+        /**
+         * \brief look up coordinates and mark them as used
+         *
+         * Each successful call must be balanced by a call to release().
+         * @param geom user geometry
+         * @param part part of the geometry
+         * @param count if false, the lookup is not counted in hits and misses
+         * @return the entry or NULL when the part is not cached
+         */
+        CoordEntry *acquire (PalGeometry *geom, int part, bool count = true);
+
+        /**
+         * \brief wait until no other thread reads the user geometry
+         *
+         * Must be balanced by a call to unlockGeometry(). Once the lock is
+         * held, look the part up again: it may have been fetched meanwhile.
+         * @param geom user geometry about to be read
+         */
+        void lockGeometry (PalGeometry *geom);
+
+        /**
+         * \brief the user geometry has been read
+         */
+        void unlockGeometry (PalGeometry *geom);
+
+        /**
+         * \brief add coordinates to the cache
+         *
+         * The cache takes ownership of x, y and of the holes' coordinates,
+         * which are set to NULL in holes. If the part is already cached,
+         * given coordinates are freed and the cached ones are kept. Borrowed
+         * coordinates are never freed by the cache.
+         * @param geom user geometry
+         * @param part part of the geometry
+         * @param nbPoints # points in x and y
+         * @param x x coordinates
+         * @param y y coordinates
+         * @param nbHoles # holes
+         * @param holes holes of the part
+         * @param borrowed coordinates belong to the user geometry
+         * @param use if true, the entry is returned marked as used (see acquire())
+         * @return the entry if use is true, NULL otherwise
+         */
+        CoordEntry *insert (PalGeometry *geom, int part, int nbPoints, double *x, double *y,
+                            int nbHoles, PointSet **holes, bool borrowed, bool use);
+
+        /**
+         * \brief simplified copies of a part and of its holes
+         *
+         * Computed on first use and kept with the coordinates of the part, their
+         * size counts in the memory budget. Copies stay valid while the entry is
+         * in use, even if other tolerances are asked for meanwhile. Once the
+         * entry is released by all its users, only the copies for the most
+         * recently used tolerance are kept.
+         * @param entry entry of the part, in use by the caller
+         * @param shape the part, with the entry's coordinates
+         * @param holes holes of the part, with the entry's coordinates
+         * @param tolerance see PointSet::simplify()
+         * @return simplified part then holes [1 + nbHoles], NULL items when no
+         * point can be removed
+         */
+        PointSet **getSimplified (CoordEntry *entry, PointSet *shape, PointSet **holes, double tolerance);
+
+        /**
+         * \brief coordinates are not used anymore by the caller
+         */
+        void release (CoordEntry *entry);
+
+        /**
+         * \brief forget a part (its geometry is about to be deleted)
+         */
+        void remove (PalGeometry *geom, int part);
+
+        /**
+         * \brief change the memory budget
+         * @param maxSize budget in bytes (0 keeps only coordinates in use)
+         */
+        void setMaxSize (size_t maxSize);
+
+        size_t getMaxSize ();
+
+        /**
+         * \brief # bytes currently held
+         */
+        size_t getSize ();
+
+        long getNbHits ();
+        long getNbMisses ();
+    };
+
+} // namespace pal
+
+#endif
@@ -43,11 +43,15 @@
 #include <pal/layer.h>
 
 #include "linkedlist.hpp"
+#include "arena.h"
+#include "candidatecache.h"
+#include "coordcache.h"
 #include "feature.h"
 #include "geomfunction.h"
 #include "labelposition.h"
 #include "pointset.h"
 #include "simplemutex.h"
+#include "snapshot.h"
 #include "util.h"
 
 #ifndef M_PI
@@ -98,22 +102,98 @@ namespace pal {
 
         distlabel = 0;
         currentAccess = 0;
+        coords = NULL;
+
+        mapped = false;
+        mappedCoord = false;
+
+        accessMutex = new SimpleMutex();
+    }
+
+
+    Feature::Feature (const SnapshotFeature *sf, const SnapshotHole *holes, const char *ids,
+                      const double *coords, Layer *layer, PalGeometry *userGeom) :
+            layer (layer), nPart (sf->nPart), part (sf->part), userGeom (userGeom) {
+        int i;
+
+        uid = const_cast<char*> (ids + sf->uid);
+
+        label_x = sf->label_x;
+        label_y = sf->label_y;
+        distlabel = sf->distlabel;
+
+        xmin = sf->xmin;
+        xmax = sf->xmax;
+        ymin = sf->ymin;
+        ymax = sf->ymax;
+
+        type = sf->type;
+        nbPoints = sf->nbPoints;
+
+        mapped = true;
+        mappedCoord = (sf->coord >= 0);
+
+        // borrowed for good, see fetchCoordinates()
+        if (mappedCoord) {
+            x = const_cast<double*> (coords + sf->coord);
+            y = x + nbPoints;
+        } else {
+            x = NULL;
+            y = NULL;
+        }
+
+        holeOf = NULL;
+        nbSelfObs = sf->nbHoles;
+        selfObs = (nbSelfObs > 0 ? new PointSet*[nbSelfObs] : NULL);
+        for (i = 0;i < nbSelfObs;i++) {
+            const SnapshotHole *sh = holes + sf->firstHole + i;
+            PointSet *hole = new PointSet();
+            hole->holeOf = this;
+            hole->nbPoints = sh->nbPoints;
+            hole->xmin = sh->xmin;
+            hole->xmax = sh->xmax;
+            hole->ymin = sh->ymin;
+            hole->ymax = sh->ymax;
+            if (mappedCoord) {
+                hole->x = const_cast<double*> (coords + sh->coord);
+                hole->y = hole->x + hole->nbPoints;
+            }
+            selfObs[i] = hole;
+        }
+
+        currentAccess = 0;
+        this->coords = NULL;
 
         accessMutex = new SimpleMutex();
     }
 
 
     Feature::~Feature() {
-        if (x || y) {
-            std::cout << "Warning: coordinates not released: " << layer->name << "/" << uid << std::endl;
+        int i;
+
+        if (mappedCoord) {
+            // not ours
+            x = NULL;
+            y = NULL;
+            for (i = 0;i < nbSelfObs;i++) {
+                selfObs[i]->x = NULL;
+                selfObs[i]->y = NULL;
+            }
+        } else {
+            if (x || y) {
+                std::cout << "Warning: coordinates not released: " << layer->name << "/" << uid << std::endl;
+            }
+
+            layer->pal->coordCache->remove (userGeom, part);
         }
 
-        if (uid) {
+        layer->pal->candidateCache->invalidate (this);
+
+        if (uid && !mapped) {
             delete[] uid;
         }
 
         if (nbSelfObs) {
-            int i;
             for (i = 0;i < nbSelfObs;i++) {
                 if (selfObs[i]->x || selfObs[i]->y) {
                     std::cout << "Warning: hole coordinates not released" << std::endl;
@@ -135,7 +215,22 @@ namespace pal {
         return uid;
     }
 
-    int Feature::setPositionForPoint (double x, double y, double scale, LabelPosition ***lPos, double delta_width) {
+    /*
+     * Append lp to positions, an array carved from the arena which is
+     * doubled when full
+     */
+    static void pushCandidate (LabelPosition ***positions, int *nbp, int *capacity, LabelPosition *lp, Arena *arena) {
+        if (*nbp == *capacity) {
+            *capacity = (*capacity == 0 ? 64 : *capacity * 2);
+            LabelPosition **tmp = arena->allocArray<LabelPosition*> (*capacity);
+            if (*nbp > 0)
+                memcpy (tmp, *positions, sizeof (LabelPosition*) * *nbp);
+            *positions = tmp;
+        }
+        (*positions) [ (*nbp) ++] = lp;
+    }
+
+    int Feature::setPositionForPoint (double x, double y, double scale, LabelPosition ***lPos, double delta_width, Arena *arena) {
 
 #ifdef _DEBUG_
         std::cout << "SetPosition (point) : " << layer->name << "/" << uid << std::endl;
@@ -207,7 +302,7 @@ namespace pal {
             std::cout << "Oups... label size error..." << std::endl;
         }
 
-        *lPos = new LabelPosition *[nbp];
+        *lPos = arena->allocArray<LabelPosition*> (nbp);
 
         for (i = 0, alpha = M_PI / 4;i < nbp;i++, alpha += beta) {
             lx = x;
@@ -257,7 +352,7 @@ namespace pal {
             else
                 cost =  0.0001 + 0.0020 * double (icost) / double (nbp - 1);
 
-            (*lPos) [i] = new LabelPosition (i, lx, ly, xrm, yrm, 0, cost,  this);
+            (*lPos) [i] = new (arena) LabelPosition (i, lx, ly, xrm, yrm, 0, cost,  this);
 
             icost += inc;
 
@@ -275,7 +370,7 @@ namespace pal {
     }
 
 // TODO work with squared distance by remonving call to sqrt or dist_euc2d
-    int Feature::setPositionForLine (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width) {
+    int Feature::setPositionForLine (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width, Arena *arena) {
 #ifdef _DEBUG_
         std::cout << "SetPosition (line) : " << layer->name << "/" << uid << std::endl;
 #endif
@@ -313,7 +408,9 @@ namespace pal {
 
         //shapes_final     = new LinkedList<PointSet*>(ptrPSetCompare);
 
-        LinkedList<LabelPosition*> *positions = new LinkedList<LabelPosition*> (ptrLPosCompare);
+        LabelPosition **positions = NULL;
+        int nbp = 0;
+        int maxp = 0;
 
         int nbPoints;
         double *x;
@@ -407,15 +504,15 @@ namespace pal {
             std::cout << "  Create new label" << std::endl;
 #endif
             if (layer->arrangement == P_LINE_AROUND) {
-                positions->push_back (new LabelPosition (i, bx + cos (beta) *distlabel , by + sin (beta) *distlabel, xrm, yrm, alpha, cost, this)); // Line
-                positions->push_back (new LabelPosition (i, bx - cos (beta) * (distlabel + yrm) , by - sin (beta) * (distlabel + yrm), xrm, yrm, alpha, cost, this)); // Line
+                pushCandidate (&positions, &nbp, &maxp, new (arena) LabelPosition (i, bx + cos (beta) *distlabel , by + sin (beta) *distlabel, xrm, yrm, alpha, cost, this), arena); // Line
+                pushCandidate (&positions, &nbp, &maxp, new (arena) LabelPosition (i, bx - cos (beta) * (distlabel + yrm) , by - sin (beta) * (distlabel + yrm), xrm, yrm, alpha, cost, this), arena); // Line
             }
             /*else if (layer->arrangement == P_HORIZ){ // TODO add P_HORIZ
                positions->push_back (new LabelPosition (i, bx -yrm/2, by - yrm*sin(beta)/2, xrm, yrm, alpha, cost, this, line)); // Line
               line->aliveCandidates++;
             }*/
             else {
-                positions->push_back (new LabelPosition (i, bx - yrm*cos (beta) / 2, by - yrm*sin (beta) / 2, xrm, yrm, alpha, cost, this)); // Line
+                pushCandidate (&positions, &nbp, &maxp, new (arena) LabelPosition (i, bx - yrm*cos (beta) / 2, by - yrm*sin (beta) / 2, xrm, yrm, alpha, cost, this), arena); // Line
             }
 
             l += dist;
@@ -431,15 +528,7 @@ namespace pal {
         delete[] d;
         delete[] ad;
 
-        int nbp = positions->size();
-        *lPos = new LabelPosition *[nbp];
-        i = 0;
-        while (positions->size() > 0) {
-            (*lPos) [i] = positions->pop_front();
-            i++;
-        }
-
-        delete positions;
+        *lPos = positions;
 
         return nbp;
     }
@@ -457,7 +546,7 @@ namespace pal {
      *
      */
 
-    int Feature::setPositionForPolygon (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width) {
+    int Feature::setPositionForPolygon (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width, Arena *arena) {
 
 #ifdef _DEBUG_
         std::cout << "SetPosition (polygon) : " << layer->name << "/" << uid << std::endl;
@@ -501,7 +590,8 @@ namespace pal {
         int nbp;
 
         if (shapes_final->size() > 0) {
-            LinkedList<LabelPosition*> *positions = new LinkedList<LabelPosition*> (ptrLPosCompare);
+            LabelPosition **positions = NULL;
+            int maxp = 0;
             int it;
 
             double dlx, dly; // delta from label center and bottom-left corner
@@ -532,6 +622,7 @@ namespace pal {
 
             int num_try = 0;
             int max_try = 10;
+            nbp = 0;
             do {
                 for (bbid = 0;bbid < j;bbid++) {
                     CHullBox *box = boxes[bbid];
@@ -621,13 +712,12 @@ namespace pal {
 
                             // Only accept candidate that center is in the polygon
                             if (isPointInPolygon (mapShape->nbPoints, mapShape->x, mapShape->y, rx,  ry)) {
-                                positions->push_back (new LabelPosition (0, rx - dlx, ry - dly , xrm, yrm, alpha, 0.0001, this)); // Polygon
+                                pushCandidate (&positions, &nbp, &maxp, new (arena) LabelPosition (0, rx - dlx, ry - dly , xrm, yrm, alpha, 0.0001, this), arena); // Polygon
                             }
                         }
                     }
                 } // forall box
 
-                nbp = positions->size();
                 if (nbp == 0) {
                     dx /= 2;
                     dy /= 2;
@@ -635,20 +725,15 @@ namespace pal {
                 }
             } while (nbp == 0 && num_try < max_try);
 
-            nbp = positions->size();
-
-            (*lPos) = new LabelPosition*[nbp];
-            for (i = 0;i < nbp;i++) {
-                (*lPos) [i] = positions->pop_front();
+            (*lPos) = positions;
+            for (i = 0;i < nbp;i++)
                 (*lPos) [i]->id = i;
-            }
 
             for (bbid = 0;bbid < j;bbid++) {
                 delete boxes[bbid];
             }
 
             delete[] boxes;
-            delete positions;
         } else {
             nbp = 0;
         }
@@ -682,7 +767,7 @@ namespace pal {
 
     int Feature::setPosition (double scale, LabelPosition ***lPos,
                               double bbox_min[2], double bbox_max[2],
-                              PointSet *mapShape, RTree<LabelPosition*, double, 2, double> *candidates
+                              PointSet *mapShape, RTree<LabelPosition*, double, 2, double> *candidates, Arena *arena, bool useCache
 #ifdef _EXPORT_MAP_
                               , std::ofstream &svgmap
 #endif
@@ -702,38 +787,63 @@ namespace pal {
 
         double delta = bbox_max[0] - bbox_min[0];
 
-        switch (type) {
-        case GEOS_POINT:
-            fetchCoordinates ();
-            nbp = setPositionForPoint (x[0], y[0], scale, lPos, delta);
+        CandidateCache *cache = layer->pal->candidateCache;
+        CandidateKey key;
+
+        nbp = -1;
+        if (useCache) {
+            key.scale = scale;
+            key.dpi = layer->pal->dpi;
+            key.mapUnit = layer->pal->map_unit;
+            key.width = (key.mapUnit == pal::DEGREE ? delta : 0);
+            key.label_x = label_x;
+            key.label_y = label_y;
+            key.distlabel = distlabel;
+            key.arrangement = layer->arrangement;
+            key.labelUnit = layer->label_unit;
+            key.point_p = layer->pal->point_p;
+            key.simplifyTolerance = layer->pal->simplifyTolerance;
+
+            nbp = cache->get (this, &key, lPos, arena);
+        }
+
+        if (nbp < 0) {
+            switch (type) {
+            case GEOS_POINT:
+                fetchCoordinates ();
+                nbp = setPositionForPoint (x[0], y[0], scale, lPos, delta, arena);
 #ifdef _EXPORT_MAP_
-            toSVGPath (nbPoints, type, x, y, dpi , scale, layer->pal->map_unit,
-                       convert2pt (bbox_min[0], scale, dpi, layer->label_unit, delta),
-                       convert2pt (bbox_max[0], scale, dpi, layer->label_unit, delta),
-                       convert2pt (bbox_max[1], scale, dpi, layer->label_unit, delta),
-                       layer->name, uid, svgmap);
+                toSVGPath (nbPoints, type, x, y, dpi , scale, layer->pal->map_unit,
+                           convert2pt (bbox_min[0], scale, dpi, layer->label_unit, delta),
+                           convert2pt (bbox_max[0], scale, dpi, layer->label_unit, delta),
+                           convert2pt (bbox_max[1], scale, dpi, layer->label_unit, delta),
+                           layer->name, uid, svgmap);
 #endif
-            releaseCoordinates();
-            break;
-        case GEOS_LINESTRING:
-            nbp = setPositionForLine (scale, lPos, mapShape, delta);
-            break;
-
-        case GEOS_POLYGON:
-            switch (layer->getArrangement()) {
-            case P_POINT:
-                double cx, cy;
-                mapShape->getCentroid (cx, cy);
-                nbp = setPositionForPoint (cx, cy, scale, lPos, delta);
-                break;
-            case P_LINE:
-            case P_LINE_AROUND:
-                nbp = setPositionForLine (scale, lPos, mapShape, delta);
+                releaseCoordinates();
                 break;
-            default:
-                nbp = setPositionForPolygon (scale, lPos, mapShape, delta);
+            case GEOS_LINESTRING:
+                nbp = setPositionForLine (scale, lPos, mapShape, delta, arena);
                 break;
+
+            case GEOS_POLYGON:
+                switch (layer->getArrangement()) {
+                case P_POINT:
+                    double cx, cy;
+                    mapShape->getCentroid (cx, cy);
+                    nbp = setPositionForPoint (cx, cy, scale, lPos, delta, arena);
+                    break;
+                case P_LINE:
+                case P_LINE_AROUND:
+                    nbp = setPositionForLine (scale, lPos, mapShape, delta, arena);
+                    break;
+                default:
+                    nbp = setPositionForPolygon (scale, lPos, mapShape, delta, arena);
+                    break;
+                }
             }
+
+            if (useCache)
+                cache->insert (this, &key, nbp, *lPos);
         }
 
         int rnbp = nbp;
@@ -743,67 +853,108 @@ namespace pal {
             if (! (*lPos) [i]->isIn (bbox)) {
                 rnbp--;
                 (*lPos) [i]->cost = DBL_MAX;
-            } else { // this one is OK
+            } else if (candidates) { // this one is OK
                 (*lPos) [i]->insertIntoIndex (candidates);
             }
         }
 
+        // candidates outside the bbox are left in the arena
         sort ( (void**) (*lPos), nbp, costGrow);
 
-        for (i = rnbp;i < nbp;i++) {
-            delete (*lPos) [i];
-        }
-
         return rnbp;
     }
 
 
     void Feature::fetchCoordinates() {
         accessMutex->lock();
-        layer->pal->tmpTime -= clock();
         if (!x && !y) {
-            //std::cout << "fetch feat " << layer->name << "/" << uid << std::endl;
-            the_geom = userGeom->getGeosGeometry();
-            LinkedList<Feat*> *feats = splitGeom (the_geom, this->uid);
-            int id = 0;
-            while (feats->size() > 0) {
-                Feat *f = feats->pop_front();
-                if (id == this->part) {
-                    x = f->x;
-                    y = f->y;
-                    int i;
-                    for (i = 0;i < nbSelfObs;i++) {
-                        selfObs[i]->x = f->holes[i]->x;
-                        selfObs[i]->y = f->holes[i]->y;
-                        f->holes[i]->x = NULL;
-                        f->holes[i]->y = NULL;
-                        delete f->holes[i];
-                        selfObs[i]->holeOf = this;
+            CoordCache *cache = layer->pal->coordCache;
+            int i;
+
+            coords = cache->acquire (userGeom, part);
+
+            if (!coords) {
+                // sibling parts may be fetched by other threads
+                cache->lockGeometry (userGeom);
+                coords = cache->acquire (userGeom, part, false);
+
+                if (!coords) {
+                    //std::cout << "fetch feat " << layer->name << "/" << uid << std::endl;
+                    LinkedList<Feat*> *feats;
+                    if (userGeom->getNbParts() >= 0) {
+                        feats = splitUserGeom (userGeom, this->uid);
+                    } else {
+                        GEOSGeometry *the_geom = userGeom->getGeosGeometry();
+                        feats = splitGeom (the_geom, this->uid);
+                        userGeom->releaseGeosGeometry (the_geom);
+                    }
+
+                    // keep every part, siblings will need them soon, but not
+                    // skipped parts : no feature would remove them from the cache
+                    int id = 0;
+                    while (feats->size() > 0) {
+                        Feat *f = feats->pop_front();
+                        if (!isLabellableFeat (f)) {
+                            deleteFeat (f);
+                            id++;
+                            continue;
+                        }
+
+                        CoordEntry *entry = cache->insert (userGeom, id, f->nbPoints, f->x, f->y,
+                                                           f->nbHoles, f->holes, f->borrowed, id == this->part);
+                        if (entry)
+                            coords = entry;
+
+                        for (i = 0;i < f->nbHoles;i++)
+                            delete f->holes[i];
+                        if (f->holes)
+                            delete[] f->holes;
+                        delete f;
+
+                        id++;
                     }
-                    if (f->holes)
-                        delete[] f->holes;
-                    delete f;
-                } else {
-                    delete[] f->x;
-                    delete[] f->y;
-                    int i;
-                    for (i = 0;i < f->nbHoles;i++)
-                        delete f->holes[i];
-                    if (f->holes)
-                        delete[] f->holes;
-                    delete f;
+                    delete feats;
                 }
 
-                id++;
+                cache->unlockGeometry (userGeom);
+            }
+
+            x = coords->x;
+            y = coords->y;
+            for (i = 0;i < nbSelfObs;i++) {
+                selfObs[i]->x = coords->holesX[i];
+                selfObs[i]->y = coords->holesY[i];
+                selfObs[i]->holeOf = this;
             }
-            delete feats;
         }
         currentAccess++;
-        layer->pal->tmpTime += clock();
         accessMutex->unlock();
     }
 
 
+    PointSet *Feature::getSimplified (PointSet *pset, double tolerance) {
+        int i;
+        Feature *feat = (Feature*) (pset->holeOf ? pset->holeOf : pset);
+
+        // memory-mapped coordinates are used as they are
+        if (tolerance <= 0 || !feat->coords)
+            return pset;
+
+        PointSet **simplified = feat->layer->pal->coordCache->getSimplified (feat->coords, feat, feat->selfObs, tolerance);
+
+        PointSet *shape = NULL;
+        if (pset == feat) {
+            shape = simplified[0];
+        } else {
+            for (i = 0;i < feat->nbSelfObs;i++)
+                if (feat->selfObs[i] == pset)
+                    shape = simplified[i+1];
+        }
+
+        return (shape ? shape : pset);
+    }
+
+
     void Feature::deleteCoord() {
         if (x && y) {
             int i;
@@ -822,12 +973,28 @@ namespace pal {
 
 
 
+    void Feature::cacheCoord (bool borrowed) {
+        if (x && y) {
+            layer->pal->coordCache->insert (userGeom, part, nbPoints, x, y, nbSelfObs, selfObs, borrowed, false);
+            x = NULL;
+            y = NULL;
+        }
+    }
+
+
     void Feature::releaseCoordinates() {
         accessMutex->lock();
         //std::cout << "release (" << currentAccess << ")" << std::endl;
-        if (x && y && currentAccess == 1) {
-            deleteCoord();
-            userGeom->releaseGeosGeometry (the_geom);
+        if (x && y && currentAccess == 1 && !mappedCoord) {
+            int i;
+            x = NULL;
+            y = NULL;
+            for (i = 0;i < nbSelfObs;i++) {
+                selfObs[i]->x = NULL;
+                selfObs[i]->y = NULL;
+            }
+            layer->pal->coordCache->release (coords);
+            coords = NULL;
         }
         currentAccess--;
         accessMutex->unlock();
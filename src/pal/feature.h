@@ -47,7 +47,11 @@ namespace pal {
     class Pal;
     class Layer;
     class LabelPosition;
+    class Arena;
     class SimpleMutex;
+    struct _coordentry;
+    struct _snapshotfeature;
+    struct _snapshothole;
 
     /**
      * \brief Main class to handle feature
@@ -58,8 +62,10 @@ namespace pal {
         friend class Layer;
         friend class Problem;
         friend class LabelPosition;
+        friend class LabellingSession;
 
         friend bool extractFeatCallback (Feature *ft_ptr, void *ctx);
+        friend void generateCandidatesJob (int job, int thread, void *ctx);
         friend bool pruneLabelPositionCallback (LabelPosition *lp, void *ctx);
         friend bool obstacleCallback (PointSet *feat, void *ctx);
         //friend void setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]);
@@ -80,7 +86,10 @@ namespace pal {
 
         int distlabel;
 
-        GEOSGeometry *the_geom;
+        /**
+         * cached coordinates in use (NULL when not fetched)
+         */
+        struct _coordentry *coords;
         int currentAccess;
 
         int nPart;
@@ -88,6 +97,16 @@ namespace pal {
 
         PalGeometry *userGeom;
 
+        /**
+         * uid lives in the layer's snapshot
+         */
+        bool mapped;
+
+        /**
+         * coordinates live in the layer's snapshot, they are never released
+         */
+        bool mappedCoord;
+
         SimpleMutex *accessMutex;
 
         /**
@@ -97,9 +116,10 @@ namespace pal {
          * \param y y coordinates of the point
          * \param scale map scale is 1:scale
          * \param lPos pointer to an array of candidates, will be filled by generated candidates
+         * \param arena candidates are allocated from it
          * \return the number of generated cadidates
          */
-        int setPositionForPoint (double x, double y, double scale, LabelPosition ***lPos, double delta_width);
+        int setPositionForPoint (double x, double y, double scale, LabelPosition ***lPos, double delta_width, Arena *arena);
 
         /**
          * \brief generate candidates for line feature
@@ -107,9 +127,10 @@ namespace pal {
          * \param scale map scale is 1:scale
          * \param lPos pointer to an array of candidates, will be filled by generated candidates
          * \param mapShape a pointer to the line
+         * \param arena candidates are allocated from it
          * \return the number of generated cadidates
          */
-        int setPositionForLine (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width);
+        int setPositionForLine (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width, Arena *arena);
 
         /**
          * \brief generate candidates for point feature
@@ -117,9 +138,10 @@ namespace pal {
          * \param scale map scale is 1:scale
          * \param lPos pointer to an array of candidates, will be filled by generated candidates
          * \param mapShape a pointer to the polygon
+         * \param arena candidates are allocated from it
          * \return the number of generated cadidates
          */
-        int setPositionForPolygon (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width);
+        int setPositionForPolygon (double scale, LabelPosition ***lPos, PointSet *mapShape, double delta_width, Arena *arena);
 
 
 
@@ -145,6 +167,21 @@ namespace pal {
         Feature (Feat *feat, Layer *layer, int part, int nPart, PalGeometry *userGeom);
 
 
+        /**
+         * \brief create a feature from a layer snapshot
+         *
+         * uid and coordinates are used in place and must stay mapped as long as the feature lives
+         * \param sf the feature in the snapshot
+         * \param holes holes of the snapshot
+         * \param ids ids section of the snapshot
+         * \param coords coordinates section of the snapshot
+         * \param layer feature is in this layer
+         * \param userGeom user's geometry (can be NULL when coordinates are in the snapshot)
+         */
+        Feature (const struct _snapshotfeature *sf, const struct _snapshothole *holes, const char *ids,
+                 const double *coords, Layer *layer, PalGeometry *userGeom);
+
+
         /**
         * \brief Used to load pre-computed feature
         * \param file the file open by  Pal::Pal(const char *pal_file)
@@ -184,11 +221,13 @@ namespace pal {
          * \param bbox_min min values of the map extent
          * \param bbox_max max values of the map extent
          * \param mapShape generate candidates for this spatial entites
-         * \param candidates index for candidates
+         * \param candidates index for candidates (can be NULL, the caller has then to index kept candidates)
+         * \param arena candidates and the *lPos array are allocated from it and must not be deleted
+         * \param useCache mapShape is the whole feature : candidates can be taken from and kept into Pal's candidates cache
          * \param svgmap svg map file
          * \return the number of candidates in *lPos
          */
-        int setPosition (double scale, LabelPosition ***lPos, double bbox_min[2], double bbox_max[2], PointSet *mapShape, RTree<LabelPosition*, double, 2, double>*candidates
+        int setPosition (double scale, LabelPosition ***lPos, double bbox_min[2], double bbox_max[2], PointSet *mapShape, RTree<LabelPosition*, double, 2, double>*candidates, Arena *arena, bool useCache
 #ifdef _EXPORT_MAP_
                          , std::ofstream &svgmap
 #endif
@@ -231,8 +270,34 @@ namespace pal {
 
         void deleteCoord();
 
+        /**
+         * \brief give the feature's coordinates to Pal's coordinates cache
+         *
+         * Called once the feature is registered, so that the first labelling
+         * does not need to fetch the geometry again.
+         * @param borrowed coordinates belong to the user geometry
+         */
+        void cacheCoord (bool borrowed);
+
+        /**
+         * \brief make coordinates (and holes coordinates) available
+         *
+         * Coordinates are taken from Pal's coordinates cache or extracted from
+         * the user geometry when they are not cached.
+         */
         void fetchCoordinates();
         void releaseCoordinates();
+
+        /**
+         * \brief simplified copy of a feature or of one of its holes
+         *
+         * The copy is kept in Pal's coordinates cache beside the feature's
+         * coordinates, which must be fetched.
+         * @param pset the feature or one of its holes
+         * @param tolerance see PointSet::simplify(), 0 to disable the simplification
+         * @return the simplified shape, or pset
+         */
+        static PointSet *getSimplified (PointSet *pset, double tolerance);
     };
 
 } // end namespace pal
@@ -431,8 +431,8 @@ namespace pal {
         return top + 1;
     }
 
-// reorder points to have cross prod ((x,y)[i], (x,y)[i+1), point) > 0 when point is outside
-    int reorderPolygon (int nbPoints, double *x, double *y) {
+// orientation of points : 1 when cross prod ((x,y)[i], (x,y)[i+1), point) > 0 when point is outside, -1 when reversed
+    int polygonOrientation (int nbPoints, const double *x, const double *y) {
         int inc = 0;
         int *cHull;
         int cHullSize;
@@ -467,14 +467,24 @@ namespace pal {
                 std::cout << pts[cHull[i]] << " ";
             }
             std::cout << std::endl;
-            delete[] cHull;
-            delete[] pts;
-            return -1;
         }
 
+        delete[] cHull;
+        delete[] pts;
+
+        return inc;
+    }
+
+// reorder points to have cross prod ((x,y)[i], (x,y)[i+1), point) > 0 when point is outside
+    int reorderPolygon (int nbPoints, double *x, double *y) {
+        int inc = polygonOrientation (nbPoints, x, y);
+
+        if (inc == 0)
+            return -1;
+
         if (inc == -1) { // re-order points
             double tmp;
-            int j;
+            int i, j;
             for (i = 0, j = nbPoints - 1;i <= j;i++, j--) {
                 tmp = x[i];
                 x[i] = x[j];
@@ -486,12 +496,7 @@ namespace pal {
             }
         }
 
-
-        delete[] cHull;
-        delete[] pts;
-
         return 0;
-
     }
 
 
@@ -34,6 +34,16 @@
 
 namespace pal {
 
+    /**
+     * \brief candidate shapes, select geometric tests at compile time
+     *
+     * RotatedRect tests work for any candidate, AxisAlignedRect ones only
+     * for unrotated candidates (see LabelPosition::isAxisAligned()) and
+     * give the very same results.
+     */
+    struct RotatedRect {};
+    struct AxisAlignedRect {};
+
     /*
      *           o(x2,y2)
      *          /
@@ -72,6 +82,7 @@ namespace pal {
     }*/
 
 
+    template <class Shape>
     inline int nbLabelPointInPolygon (int npol, double *xp, double *yp, double x[4], double y[4]) {
         int a, k, count = 0;
         double px, py;
@@ -99,6 +110,57 @@ namespace pal {
         return count;
     }
 
+    /*
+     * Samples of an unrotated label lie on three rows and three columns :
+     * each polygon edge is intersected once per row instead of once per sample
+     */
+    template <>
+    inline int nbLabelPointInPolygon<AxisAlignedRect> (int npol, double *xp, double *yp, double x[4], double y[4]) {
+        int i, j, r, c, count;
+        double xcross;
+        double sx[3];
+        double sy[3];
+        bool in[3][3];
+
+        sx[0] = x[0];
+        sx[1] = (x[0] + x[1]) / 2.0;
+        sx[2] = x[1];
+
+        sy[0] = y[0];
+        sy[1] = (y[0] + y[3]) / 2.0;
+        sy[2] = y[3];
+
+        for (r = 0;r < 3;r++)
+            for (c = 0;c < 3;c++)
+                in[r][c] = false;
+
+        // same crossing test as isPointInPolygon()
+        for (i = 0, j = npol - 1; i < npol; j = i++) {
+            for (r = 0;r < 3;r++) {
+                if ( ( (yp[i] <= sy[r]) && (sy[r] < yp[j])) ||
+                        ( (yp[j] <= sy[r]) && (sy[r] < yp[i]))) {
+                    xcross = (xp[j] - xp[i]) * (sy[r] - yp[i]) / (yp[j] - yp[i]) + xp[i];
+                    for (c = 0;c < 3;c++) {
+                        if (sx[c] < xcross)
+                            in[r][c] = !in[r][c];
+                    }
+                }
+            }
+        }
+
+        count = 0;
+        for (r = 0;r < 3;r++)
+            for (c = 0;c < 3;c++)
+                if (in[r][c])
+                    count++;
+
+        // the label center is virtually 4 points
+        if (in[1][1])
+            count += 3;
+
+        return count;
+    }
+
 
 
     int convexHull (int *id, const double* const x, const double* const y, int n);
@@ -166,6 +228,12 @@ namespace pal {
                     std::ostream &out);
 #endif
 
+    /**
+     * \brief orientation of a polygon
+     * @return 1 when points are in the order expected by pal, -1 when reversed, 0 on error
+     */
+    int polygonOrientation (int nbPoints, const double *x, const double *y);
+
     int reorderPolygon (int nbPoints, double *x, double *y);
 
 } // end namespace
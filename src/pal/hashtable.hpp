@@ -33,234 +33,317 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
-
-#include "linkedlist.hpp"
+#include <iostream>
 
 namespace pal {
 
+    /**
+     * \brief append-only storage for the keys of an HashTable
+     *
+     * Keys are copied one after the other into large blocks, so that
+     * inserting a key costs no allocation most of the time and a key
+     * never moves once interned.
+     */
+    class KeyPool {
+    private:
+        char **blocks;
+        int nbBlocks;
+        int maxBlocks;
+        size_t used;     // bytes used in the last block
+        size_t avail;    // size of the last block
+
+        static const size_t blockSize = 65536;
+
+    public:
+        KeyPool() : blocks (NULL), nbBlocks (0), maxBlocks (0), used (0), avail (0) {
+        }
+
+        ~KeyPool() {
+            for (int i = 0;i < nbBlocks;i++)
+                delete[] blocks[i];
+            delete[] blocks;
+        }
+
+        /**
+         * \brief copy key into the pool
+         * @return the interned copy, valid until the pool is deleted
+         */
+        const char *intern (const char *key, size_t len) {
+            if (used + len + 1 > avail) {
+                if (nbBlocks == maxBlocks) {
+                    maxBlocks = (maxBlocks == 0 ? 16 : maxBlocks * 2);
+                    char **tmp = new char*[maxBlocks];
+                    if (blocks) {
+                        memcpy (tmp, blocks, sizeof (char*) * nbBlocks);
+                        delete[] blocks;
+                    }
+                    blocks = tmp;
+                }
+                avail = (len + 1 > blockSize ? len + 1 : blockSize);
+                blocks[nbBlocks++] = new char[avail];
+                used = 0;
+            }
+
+            char *copy = blocks[nbBlocks-1] + used;
+            memcpy (copy, key, len + 1);
+            used += len + 1;
+            return copy;
+        }
+    };
+
+
 // Each hash entry stores a key, object pair
     template <typename Data>
     struct HashTableEntry {
-        char * _key;
+        unsigned long _hash;
+        const char * _key;    // NULL for an empty slot
         Data _data;
     };
 
 
-// This is a Hash table that maps string keys to objects of type Data
+    /**
+     * \brief Hash table that maps string keys to objects of type Data
+     *
+     * Open addressing with linear probing in a single array of entries.
+     * Each entry keeps the full hash of its key so probing only compares
+     * strings whose hashes match, and growing does not hash keys again.
+     * The table doubles when it becomes 70% full.
+     *
+     * Pointers returned by find() are invalidated by the next insertion.
+     * Keys are interned: removing an element does not release its key.
+     */
     template <typename Data>
     class HashTable {
     public:
-        int tableSize;
+        int tableSize;    // # slots, a power of 2
+        int nbItems;
 
-        LinkedList<HashTableEntry<Data>*> **_hashtable;
+        HashTableEntry<Data> *_hashtable;
+        KeyPool *keys;
 
-        unsigned long hash (const char * key);
+        unsigned long hash (const char * key, size_t *len);
+
+        /**
+         * \brief slot holding key, or the empty slot ending its probe sequence
+         */
+        int lookup (const char *key, unsigned long h);
+
+        void grow ();
 
     public:
+        /**
+         * \brief create an empty table
+         * @param tableSize expected # elements
+         */
         HashTable (int tableSize);
         ~HashTable();
         bool insertItem (const char * key, Data data);
         Data* find (const char * key);
+
+        /**
+         * \brief look up several keys at once
+         *
+         * All hashes are computed before the first probe, so the slots
+         * of the whole batch are fetched from memory together.
+         *
+         * @param nbKeys # keys to look up
+         * @param keys the keys
+         * @param data filled with the data of each key or NULL when the key is unknown
+         */
+        void find (int nbKeys, const char **keys, Data **data);
+
         bool removeElement (const char * key);
 
+        int size ();
+
         void printStat();
     };
 
     template <typename Data> HashTable<Data>::~HashTable() {
-        int i;
-        LinkedList<HashTableEntry<Data>*> *list;
-        HashTableEntry <Data> *entry;
-
-        for (i = 0;i < tableSize;i++) {
-            list = _hashtable[i];
-            if (list) {
-                while (list->size() > 0) {
-                    entry = list->pop_front();
-                    delete[] entry->_key;
-                    delete entry;
-                }
-                delete list;
-            }
-        }
         delete[] _hashtable;
-
+        delete keys;
     }
-    template <typename Data>
-    unsigned long HashTable<Data>::hash (const char * key) {
-        unsigned long hash = 5381;
-        int c;
 
-        while ( (c = *key++)) {
-            hash = ( (hash << 5) + hash) + c; // hash*33 + c
+    template <typename Data>
+    unsigned long HashTable<Data>::hash (const char * key, size_t *len) {
+        // FNV-1a
+        unsigned long hash = 2166136261UL;
+        const char *c;
+
+        for (c = key;*c;c++) {
+            hash ^= (unsigned char) *c;
+            hash *= 16777619UL;
         }
+        *len = c - key;
 
-        return hash % tableSize;
+        // spread high bits onto the low ones used to pick the slot
+        return hash ^ (hash >> 15);
     }
 
 
     template <typename Data>
-    HashTable<Data>::HashTable (int tableSize) : tableSize (tableSize) {
-        // TODO: Initialize the hash table
-        _hashtable = new LinkedList<HashTableEntry<Data>*>*[tableSize];
+    HashTable<Data>::HashTable (int tableSize) {
+        this->tableSize = 16;
+        while (this->tableSize * 7 < tableSize * 10)
+            this->tableSize *= 2;
+
+        nbItems = 0;
+        _hashtable = new HashTableEntry<Data>[this->tableSize];
+        for (int i = 0; i < this->tableSize; i++)
+            _hashtable[i]._key = NULL;
 
+        keys = new KeyPool();
+    }
 
-        for (int i = 0; i < tableSize; i++) {
-            _hashtable[i] = NULL;
+    template <typename Data>
+    int HashTable<Data>::lookup (const char *key, unsigned long h) {
+        int mask = tableSize - 1;
+        int i = h & mask;
+
+        while (_hashtable[i]._key) {
+            if (_hashtable[i]._hash == h && strcmp (_hashtable[i]._key, key) == 0)
+                return i;
+            i = (i + 1) & mask;
         }
+        return i;
     }
 
-    template <class Data>
-    bool hashEntryCompare (HashTableEntry<Data> *a, HashTableEntry<Data> *b) {
-        return strcmp (a->_key, b->_key) == 0;
+    template <typename Data>
+    void HashTable<Data>::grow () {
+        HashTableEntry<Data> *old = _hashtable;
+        int oldSize = tableSize;
+        int i, j;
+        int mask;
+
+        tableSize *= 2;
+        mask = tableSize - 1;
+        _hashtable = new HashTableEntry<Data>[tableSize];
+        for (i = 0;i < tableSize;i++)
+            _hashtable[i]._key = NULL;
+
+        for (i = 0;i < oldSize;i++) {
+            if (old[i]._key) {
+                for (j = old[i]._hash & mask;_hashtable[j]._key;j = (j + 1) & mask);
+                _hashtable[j] = old[i];
+            }
+        }
+        delete[] old;
     }
 
     template <typename Data>
     bool HashTable<Data>::insertItem (const char * key, Data data) {
-        unsigned long i = hash (key);
-
-        LinkedList<HashTableEntry<Data>*> *e = _hashtable[i];
-
-        HashTableEntry<Data> *entry = new HashTableEntry<Data>();
-        entry->_key = new char[strlen (key) +1];
-        strcpy (entry->_key, key);
-        entry->_data = data;
-
-        if (e) {
-            Cell<HashTableEntry<Data>*> *elem = e->search (entry);
-            if (elem) { // change data
-                elem->item->_data = data;
-                delete[] entry->_key;
-                delete entry;
-            } else {
-                e->push_back (entry);
-                return true;
-            }
-        } else {
-            e = _hashtable[i] = new LinkedList<HashTableEntry<Data>*> (hashEntryCompare);
-            e->push_back (entry);
-            return true;
+        size_t len;
+        unsigned long h = hash (key, &len);
+
+        int i = lookup (key, h);
+
+        if (_hashtable[i]._key) { // change data
+            _hashtable[i]._data = data;
+            return false;
         }
 
+        if ( (nbItems + 1) * 10 > tableSize * 7) {
+            grow();
+            i = lookup (key, h);
+        }
 
-        return false;
+        _hashtable[i]._hash = h;
+        _hashtable[i]._key = keys->intern (key, len);
+        _hashtable[i]._data = data;
+        nbItems++;
+
+        return true;
     }
 
 
     template <typename Data>
     Data* HashTable<Data>::find (const char * key) {
-        unsigned long i = hash (key);
+        size_t len;
+        int i = lookup (key, hash (key, &len));
 
-        HashTableEntry<Data> * entry = new HashTableEntry<Data> ();
-        entry->_key = new char[strlen (key) +1];
-        strcpy (entry->_key, key);
+        if (_hashtable[i]._key)
+            return & (_hashtable[i]._data);
+        else
+            return NULL;
+    }
 
-        LinkedList<HashTableEntry<Data>*> *e = _hashtable[i];
+    template <typename Data>
+    void HashTable<Data>::find (int nbKeys, const char **keys, Data **data) {
+        int k;
+        int i;
+        size_t len;
+        unsigned long *h = new unsigned long[nbKeys];
 
-        Cell<HashTableEntry<Data>*> *cell;
+        for (k = 0;k < nbKeys;k++) {
+            h[k] = hash (keys[k], &len);
+#ifdef __GNUC__
+            __builtin_prefetch (_hashtable + (h[k] & (tableSize - 1)));
+#endif
+        }
 
-        if (!e) {
-            delete[] entry->_key;
-            delete entry;
-            return NULL;
-        } else {
-            if ( (cell = e->search (entry)) == NULL) {
-                delete[] entry->_key;
-                delete entry;
-                return NULL;
-            } else {
-                delete[] entry->_key;
-                delete entry;
-                return & (cell->item->_data);
-            }
+        for (k = 0;k < nbKeys;k++) {
+            i = lookup (keys[k], h[k]);
+            data[k] = (_hashtable[i]._key ? & (_hashtable[i]._data) : NULL);
         }
+
+        delete[] h;
+    }
+
+    template <typename Data>
+    int HashTable<Data>::size () {
+        return nbItems;
     }
 
     template<typename Data>
     void HashTable<Data>::printStat() {
 
-        double c = 0;
-        int i;
-        int n = 0;
+        int i, j;
+        double probes = 0;
+        int mask = tableSize - 1;
 
         for (i = 0;i < tableSize;i++) {
-            if (_hashtable[i]) {
-                n++;
-                c += _hashtable[i]->size();
+            if (_hashtable[i]._key) {
+                for (j = _hashtable[i]._hash & mask;j != i;j = (j + 1) & mask)
+                    probes++;
+                probes++;
             }
         }
 
-        std::cout << "# elem: " << c << std::endl;
-        std::cout << "# linked list : " << n << " / " << tableSize << std::endl;
-        std::cout << "nb elem / real list" << c / n << std::endl;
-        std::cout << "nb elem / tableSize" << c / tableSize << std::endl;
+        std::cout << "# elem: " << nbItems << std::endl;
+        std::cout << "# slots : " << tableSize << std::endl;
+        std::cout << "nb elem / tableSize" << (double) nbItems / tableSize << std::endl;
+        std::cout << "probes / elem" << (nbItems > 0 ? probes / nbItems : 0) << std::endl;
     }
 
 
     template <typename Data>
     bool HashTable<Data>::removeElement (const char * key) {
-        // TODO: Remove the element that has this key from the hash table.
-        // Return true if the entry is found or false otherwise.
-        /*int i = hash(key);
-        HashTableEntry<Data> *eC = _buckets[i];
-        HashTableEntry<Data> *eP = NULL;
-
-        while(eC != NULL && strcmp(key, eC->_key) != 0)
-        {
-          eP = eC;
-          eC = eC->_next;
-        }
-
-        //key is found
-        if(eC != NULL)
-        {
-          if(eP != NULL)
-            eP->_next = eC->_next;
-          else
-            _buckets[i] = eC->_next;
-          return true;
+        size_t len;
+        int mask = tableSize - 1;
+        int i = lookup (key, hash (key, &len));
+        int j, home;
+
+        if (!_hashtable[i]._key)
+            return false;
+
+        // backward shift : move up following entries which can't be
+        // reached anymore once the slot is emptied
+        j = i;
+        for (;;) {
+            _hashtable[i]._key = NULL;
+            do {
+                j = (j + 1) & mask;
+                if (!_hashtable[j]._key) {
+                    nbItems--;
+                    return true;
+                }
+                home = _hashtable[j]._hash & mask;
+            } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+            _hashtable[i] = _hashtable[j];
+            i = j;
         }
-
-        //key is not found*/
-        return false;
     }
 
-
-/////////////////////////////////////
-//
-// Class used to iterate over the hash table
-//
-/////////////////////////////////////
-    /*template <typename Data>
-    class HashTableIterator {
-      int _currentBucket; // Current bucket that is being iterated
-      HashTableEntry<Data> *_currentEntry; // Current entry iterated
-      HashTable<Data> * _hashTable;  // Pointer to the hash table being iterated
-    public:
-      HashTableIterator(HashTable<Data> * hashTable);
-      bool next(const char * & key, Data & data);
-    };
-
-
-    template <typename Data>
-    HashTableIterator<Data>::HashTableIterator(HashTable<Data> * hashTable)
-    {
-      // TODO: Initialize iterator. "hashTable" is the table to be iterated.
-       _hashTable =  hashTable;
-    }
-
-    template <typename Data>
-    bool HashTableIterator<Data>::next(const char * & key, Data & data)
-    {
-      // TODO: Returns the next element in the hash table.
-      // The key and data values are stored in the references passed
-      // as argument. It returns true if there are more entries or
-      // false otherwise.
-      return false;
-    }
-
-    */
-
 } // end namespace
 
 #endif
-
@@ -0,0 +1,309 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cfloat>
+
+#include <pal/labellingsession.h>
+#include <pal/layer.h>
+#include <pal/label.h>
+
+#include "candidatecache.h"
+#include "feature.h"
+#include "labelposition.h"
+#include "problem.h"
+#include "util.h"
+
+namespace pal {
+
+    typedef struct _sessionfeat {
+        /**
+         * label retained by the last labelling
+         */
+        bool known;     // feature was in the last problem
+        bool labelled;
+        double lx;
+        double ly;
+        double alpha;
+
+        bool seen;      // feature is in the current problem
+    } SessionFeat;
+
+    typedef struct _sessionlabel {
+        double x[4];
+        double y[4];
+
+        struct _sessionlabel *next; // other parts of the feature
+    } SessionLabel;
+
+
+    LabellingSession::LabellingSession (Pal *pal) : pal (pal) {
+        feats = new std::map<Feature*, SessionFeat*>();
+        labels = new std::map<std::pair<std::string, std::string>, SessionLabel*>();
+        scale = -1;
+        layersGeneration = -1;
+        cacheHits = 0;
+        nbReused = 0;
+        nbWarm = 0;
+    }
+
+    LabellingSession::~LabellingSession() {
+        clear();
+        clearLabels();
+        delete feats;
+        delete labels;
+    }
+
+    void LabellingSession::clear() {
+        for (std::map<Feature*, SessionFeat*>::iterator it = feats->begin();it != feats->end();it++)
+            delete it->second;
+        feats->clear();
+    }
+
+    void LabellingSession::clearLabels() {
+        SessionLabel *sl;
+        SessionLabel *next;
+
+        for (std::map<std::pair<std::string, std::string>, SessionLabel*>::iterator it = labels->begin();it != labels->end();it++) {
+            for (sl = it->second;sl;sl = next) {
+                next = sl->next;
+                delete sl;
+            }
+        }
+        labels->clear();
+    }
+
+    void LabellingSession::reset() {
+        clear();
+        clearLabels();
+        scale = -1;
+    }
+
+    void LabellingSession::setPreviousLabels (std::list<Label*> *previousLabels) {
+        int k;
+        SessionLabel *sl;
+
+        clearLabels();
+
+        for (std::list<Label*>::iterator it = previousLabels->begin();it != previousLabels->end();it++) {
+            sl = new SessionLabel();
+            for (k = 0;k < 4;k++) {
+                sl->x[k] = (*it)->getX (k);
+                sl->y[k] = (*it)->getY (k);
+            }
+
+            SessionLabel *&parts = (*labels) [std::make_pair (std::string ( (*it)->getLayerName()), std::string ( (*it)->getFeatureId()))];
+            sl->next = parts;
+            parts = sl;
+        }
+    }
+
+    int LabellingSession::getNbReusedFeatures() {
+        return nbReused;
+    }
+
+    int LabellingSession::getNbWarmFeatures() {
+        return nbWarm;
+    }
+
+    std::list<Label*> *LabellingSession::labeller (double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget) {
+        return pal->labeller (scale, bbox, stats, displayAll, this, timeBudget);
+    }
+
+    std::list<Label*> *LabellingSession::labeller (int nbLayers, char **layersName, double *layersFactor,
+            double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget) {
+        return pal->labeller (nbLayers, layersName, layersFactor, scale, bbox, stats, displayAll, this, timeBudget);
+    }
+
+
+    void LabellingSession::begin (double scale) {
+        // zoom or removed layers : start from scratch
+        if (scale != this->scale || pal->layersGeneration != layersGeneration) {
+            clear();
+            this->scale = scale;
+            layersGeneration = pal->layersGeneration;
+        }
+
+        for (std::map<Feature*, SessionFeat*>::iterator it = feats->begin();it != feats->end();it++)
+            it->second->seen = false;
+
+        cacheHits = pal->candidateCache->getNbHits();
+        nbReused = 0;
+        nbWarm = 0;
+    }
+
+
+    void LabellingSession::see (Feature *feat) {
+        SessionFeat *sf;
+
+        std::map<Feature*, SessionFeat*>::iterator it = feats->find (feat);
+
+        if (it == feats->end()) {
+            sf = new SessionFeat();
+            sf->known = false;
+            sf->labelled = false;
+            (*feats) [feat] = sf;
+        } else {
+            sf = it->second;
+        }
+        sf->seen = true;
+    }
+
+
+    void LabellingSession::warmStart (Problem *prob) {
+        int i, j;
+        Feature *feat;
+        LabelPosition *lp;
+        SessionFeat *sf;
+        std::map<std::pair<std::string, std::string>, SessionLabel*>::iterator it;
+
+        prob->warmSol = new int[prob->nbft];
+
+        for (i = 0;i < prob->nbft;i++) {
+            prob->warmSol[i] = -2;
+
+            if (prob->featNbLp[i] == 0)
+                continue;
+
+            feat = prob->labelpositions[prob->featStartId[i]]->feature;
+
+            // given labels first
+            if (!labels->empty()) {
+                std::string layerName (feat->layer->getName());
+                it = labels->find (std::make_pair (layerName, std::string (feat->uid)));
+                if (it != labels->end()) {
+                    j = nearestCandidate (prob, i, it->second);
+                    if (j >= 0) {
+                        prob->warmSol[i] = j;
+                        nbWarm++;
+                    }
+                    continue;
+                }
+
+                // hidden by the given labelling of its layer
+                it = labels->lower_bound (std::make_pair (layerName, std::string()));
+                if (it != labels->end() && it->first.first == layerName) {
+                    prob->warmSol[i] = -1;
+                    continue;
+                }
+            }
+
+            sf = (*feats) [feat];
+            if (!sf->known)
+                continue;
+
+            prob->warmSol[i] = -1;
+            if (!sf->labelled)
+                continue;
+
+            for (j = prob->featStartId[i];j < prob->featStartId[i] + prob->featNbLp[i];j++) {
+                lp = prob->labelpositions[j];
+                if (vabs (lp->x[0] - sf->lx) < EPSILON && vabs (lp->y[0] - sf->ly) < EPSILON
+                        && vabs (lp->alpha - sf->alpha) < EPSILON) {
+                    prob->warmSol[i] = j;
+                    nbWarm++;
+                    break;
+                }
+            }
+        }
+    }
+
+
+    int LabellingSession::nearestCandidate (Problem *prob, int i, SessionLabel *sl) {
+        int j, k;
+        int best = -1;
+        double dx, dy;
+        double dist;
+        double maxDist;
+        double bestDist = DBL_MAX;
+        LabelPosition *lp;
+
+        // the farthest corner gives the move of the label
+        for (;sl;sl = sl->next) {
+            for (j = prob->featStartId[i];j < prob->featStartId[i] + prob->featNbLp[i];j++) {
+                lp = prob->labelpositions[j];
+                maxDist = 0.0;
+                for (k = 0;k < 4;k++) {
+                    dx = lp->x[k] - sl->x[k];
+                    dy = lp->y[k] - sl->y[k];
+                    dist = dx * dx + dy * dy;
+                    if (dist > maxDist)
+                        maxDist = dist;
+                }
+                if (maxDist < bestDist) {
+                    bestDist = maxDist;
+                    best = j;
+                }
+            }
+        }
+
+        if (best >= 0 && bestDist > prob->labelpositions[best]->w * prob->labelpositions[best]->w / 4)
+            return -1;
+        return best;
+    }
+
+
+    void LabellingSession::end (Problem *prob) {
+        int i;
+        LabelPosition *lp;
+        SessionFeat *sf;
+
+        nbReused = pal->candidateCache->getNbHits() - cacheHits;
+
+        // given labels are used once
+        clearLabels();
+
+        std::map<Feature*, SessionFeat*>::iterator it = feats->begin();
+        while (it != feats->end()) {
+            if (it->second->seen) {
+                it->second->known = true;
+                it->second->labelled = false;
+                it++;
+            } else {
+                // feature left the map extent
+                delete it->second;
+                feats->erase (it++);
+            }
+        }
+
+        if (!prob)
+            return;
+
+        for (i = 0;i < prob->nbft;i++) {
+            if (prob->sol->s[i] >= 0) {
+                lp = prob->labelpositions[prob->sol->s[i]];
+                sf = (*feats) [lp->feature];
+                sf->labelled = true;
+                sf->lx = lp->x[0];
+                sf->ly = lp->y[0];
+                sf->alpha = lp->alpha;
+            }
+        }
+    }
+
+} // end namespace pal
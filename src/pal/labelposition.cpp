@@ -66,11 +66,20 @@ namespace pal {
 
         double tx, ty;
 
-        dx1 = cos (this->alpha) * w;
-        dy1 = sin (this->alpha) * w;
-
-        dx2 = cos (beta) * h;
-        dy2 = sin (beta) * h;
+        // cos (M_PI/2) is not exactly 0 : build unrotated candidates
+        // from exact offsets so their corners lie on their bounding box
+        if (this->alpha == 0) {
+            dx1 = w;
+            dy1 = 0;
+            dx2 = 0;
+            dy2 = h;
+        } else {
+            dx1 = cos (this->alpha) * w;
+            dy1 = sin (this->alpha) * w;
+
+            dx2 = cos (beta) * h;
+            dy2 = sin (beta) * h;
+        }
 
         x[0] = x1;
         y[0] = y1;
@@ -84,6 +93,9 @@ namespace pal {
         x[3] = x1 + dx2;
         y[3] = y1 + dy2;
 
+        // degenerated rectangles keep the general tests
+        axisAligned = (this->alpha == 0 && x[1] > x[0] && y[3] > y[0]);
+
         // upside down ?
         if (this->alpha > M_PI / 2 && this->alpha <= 3*M_PI / 2) {
             tx = x[0];
@@ -193,6 +205,10 @@ namespace pal {
         return cost;
     }
 
+    bool LabelPosition::isAxisAligned() {
+        return axisAligned;
+    }
+
     Feature * LabelPosition::getFeature() {
         return feature;
     }
@@ -259,7 +275,7 @@ namespace pal {
             ( (Feature*) feat)->fetchCoordinates();
         }
 
-        pCost->update(feat);
+        pCost->updateSimplified(feat);
 
 
         if (feat->holeOf == NULL) {
@@ -270,27 +286,24 @@ namespace pal {
         return true;
     }
 
-    void LabelPosition::setCostFromPolygon (RTree <PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]){
+    void LabelPosition::setCostFromPolygon (RTree <PointSet*, double, 2, double> *obstacles, PointSet *extent, double simplifyTolerance){
 
         double amin[2];
         double amax[2];
 
 
-        LabelPosition::PolygonCostCalculator *pCost = new LabelPosition::PolygonCostCalculator(this);
+        LabelPosition::PolygonCostCalculator calculator (this, simplifyTolerance);
+        LabelPosition::PolygonCostCalculator *pCost = &calculator;
         //cost = getCostFromPolygon (feat, dist_sq);
 
         // center
         //cost = feat->getDistInside((this->x[0] + this->x[2])/2.0, (this->y[0] + this->y[2])/2.0 );
 
         feature->fetchCoordinates();
-        pCost->update(feature);
-
-        PointSet *extent = new PointSet(4, bbx, bby);
+        pCost->updateSimplified(feature);
 
         pCost->update(extent);
 
-        delete extent;
-
         // TODO Comment
         /*if (cost > (w*w + h*h) / 4.0) {
             double dist = sqrt (cost);
@@ -306,17 +319,15 @@ namespace pal {
         //}
 
         //std::cout << amin[0] << " " << amin[1] << " " << amax[0] << " " <<  amax[1] << std::endl;
-        obstacles->Search (amin, amax, obstacleCallback, pCost);
+        StaticCallback<PointSet*, obstacleCallback> visitor (pCost);
+        obstacles->Visit (amin, amax, visitor);
 
         cost = pCost->getCost();
 
         feature->releaseCoordinates();
-        delete pCost;
     }
 
-    void LabelPosition::removeFromIndex (RTree<LabelPosition*, double, 2, double> *index) {
-        double amin[2];
-        double amax[2];
+    void LabelPosition::getBoundingBox (double amin[2], double amax[2]) {
         int c;
 
         amin[0] = DBL_MAX;
@@ -333,6 +344,14 @@ namespace pal {
             if (y[c] > amax[1])
                 amax[1] = y[c];
         }
+    }
+
+
+    void LabelPosition::removeFromIndex (RTree<LabelPosition*, double, 2, double> *index) {
+        double amin[2];
+        double amax[2];
+
+        getBoundingBox (amin, amax);
 
         index->Remove (amin, amax, this);
     }
@@ -341,28 +360,14 @@ namespace pal {
     void LabelPosition::insertIntoIndex (RTree<LabelPosition*, double, 2, double> *index) {
         double amin[2];
         double amax[2];
-        int c;
 
-        amin[0] = DBL_MAX;
-        amax[0] = -DBL_MAX;
-        amin[1] = DBL_MAX;
-        amax[1] = -DBL_MAX;
-        for (c = 0;c < 4;c++) {
-            if (x[c] < amin[0])
-                amin[0] = x[c];
-            if (x[c] > amax[0])
-                amax[0] = x[c];
-            if (y[c] < amin[1])
-                amin[1] = y[c];
-            if (y[c] > amax[1])
-                amax[1] = y[c];
-        }
+        getBoundingBox (amin, amax);
 
         index->Insert (amin, amax, this);
     }
 
 
-    void LabelPosition::setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]) {
+    void LabelPosition::setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4], double simplifyTolerance) {
         //std::cout << "setCost:" << std::endl;
         //clock_t clock_start = clock();
 
@@ -374,8 +379,12 @@ namespace pal {
         std::cout << "LabelPosition for feat: " << lPos[0]->feature->uid << std::endl;
 #endif
 
+        PointSet *extent = new PointSet (4, bbx, bby);
+
         for (i = 0;i < nblp;i++)
-            lPos[i]->setCostFromPolygon (obstacles, bbx, bby);
+            lPos[i]->setCostFromPolygon (obstacles, extent, simplifyTolerance);
+
+        delete extent;
 
         // lPos with big values came fisrts (value = min distance from label to Polygon's Perimeter)
         //sort ( (void**) lPos, nblp, costGrow);
@@ -418,7 +427,7 @@ namespace pal {
         //std::cout << "AfterSetCostFromPolygon (" << nblp << "x): " << clock_2 = (clock() - clock_1) << std::endl;
     }
 
-    LabelPosition::PolygonCostCalculator::PolygonCostCalculator (LabelPosition *lp) : lp(lp) {
+    LabelPosition::PolygonCostCalculator::PolygonCostCalculator (LabelPosition *lp, double simplifyTolerance) : lp(lp), simplifyTolerance(simplifyTolerance) {
         int i;
         double hyp = max(lp->feature->getXmax() - lp->feature->getXmin(), lp->feature->getYmax() - lp->feature->getYmin());
         hyp *= 10;
@@ -460,6 +469,10 @@ namespace pal {
         }
     }
 
+    void LabelPosition::PolygonCostCalculator::updateSimplified (PointSet *pset) {
+        update (Feature::getSimplified (pset, simplifyTolerance));
+    }
+
     void LabelPosition::PolygonCostCalculator::updatePoint (PointSet *pset) {
         double beta = atan2(pset->getY()[0] - py, pset->getX()[0] - px) - lp->getAlpha();
 
@@ -40,7 +40,6 @@ namespace pal {
     class Feature;
     class Pal;
     class Label;
-    class PriorityQueue;
 
 
     /**
@@ -58,13 +57,10 @@ namespace pal {
         friend bool pruneLabelPositionCallback (LabelPosition *lp, void *ctx);
         //friend void setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]);
         friend bool countOverlapCallback (LabelPosition *lp, void *ctx);
-        friend bool countFullOverlapCallback (LabelPosition *lp, void *ctx);
-        friend bool removeOverlapCallback (LabelPosition *lp, void *ctx);
-        friend bool falpCallback1 (LabelPosition *lp, void * ctx);
-        friend bool falpCallback2 (LabelPosition *lp, void * ctx);
-        friend bool subPartCallback (LabelPosition *lp, void *ctx);
+        friend void popmusicJob (int job, int thread, void *ctx);
+        friend void chainComponentJob (int job, int thread, void *ctx);
+        friend void exactComponentJob (int job, int thread, void *ctx);
         friend bool chainCallback (LabelPosition *lp, void *context);
-        friend void ignoreLabel (LabelPosition*, PriorityQueue*, RTree<LabelPosition*, double, 2, double, 8, 4>*);
         friend bool obstacleCallback (PointSet *feat, void *ctx);
 
         friend bool updateCandidatesCost (LabelPosition *lp, void *context);
@@ -72,7 +68,9 @@ namespace pal {
 
         friend class Pal;
         friend class Problem;
+        friend class CandidateGeom;
         friend class Feature;
+        friend class LabellingSession;
         friend double dist_pointToLabel (double, double, LabelPosition*);
     private:
         //LabelPosition **overlaped;
@@ -94,6 +92,11 @@ namespace pal {
         double w;
         double h;
 
+        /**
+         * unrotated candidate : corners are exactly on the bounding box
+         */
+        bool axisAligned;
+
         //LabelPosition (int id, double x1, double y1, double w, double h, double cost, Feature *feature);
         //LabelPosition (int id, int nbPart, double *x, double *y, double *alpha,
 
@@ -126,10 +129,13 @@ namespace pal {
 
         /**
          * \brief Set cost to the smallest distance between lPos's centroid and a polygon stored in geoetry field
+         * \param obstacles obstacles index
+         * \param extent the map extent
+         * \param simplifyTolerance geometries are simplified with this tolerance [map unit]
          */
-        void setCostFromPolygon (RTree <PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]);
+        void setCostFromPolygon (RTree <PointSet*, double, 2, double> *obstacles, PointSet *extent, double simplifyTolerance);
 
-        static void setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4]);
+        static void setCost (int nblp, LabelPosition **lPos, int max_p, RTree<PointSet*, double, 2, double> *obstacles, double bbx[4], double bby[4], double simplifyTolerance);
 
 
 
@@ -195,9 +201,22 @@ namespace pal {
 
         void print();
 
+        /**
+         * \brief get the candidate's bounding box
+         * @param amin xmin, ymin
+         * @param amax xmax, ymax
+         */
+        void getBoundingBox (double amin[2], double amax[2]);
+
         void removeFromIndex (RTree<LabelPosition*, double, 2, double> *index);
         void insertIntoIndex (RTree<LabelPosition*, double, 2, double> *index);
 
+        /**
+         * \brief is the candidate an unrotated rectangle ?
+         * Such candidates are tested with the AxisAlignedRect specializations
+         */
+        bool isAxisAligned ();
+
         /**
          * \brief Data structure to compute polygon's candidates costs
          *
@@ -210,6 +229,7 @@ namespace pal {
             friend class PointSet;
 
             LabelPosition *lp;
+            double simplifyTolerance;
             double px, py;
             double dist[8];
             double rpx[8];
@@ -221,10 +241,15 @@ namespace pal {
             void updatePoint(PointSet *pset);
             double updateLinePoly(PointSet *pset);
         public:
-            PolygonCostCalculator (LabelPosition *lp);
+            PolygonCostCalculator (LabelPosition *lp, double simplifyTolerance);
 
             void update (PointSet *pset);
 
+            /**
+             * \brief simplify pset then update
+             */
+            void updateSimplified (PointSet *pset);
+
             double getCost();
 
             LabelPosition *getLabel();
@@ -35,6 +35,10 @@
 #include <iostream>
 #include <cstring>
 #include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 
 #include <pal/pal.h>
@@ -44,11 +48,13 @@
 #include "linkedlist.hpp"
 #include "hashtable.hpp"
 
+#include "candidatecache.h"
 #include "feature.h"
 #include "geomfunction.h"
 #include "util.h"
 
 #include "simplemutex.h"
+#include "snapshot.h"
 
 namespace pal {
 
@@ -58,6 +64,7 @@ namespace pal {
         strcpy (this->name, lyrName);
 
         modMutex = new SimpleMutex();
+        snapshot = NULL;
 
         //rtreeFile = new char[strlen(lyrName)+7];
         //sprintf (rtreeFile, "%s.rtree", lyrName);
@@ -92,6 +99,9 @@ namespace pal {
 
         delete hashtable;
         delete modMutex;
+
+        // after features, they use it
+        delete snapshot;
     }
 
     /*
@@ -135,7 +145,17 @@ namespace pal {
     }
 
     void Layer::setArrangement (Arrangement arrangement) {
-        this->arrangement = arrangement;
+        if (arrangement != this->arrangement) {
+            this->arrangement = arrangement;
+            invalidateCandidates();
+        }
+    }
+
+    void Layer::invalidateCandidates () {
+        modMutex->lock();
+        for (Cell<Feature*> *it = features->getFirst();it;it = it->next)
+            pal->candidateCache->invalidate (it->item);
+        modMutex->unlock();
     }
 
 
@@ -286,9 +306,15 @@ void Layer::registerFeature (const char *geom_id, PalGeometry *userGeom, double
         }
 
         /* Split MULTI GEOM and Collection in simple geometries*/
-        GEOSGeometry *the_geom = userGeom->getGeosGeometry();
-
-        LinkedList<Feat*> *finalQueue = splitGeom (the_geom, geom_id);
+        GEOSGeometry *the_geom = NULL;
+        LinkedList<Feat*> *finalQueue;
+
+        if (userGeom->getNbParts() >= 0) {
+            finalQueue = splitUserGeom (userGeom, geom_id);
+        } else {
+            the_geom = userGeom->getGeosGeometry();
+            finalQueue = splitGeom (the_geom, geom_id);
+        }
 
         int nGeom = finalQueue->size();
         int part = 0;
@@ -311,15 +337,18 @@ void Layer::registerFeature (const char *geom_id, PalGeometry *userGeom, double
                 //case geos::geom::GEOS_POLYGON:
 
                // ignore invalid geometries
-               if ( (f->type == GEOS_LINESTRING && f->nbPoints < 2) ||
-                    (f->type == GEOS_POLYGON && f->nbPoints < 3) )
+               if (!isLabellableFeat (f)) {
+                   // skipped, but parts keep their rank in the geometry
+                   deleteFeat (f);
+                   part++;
                    continue;
+               }
 
 #ifdef _DEBUG_FULL_
                 std::cout << "Create Feat" << std::endl;
 #endif
                 ft = new Feature (f, this, part, nGeom, userGeom);
-                ft->deleteCoord();
+                ft->cacheCoord (f->borrowed);
 #ifdef _DEBUG_FULL_
                 std::cout << "Feature created" << std::endl;
 #endif
@@ -367,7 +396,8 @@ void Layer::registerFeature (const char *geom_id, PalGeometry *userGeom, double
         }
         delete finalQueue;
 
-        userGeom->releaseGeosGeometry (the_geom);
+        if (the_geom)
+            userGeom->releaseGeosGeometry (the_geom);
     }
     modMutex->unlock();
 }
@@ -402,6 +432,7 @@ void Layer::setFeatureDistlabel (const char * geom_id, int distlabel) {
         for (i = 0;i < nb;i++) {
             feat = it->item;
             feat->distlabel = distlabel;
+            pal->candidateCache->invalidate (feat);
             it = it->next;
         }
     } else {
@@ -449,6 +480,7 @@ void Layer::setFeatureLabelSize (const char * geom_id, double label_x, double la
             feat = it->item;
             feat->label_x = label_x;
             feat->label_y = label_y;
+            pal->candidateCache->invalidate (feat);
             it = it->next;
         }
     } else {
@@ -493,8 +525,10 @@ double Layer::getFeatureLabelWidth (const char *geom_id) {
 }
 
     void Layer::setLabelUnit (Units label_unit) {
-        if (label_unit == PIXEL || label_unit == METER)
+        if ( (label_unit == PIXEL || label_unit == METER) && label_unit != this->label_unit) {
             this->label_unit = label_unit;
+            invalidateCandidates();
+        }
     }
 
     Units Layer::getLabelUnit () {
@@ -502,6 +536,247 @@ double Layer::getFeatureLabelWidth (const char *geom_id) {
     }
 
 
+    /*
+     * Features are saved in the spatial index by their rank in the layer
+     */
+    typedef std::pair<Feature*, int> FeatureRank;
+
+    class SnapshotWriter {
+    private:
+        std::vector<FeatureRank> *ranks; // sorted
+
+    public:
+        SnapshotWriter (std::vector<FeatureRank> *ranks) : ranks (ranks) {}
+
+        bool operator() (RTFileStream &stream, Feature * const &ft) {
+            std::vector<FeatureRank>::iterator it = std::lower_bound (ranks->begin(), ranks->end(), FeatureRank (ft, -1));
+            return stream.Write (it->second) == 1;
+        }
+    };
+
+    class SnapshotReader {
+    private:
+        Feature **feats;
+        int nbFeatures;
+
+    public:
+        SnapshotReader (Feature **feats, int nbFeatures) : feats (feats), nbFeatures (nbFeatures) {}
+
+        bool operator() (RTMemStream &stream, Feature *&ft) {
+            int rank;
+            if (!stream.Read (rank) || rank < 0 || rank >= nbFeatures)
+                return false;
+            ft = feats[rank];
+            return true;
+        }
+    };
+
+
+    void Layer::saveSnapshot (const char *fileName, bool withCoordinates) {
+        int i, j, nbFeatures, nbHoles;
+        int64_t nbIds, nbCoords;
+        Cell<Feature*> *it;
+        Feature *ft;
+        Feature *previous = NULL;
+
+        modMutex->lock();
+
+        nbFeatures = features->size();
+
+        SnapshotFeature *sfs = new SnapshotFeature[nbFeatures];
+        std::vector<SnapshotHole> holes;
+        std::vector<FeatureRank> ranks (nbFeatures);
+
+        // layer name first, then ids (shared by parts of a geometry)
+        nbIds = strlen (name) + 1;
+        nbCoords = 0;
+        nbHoles = 0;
+
+        for (i = 0, it = features->getFirst();it;i++, it = it->next) {
+            ft = it->item;
+            SnapshotFeature *sf = sfs + i;
+
+            memset (sf, 0, sizeof (SnapshotFeature));
+            sf->xmin = ft->xmin;
+            sf->ymin = ft->ymin;
+            sf->xmax = ft->xmax;
+            sf->ymax = ft->ymax;
+            sf->label_x = ft->label_x;
+            sf->label_y = ft->label_y;
+            sf->type = ft->type;
+            sf->part = ft->part;
+            sf->nPart = ft->nPart;
+            sf->distlabel = ft->distlabel;
+            sf->nbPoints = ft->nbPoints;
+            sf->nbHoles = ft->nbSelfObs;
+            sf->firstHole = nbHoles;
+
+            if (i > 0 && strcmp (ft->uid, previous->uid) == 0) {
+                sf->uid = sfs[i-1].uid;
+            } else {
+                sf->uid = nbIds;
+                nbIds += strlen (ft->uid) + 1;
+            }
+
+            sf->coord = -1;
+            if (withCoordinates) {
+                sf->coord = nbCoords;
+                nbCoords += 2 * (int64_t) ft->nbPoints;
+            }
+
+            for (j = 0;j < ft->nbSelfObs;j++) {
+                SnapshotHole sh;
+                memset (&sh, 0, sizeof (SnapshotHole));
+                sh.xmin = ft->selfObs[j]->xmin;
+                sh.ymin = ft->selfObs[j]->ymin;
+                sh.xmax = ft->selfObs[j]->xmax;
+                sh.ymax = ft->selfObs[j]->ymax;
+                sh.nbPoints = ft->selfObs[j]->nbPoints;
+                sh.coord = -1;
+                if (withCoordinates) {
+                    sh.coord = nbCoords;
+                    nbCoords += 2 * (int64_t) sh.nbPoints;
+                }
+                holes.push_back (sh);
+            }
+            nbHoles += ft->nbSelfObs;
+
+            ranks[i] = FeatureRank (ft, i);
+            previous = ft;
+        }
+
+        std::sort (ranks.begin(), ranks.end());
+
+        SnapshotHeader header;
+        memset (&header, 0, sizeof (SnapshotHeader));
+        memcpy (header.magic, SNAPSHOT_MAGIC, sizeof (header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = 0x01020304;
+        header.featureSize = sizeof (SnapshotFeature);
+        header.holeSize = sizeof (SnapshotHole);
+        header.nbFeatures = nbFeatures;
+        header.nbHoles = nbHoles;
+        header.withCoordinates = withCoordinates;
+        header.arrangement = arrangement;
+        header.labelUnit = label_unit;
+        header.obstacle = obstacle;
+        header.active = active;
+        header.toLabel = toLabel;
+        header.minScale = min_scale;
+        header.maxScale = max_scale;
+        header.priority = defaultPriority;
+        header.name = 0;
+
+        int64_t padding = (8 - nbIds % 8) % 8;
+        header.features = sizeof (SnapshotHeader);
+        header.holes = header.features + (int64_t) nbFeatures * sizeof (SnapshotFeature);
+        header.ids = header.holes + (int64_t) nbHoles * sizeof (SnapshotHole);
+        header.coordinates = header.ids + nbIds + padding;
+        header.rtree = header.coordinates + nbCoords * sizeof (double);
+
+        RTFileStream stream;
+        bool ok = stream.OpenWrite (fileName);
+
+        if (ok) {
+            ok = stream.Write (header) && stream.WriteArray (sfs, nbFeatures);
+            if (ok && nbHoles > 0)
+                ok = stream.WriteArray (&holes[0], nbHoles);
+
+            ok = ok && stream.WriteArray (name, strlen (name) + 1);
+            for (i = 0, it = features->getFirst();ok && it;i++, it = it->next) {
+                if (i == 0 || sfs[i].uid != sfs[i-1].uid)
+                    ok = stream.WriteArray (it->item->uid, strlen (it->item->uid) + 1);
+            }
+            for (i = 0;ok && i < padding;i++)
+                ok = stream.Write ('\0');
+
+            for (it = features->getFirst();ok && withCoordinates && it;it = it->next) {
+                ft = it->item;
+                ft->fetchCoordinates();
+                ok = stream.WriteArray (ft->x, ft->nbPoints) && stream.WriteArray (ft->y, ft->nbPoints);
+                for (j = 0;ok && j < ft->nbSelfObs;j++) {
+                    PointSet *hole = ft->selfObs[j];
+                    ok = stream.WriteArray (hole->x, hole->nbPoints) && stream.WriteArray (hole->y, hole->nbPoints);
+                }
+                ft->releaseCoordinates();
+            }
+
+            SnapshotWriter writer (&ranks);
+            ok = ok && rtree->Save (stream, writer);
+
+            stream.Close();
+        }
+
+        delete[] sfs;
+        modMutex->unlock();
+
+        if (!ok) {
+            remove (fileName);
+            throw new PalException::InvalidSnapshot();
+        }
+    }
+
+
+    void Layer::loadSnapshot (MappedFile *file, PalGeometry * (*getGeometry) (const char *geom_id, void *ctx), void *ctx) {
+        int i;
+        const char *data = file->getData();
+        const SnapshotHeader *header = (const SnapshotHeader*) data;
+        const SnapshotFeature *sfs = (const SnapshotFeature*) (data + header->features);
+        const SnapshotHole *holes = (const SnapshotHole*) (data + header->holes);
+        const char *ids = data + header->ids;
+        const double *coords = (const double*) (data + header->coordinates);
+
+        PalGeometry *userGeom = NULL;
+        Feature *ft;
+
+        modMutex->lock();
+
+        // features use the mapping until the layer is deleted
+        snapshot = file;
+
+        Feature **feats = new Feature*[header->nbFeatures];
+
+        for (i = 0;i < header->nbFeatures;i++) {
+            const SnapshotFeature *sf = sfs + i;
+            bool first_feat = (i == 0 || sf->uid != sfs[i-1].uid);
+
+            if (!checkSnapshotFeature (header, sf)
+                    || (first_feat && hashtable->find (ids + sf->uid))) {
+                delete[] feats;
+                modMutex->unlock();
+                throw new PalException::InvalidSnapshot();
+            }
+
+            if (first_feat) {
+                userGeom = (getGeometry ? getGeometry (ids + sf->uid, ctx) : NULL);
+                if (!userGeom && !header->withCoordinates) {
+                    delete[] feats;
+                    modMutex->unlock();
+                    throw new PalException::UnknownFeature();
+                }
+            }
+
+            ft = new Feature (sf, holes, ids, coords, this, userGeom);
+            features->push_back (ft);
+
+            if (first_feat)
+                hashtable->insertItem (ft->uid, features->last);
+
+            feats[i] = ft;
+        }
+
+        RTMemStream stream (data + header->rtree, file->getSize() - header->rtree);
+        SnapshotReader reader (feats, header->nbFeatures);
+        bool ok = rtree->Load (stream, reader);
+
+        delete[] feats;
+        modMutex->unlock();
+
+        if (!ok)
+            throw new PalException::InvalidSnapshot();
+    }
+
+
 
 /*
 void Layer::setFeatureGeom (const char * geom_id, const char *the_geomHex){
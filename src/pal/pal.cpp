@@ -42,16 +42,23 @@
 #include <pal/pal.h>
 #include <pal/layer.h>
 #include <pal/palexception.h>
+#include <pal/labellingsession.h>
 
 #include "linkedlist.hpp"
 #include "rtree.hpp"
 
+#include "arena.h"
+#include "candidatecache.h"
+#include "candidategeom.h"
+#include "coordcache.h"
 #include "feature.h"
 #include "geomfunction.h"
 #include "labelposition.h"
 #include "problem.h"
 #include "pointset.h"
 #include "simplemutex.h"
+#include "snapshot.h"
+#include "threadpool.h"
 #include "util.h"
 
 namespace pal {
@@ -61,6 +68,7 @@ namespace pal {
         double scale;
         Pal* pal;
         PointSet *obstacle;
+        PointSet *shape;  // simplified obstacle
     } PruneCtx;
 
     void geosError (const char *fmt, ...) {
@@ -96,16 +104,26 @@ namespace pal {
         setSearch (CHAIN);
 
         dpi = 72;
+        simplifyTolerance = 0.5;
         point_p = 8;
         line_p = 8;
         poly_p = 8;
 
+        nbThreads = 1;
+        nbStarts = 1;
+        exactSearchSize = 20;
+        deterministic = false;
+        seed = 0;
+
+        coordCache = new CoordCache (64 * 1024 * 1024);
+        candidateCache = new CandidateCache (64 * 1024 * 1024);
+
+        layersGeneration = 0;
+
         this->map_unit = pal::METER;
 
         std::cout.precision (12);
         std::cerr.precision (12);
-
-        tmpTime = 0;
     }
 
     std::list<Layer*> *Pal::getLayers () {
@@ -132,6 +150,7 @@ namespace pal {
         if (layer) {
             layers->remove (layer);
             delete layer;
+            layersGeneration++;
         }
         lyrsMutex->unlock();
     }
@@ -139,8 +158,6 @@ namespace pal {
 
     Pal::~Pal() {
 
-        std::cout << "Acces/Concvert time: " << (double) tmpTime / CLOCKS_PER_SEC << std::endl;
-
         lyrsMutex->lock();
         while (layers->size() > 0) {
             delete layers->front();
@@ -150,6 +167,10 @@ namespace pal {
         delete layers;
         delete lyrsMutex;
 
+        // after layers: features forget their coordinates and candidates when deleted
+        delete coordCache;
+        delete candidateCache;
+
         finishGEOS();
     }
 
@@ -182,52 +203,91 @@ namespace pal {
     }
 
 
+    Layer * Pal::loadLayer (const char *fileName, PalGeometry * (*getGeometry) (const char *geom_id, void *ctx), void *ctx) {
+        Layer *lyr;
+        MappedFile *file = new MappedFile();
+
+        if (!file->open (fileName) || !checkSnapshotHeader (file->getData(), file->getSize())) {
+            delete file;
+            throw new PalException::InvalidSnapshot();
+        }
+
+        const SnapshotHeader *header = (const SnapshotHeader*) file->getData();
+        const char *lyrName = file->getData() + header->ids + header->name;
+
+        lyrsMutex->lock();
+
+        for (std::list<Layer*>::iterator it = layers->begin(); it != layers->end();it++) {
+            if (strcmp ( (*it)->name, lyrName) == 0) { // if layer already known
+                lyrsMutex->unlock();
+                delete file;
+                throw new PalException::LayerExists();
+            }
+        }
+
+        lyr = new Layer (lyrName, header->minScale, header->maxScale, (Arrangement) header->arrangement,
+                         (Units) header->labelUnit, header->priority, header->obstacle != 0, header->active != 0,
+                         header->toLabel != 0, this);
+
+        try {
+            lyr->loadSnapshot (file, getGeometry, ctx);
+        } catch (...) {
+            lyrsMutex->unlock();
+            delete lyr;
+            throw;
+        }
+
+        layers->push_back (lyr);
+
+        lyrsMutex->unlock();
+
+        return lyr;
+    }
+
+
     typedef struct _featCbackCtx {
         Layer *layer;
         double scale;
-        LinkedList<Feats*> *fFeats;
-        RTree<PointSet*, double, 2, double> *obstacles;
-        RTree<LabelPosition*, double, 2, double> *candidates;
+        LinkedList<Feature*> *toProcess;
+        LinkedList<PointSet*> *obstacles; // indexed once all layers are extracted
         double priority;
         double bbox_min[2];
         double bbox_max[2];
         Units unit;
+        double simplifyTolerance; // [map unit]
 #ifdef _EXPORT_MAP_
         std::ofstream *svgmap;
 #endif
     } FeatCallBackCtx;
 
 
+    typedef struct _candidatesJobCtx {
+        FeatCallBackCtx *context;
+        Feature **features;         // [nbJobs] features to process
+        LinkedList<Feats*> **feats; // [nbJobs] parts of features[i] with candidates
+        Arena **arenas;             // [nbThreads] candidates of each thread
+    } CandidatesJobCtx;
+
+
 
     /*
      * Callback function
      *
      * Extract a specific shape from indexes
+     * Obstacles are queued into context->obstacles, features to label are queued
+     * into context->toProcess (candidates are generated by generateCandidatesJob)
      */
     bool extractFeatCallback (Feature *ft_ptr, void *ctx) {
 
-        double min[2];
-        double max[2];
-
         FeatCallBackCtx *context = (FeatCallBackCtx*) ctx;
 
-#ifdef _EXPORT_MAP_
-        bool svged = false; // is the feature has been written into the svg map ?
-        int dpi = context->layer->pal->getDpi();
-#endif
-
-
 #ifdef _DEBUG_FULL_
         std::cout << "extract feat : " << ft_ptr->layer->name << "/" << ft_ptr->uid << std::endl;
 #endif
 
         // all feature which are obstacle will be inserted into obstacles
         if (context->layer->obstacle) {
-            min[0] = ft_ptr->xmin;
-            min[1] = ft_ptr->ymin;
-            max[0] = ft_ptr->xmax;
-            max[1] = ft_ptr->ymax;
-            context->obstacles->Insert (min, max, ft_ptr);
+            context->obstacles->push_back (ft_ptr);
 
             ft_ptr->fetchCoordinates ();
         }
@@ -241,121 +301,141 @@ namespace pal {
                 int i;
                 // Hole of the feature are obstacles
                 for (i = 0;i < ft_ptr->nbSelfObs;i++) {
-                    min[0] = ft_ptr->selfObs[i]->xmin;
-                    min[1] = ft_ptr->selfObs[i]->ymin;
-                    max[0] = ft_ptr->selfObs[i]->xmax;
-                    max[1] = ft_ptr->selfObs[i]->ymax;
-                    context->obstacles->Insert (min, max, ft_ptr->selfObs[i]);
+                    context->obstacles->push_back (ft_ptr->selfObs[i]);
 
                     if (!ft_ptr->selfObs[i]->holeOf) {
                         std::cout << "ERROR: SHOULD HAVE A PARENT!!!!!" << std::endl;
                     }
                 }
 
+                context->toProcess->push_back (ft_ptr);
+            } else { // check labelsize
+#ifdef _VERBOSE_
+                std::cerr << "Feature " <<  ft_ptr->layer->name << "/" << ft_ptr->uid << " is skipped (label size = 0)" << std::endl;
+#endif
+            }
+        }
+        return true;
+    }
+
+
+    /*
+     * Job function
+     *
+     * Clip the feature 'job' against the bbox and generate candidates for each
+     * resulting part. Candidates are not indexed here, so several jobs can run
+     * concurrently; Pal::extract merges results in features order.
+     */
+    void generateCandidatesJob (int job, int thread, void *ctx) {
+        CandidatesJobCtx *jobCtx = (CandidatesJobCtx*) ctx;
+        FeatCallBackCtx *context = jobCtx->context;
+        Feature *ft_ptr = jobCtx->features[job];
+        Arena *arena = jobCtx->arenas[thread];
+
+#ifdef _EXPORT_MAP_
+        bool svged = false; // is the feature has been written into the svg map ?
+        int dpi = context->layer->pal->getDpi();
+#endif
 
-                LinkedList<Feats*> *feats = new LinkedList<Feats*> (ptrFeatsCompare);
+        LinkedList<Feats*> *feats = new LinkedList<Feats*> (ptrFeatsCompare);
+        jobCtx->feats[job] = new LinkedList<Feats*> (ptrFeatsCompare);
 
-                if ( (ft_ptr->type == GEOS_LINESTRING)
-                        || ft_ptr->type == GEOS_POLYGON) {
+        // candidates of a feature clipped by the extent are not cached
+        bool whole = true;
 
-                    double bbx[4], bby[4];
+        if ( (ft_ptr->type == GEOS_LINESTRING)
+                || ft_ptr->type == GEOS_POLYGON) {
 
-                    bbx[0] = context->bbox_min[0];   bbx[1] = context->bbox_max[0];
-                    bbx[2] = context->bbox_max[0];   bbx[3] = context->bbox_min[0];
+            double bbx[4], bby[4];
 
-                    bby[0] = context->bbox_min[1];   bby[1] = context->bbox_min[1];
-                    bby[2] = context->bbox_max[1];   bby[3] = context->bbox_max[1];
+            bbx[0] = context->bbox_min[0];   bbx[1] = context->bbox_max[0];
+            bbx[2] = context->bbox_max[0];   bbx[3] = context->bbox_min[0];
 
-                    LinkedList<PointSet*> *shapes = new LinkedList<PointSet*> (ptrPSetCompare);
-                    bool outside, inside;
+            bby[0] = context->bbox_min[1];   bby[1] = context->bbox_min[1];
+            bby[2] = context->bbox_max[1];   bby[3] = context->bbox_max[1];
 
-                    // Fetch coordinates 
-                    ft_ptr->fetchCoordinates ();
-                    PointSet *shape = ft_ptr->createProblemSpecificPointSet (bbx, bby, &outside, &inside);
-                    ft_ptr->releaseCoordinates();
+            LinkedList<PointSet*> *shapes = new LinkedList<PointSet*> (ptrPSetCompare);
+            bool outside, inside;
 
+            // Fetch coordinates 
+            ft_ptr->fetchCoordinates ();
+            PointSet *shape = Feature::getSimplified (ft_ptr, context->simplifyTolerance)->createProblemSpecificPointSet (bbx, bby, &outside, &inside);
+            ft_ptr->releaseCoordinates();
 
 
 
-                    if (inside) {
-                        // no extra treatment required
-                        shapes->push_back (shape);
-                    } else {
-                        // feature isn't completly in the math
-                        if (ft_ptr->type == GEOS_LINESTRING)
-                            PointSet::reduceLine (shape, shapes, bbx, bby);
-                        else {
-                            PointSet::reducePolygon (shape, shapes, bbx, bby);
-                        }
-                    }
 
-                    while (shapes->size() > 0) {
-                        shape = shapes->pop_front();
-                        Feats *ft = new Feats();
-                        ft->feature = ft_ptr;
-                        ft->shape = shape;
-                        feats->push_back (ft);
+            if (inside) {
+                // no extra treatment required
+                shapes->push_back (shape);
+            } else {
+                whole = false;
+                // feature isn't completly in the math
+                if (ft_ptr->type == GEOS_LINESTRING)
+                    PointSet::reduceLine (shape, shapes, bbx, bby);
+                else {
+                    PointSet::reducePolygon (shape, shapes, bbx, bby);
+                }
+            }
+
+            while (shapes->size() > 0) {
+                shape = shapes->pop_front();
+                Feats *ft = new (arena) Feats();
+                ft->feature = ft_ptr;
+                ft->shape = shape;
+                feats->push_back (ft);
 
 #ifdef _EXPORT_MAP_
-                        if (!svged) {
-                            toSVGPath (shape->nbPoints, shape->type, shape->x, shape->y,
-                                       dpi , context->scale, context->unit, 
-                                       convert2pt (context->bbox_min[0], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
-                                       convert2pt (context->bbox_max[0], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
-                                       convert2pt (context->bbox_max[1], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
-                                       context->layer->name, ft_ptr->uid, *context->svgmap);
-                        }
-#endif
-                    }
-                    delete shapes;
-                } else {
-                    // Feat is a point
-                    Feats *ft = new Feats();
-                    ft->feature = ft_ptr;
-                    ft->shape = NULL;
-                    feats->push_back (ft);
+                if (!svged) {
+                    toSVGPath (shape->nbPoints, shape->type, shape->x, shape->y,
+                               dpi , context->scale, context->unit, 
+                               convert2pt (context->bbox_min[0], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
+                               convert2pt (context->bbox_max[0], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
+                               convert2pt (context->bbox_max[1], context->scale, dpi, context->unit, context->bbox_max[0] - context->bbox_min[0]),
+                               context->layer->name, ft_ptr->uid, *context->svgmap);
                 }
+#endif
+            }
+            delete shapes;
+        } else {
+            // Feat is a point
+            Feats *ft = new (arena) Feats();
+            ft->feature = ft_ptr;
+            ft->shape = NULL;
+            feats->push_back (ft);
+        }
 
-                // for earch feature part extracted : generate candidates
-                while (feats->size() > 0) {
-                    Feats *ft = feats->pop_front();
+        // for earch feature part extracted : generate candidates
+        while (feats->size() > 0) {
+            Feats *ft = feats->pop_front();
 
 #ifdef _DEBUG_
-                    std::cout << "Compute candidates for feat " <<  ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
+            std::cout << "Compute candidates for feat " <<  ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
 #endif
-                    ft->nblp = ft->feature->setPosition (context->scale, & (ft->lPos), context->bbox_min, context->bbox_max, ft->shape, context->candidates
+            ft->nblp = ft->feature->setPosition (context->scale, & (ft->lPos), context->bbox_min, context->bbox_max, ft->shape, NULL, arena, whole
 #ifdef _EXPORT_MAP_
-                                                         , *context->svgmap
+                                                 , *context->svgmap
 #endif
-                                                        );
+                                                );
 
-                    delete ft->shape;
-                    ft->shape = NULL;
+            delete ft->shape;
+            ft->shape = NULL;
 
-                    if (ft->nblp > 0) {
-                        // valid features are added to fFeats
-                        ft->priority = context->priority;
-                        context->fFeats->push_back (ft);
+            if (ft->nblp > 0) {
+                // valid features are kept
+                ft->priority = context->priority;
+                jobCtx->feats[job]->push_back (ft);
 #ifdef _DEBUG_
-                        std::cout << ft->nblp << " labelPositions for feature : " << ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
+                std::cout << ft->nblp << " labelPositions for feature : " << ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
 #endif
-                    } else {
-                        // Others are deleted
+            } else {
+                // Others are left in the arena
 #ifdef _VERBOSE_
-                        std::cout << "Unable to generate labelPosition for feature : " << ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
-#endif
-                        delete[] ft->lPos;
-                        delete ft;
-                    }
-                }
-                delete feats;
-            } else { // check labelsize
-#ifdef _VERBOSE_
-                std::cerr << "Feature " <<  ft_ptr->layer->name << "/" << ft_ptr->uid << " is skipped (label size = 0)" << std::endl;
+                std::cout << "Unable to generate labelPosition for feature : " << ft->feature->layer->name << "/" << ft->feature->uid << std::endl;
 #endif
             }
         }
-        return true;
+        delete feats;
     }
 
 
@@ -413,6 +493,7 @@ namespace pal {
     bool pruneLabelPositionCallback (LabelPosition *lp, void *ctx) {
 
         PointSet *feat = ( (PruneCtx*) ctx)->obstacle;
+        PointSet *shape = ( (PruneCtx*) ctx)->shape;
         double scale = ( (PruneCtx*) ctx)->scale;
         Pal* pal = ( (PruneCtx*) ctx)->pal;
 
@@ -439,7 +520,7 @@ namespace pal {
 
 
 
-        switch (feat->type) {
+        switch (shape->type) {
             //case geos::geom::GEOS_POINT:
         case GEOS_POINT:
 
@@ -447,7 +528,7 @@ namespace pal {
             std::cout << "    POINT" << std::endl;
 #endif
 
-            dist = dist_pointToLabel (feat->x[0], feat->y[0], lp);
+            dist = dist_pointToLabel (shape->x[0], shape->y[0], lp);
 
             if (dist < 0)
                 n = 2;
@@ -465,16 +546,16 @@ namespace pal {
 #endif
             // Is one of label's boarder cross the line ?
             for (i = 0;i < 4;i++) {
-                for (j = 0;j < feat->nbPoints - 1;j++) {
+                for (j = 0;j < shape->nbPoints - 1;j++) {
                     ca = cross_product (lp->x[i], lp->y[i], lp->x[ (i+1) %4], lp->y[ (i+1) %4],
-                                        feat->x[j], feat->y[j]);
+                                        shape->x[j], shape->y[j]);
                     cb = cross_product (lp->x[i], lp->y[i], lp->x[ (i+1) %4], lp->y[ (i+1) %4],
-                                        feat->x[j+1], feat->y[j+1]);
+                                        shape->x[j+1], shape->y[j+1]);
 
                     if ( (ca < 0 && cb > 0) || (ca > 0 && cb < 0)) {
-                        ca = cross_product (feat->x[j], feat->y[j], feat->x[j+1], feat->y[j+1],
+                        ca = cross_product (shape->x[j], shape->y[j], shape->x[j+1], shape->y[j+1],
                                             lp->x[i], lp->y[i]);
-                        cb = cross_product (feat->x[j], feat->y[j], feat->x[j+1], feat->y[j+1],
+                        cb = cross_product (shape->x[j], shape->y[j], shape->x[j+1], shape->y[j+1],
                                             lp->x[ (i+1) %4], lp->y[ (i+1) %4]);
                         if ( (ca < 0 && cb > 0) || (ca > 0 && cb < 0)) {
                             n = 1;
@@ -490,7 +571,10 @@ namespace pal {
 #ifdef _DEBUG_FULL
             std::cout << "    POLY" << std::endl;
 #endif
-            n =  nbLabelPointInPolygon (feat->nbPoints, feat->x, feat->y, lp->x, lp->y);
+            if (lp->axisAligned)
+                n = nbLabelPointInPolygon<AxisAlignedRect> (shape->nbPoints, shape->x, shape->y, lp->x, lp->y);
+            else
+                n = nbLabelPointInPolygon<RotatedRect> (shape->nbPoints, shape->x, shape->y, lp->x, lp->y);
 
             //n<1?n=0:n=1;
             break;
@@ -538,7 +622,9 @@ namespace pal {
     typedef struct _filterContext {
         RTree<LabelPosition*, double, 2, double> *cdtsIndex;
         double scale;
+        double simplifyTolerance; // [map unit]
         Pal* pal;
+        long nbQueries;
     } FilterContext;
 
     bool filteringCallback (PointSet *pset, void *ctx) {
@@ -564,8 +650,11 @@ namespace pal {
 
         pruneContext.scale = scale;
         pruneContext.obstacle = pset;
+        pruneContext.shape = Feature::getSimplified (pset, ( (FilterContext*) ctx)->simplifyTolerance);
         pruneContext.pal = pal;
-        cdtsIndex->Search (amin, amax, pruneLabelPositionCallback, (void*) &pruneContext);
+        StaticCallback<LabelPosition*, pruneLabelPositionCallback> visitor (&pruneContext);
+        cdtsIndex->Visit (amin, amax, visitor);
+        ( (FilterContext*) ctx)->nbQueries++;
 
         if (pset->holeOf == NULL) {
             ( (Feature*) pset)->releaseCoordinates();
@@ -590,9 +679,9 @@ namespace pal {
     * param phi_max north bbox
     * param scale the scale
     */
-    Problem* Pal::extract (int nbLayers, char **layersName, double *layersFactor, double lambda_min, double phi_min, double lambda_max, double phi_max, double scale, std::ofstream *svgmap) {
+    Problem* Pal::extract (int nbLayers, char **layersName, double *layersFactor, double lambda_min, double phi_min, double lambda_max, double phi_max, double scale, std::ofstream *svgmap, LabellingSession *session) {
         // to store obstacles
-        RTree<PointSet*, double, 2, double> *obstacles = new RTree<PointSet*, double, 2, double>();
+        RTree<PointSet*, double, 2, double> *obstacles;
 
         Problem *prob = new Problem();
 
@@ -605,9 +694,12 @@ namespace pal {
         double amax[2];
 
         int max_p = 0;
+        int nbCandidates = 0;
 
         LabelPosition* lp;
 
+        double phaseStart = wallTime();
+
         bbx[0] = bbx[3] = amin[0] = prob->bbox[0] = lambda_min;
         bby[0] = bby[1] = amin[1] = prob->bbox[1] = phi_min;
         bbx[1] = bbx[2] = amax[0] = prob->bbox[2] = lambda_max;
@@ -620,11 +712,10 @@ namespace pal {
         LinkedList<Feats*> *fFeats = new LinkedList<Feats*> (ptrFeatsCompare);
 
         FeatCallBackCtx *context = new FeatCallBackCtx();
-        context->fFeats = fFeats;
+        context->toProcess = new LinkedList<Feature*> (ptrFeatureCompare);
         context->scale = scale;
         context->unit = map_unit;
-        context->obstacles = obstacles;
-        context->candidates = prob->candidates;
+        context->obstacles = new LinkedList<PointSet*> (ptrPSetCompare);
 
         context->bbox_min[0] = amin[0];
         context->bbox_min[1] = amin[1];
@@ -632,6 +723,15 @@ namespace pal {
         context->bbox_max[0] = amax[0];
         context->bbox_max[1] = amax[1];
 
+        // rounded down to a power of two, so that close scales share their
+        // simplified geometries
+        double simplifyDist = 0.0;
+        if (simplifyTolerance > 0) {
+            simplifyDist = unit_convert (simplifyTolerance, pal::PIXEL, map_unit, dpi, scale, amax[0] - amin[0]);
+            simplifyDist = pow (2.0, floor (log (simplifyDist) / log (2.0)));
+        }
+        context->simplifyTolerance = simplifyDist;
+
 #ifdef _EXPORT_MAP_
         context->svgmap = svgmap;
 #endif
@@ -649,8 +749,19 @@ namespace pal {
         int oldNbft = 0;
         Layer *layer;
 
+        int nbJobThreads = nbThreads;
+#ifdef _EXPORT_MAP_
+        // svg map is written while generating candidates
+        nbJobThreads = 1;
+#endif
+
         std::list<char*> *labLayers = new std::list<char*>();
 
+        // each thread carves candidates from its own arena
+        Arena **arenas = new Arena*[nbJobThreads];
+        for (i = 0;i < nbJobThreads;i++)
+            arenas[i] = new Arena();
+
         lyrsMutex->lock();
         for (i = 0;i < nbLayers;i++) {
             for (std::list<Layer*>::iterator it = layers->begin(); it != layers->end();it++) { // iterate on pal->layers
@@ -672,9 +783,38 @@ namespace pal {
 #endif
 
                         context->layer->modMutex->lock();
-                        context->layer->rtree->Search (amin, amax, extractFeatCallback, (void*) context);
+                        StaticCallback<Feature*, extractFeatCallback> visitor (context);
+                        context->layer->rtree->Visit (amin, amax, visitor);
+                        prob->nbRTreeQueries++;
+
+                        // generate candidates for collected features
+                        int nbJobs = context->toProcess->size();
+                        CandidatesJobCtx jobCtx;
+                        jobCtx.context = context;
+                        jobCtx.features = new Feature*[nbJobs];
+                        jobCtx.feats = new LinkedList<Feats*>*[nbJobs];
+                        jobCtx.arenas = arenas;
+                        for (j = 0;j < nbJobs;j++) {
+                            jobCtx.features[j] = context->toProcess->pop_front();
+                            if (session)
+                                session->see (jobCtx.features[j]);
+                        }
+
+                        parallelRun (nbJobThreads, nbJobs, generateCandidatesJob, (void*) &jobCtx);
                         context->layer->modMutex->unlock();
 
+                        // merge in features order, so the problem doesn't depend on # threads
+                        for (j = 0;j < nbJobs;j++) {
+                            while (jobCtx.feats[j]->size() > 0) {
+                                Feats *ft = jobCtx.feats[j]->pop_front();
+                                nbCandidates += ft->nblp;
+                                fFeats->push_back (ft);
+                            }
+                            delete jobCtx.feats[j];
+                        }
+                        delete[] jobCtx.features;
+                        delete[] jobCtx.feats;
+
 #ifdef _EXPORT_MAP_
                         *svgmap  << "</g>" << std::endl << std::endl;
 #endif
@@ -686,14 +826,14 @@ namespace pal {
                         std::cout << "     obstacle:" << layer->isObstacle() << std::endl;
                         std::cout << "     toLabel:" << layer->isToLabel() << std::endl;
                         std::cout << "     # features: " << layer->getNbFeatures() << std::endl;
-                        std::cout << "     # extracted features: " << context->fFeats->size() - oldNbft << std::endl;
+                        std::cout << "     # extracted features: " << fFeats->size() - oldNbft << std::endl;
 #endif
-                        if (context->fFeats->size() - oldNbft > 0) {
+                        if (fFeats->size() - oldNbft > 0) {
                             char *name = new char[strlen (layer->getName()) +1];
                             strcpy (name, layer->getName());
                             labLayers->push_back (name);
                         }
-                        oldNbft = context->fFeats->size();
+                        oldNbft = fFeats->size();
 
 
                         break;
@@ -701,9 +841,51 @@ namespace pal {
                 }
             }
         }
-        delete context;
+        delete context->toProcess;
         lyrsMutex->unlock();
 
+        for (i = 0;i < nbJobThreads;i++) {
+            prob->arena->adopt (arenas[i]);
+            delete arenas[i];
+        }
+        delete[] arenas;
+
+        /* Obstacles and candidates are known : build packed indexes at once */
+        int nbObstacles = context->obstacles->size();
+        double *bmin = new double[2 * (nbObstacles > nbCandidates ? nbObstacles : nbCandidates)];
+        double *bmax = new double[2 * (nbObstacles > nbCandidates ? nbObstacles : nbCandidates)];
+
+        PointSet **obstaclesData = new PointSet*[nbObstacles];
+        for (i = 0;i < nbObstacles;i++) {
+            PointSet *pset = context->obstacles->pop_front();
+            bmin[2*i] = pset->xmin;
+            bmin[2*i+1] = pset->ymin;
+            bmax[2*i] = pset->xmax;
+            bmax[2*i+1] = pset->ymax;
+            obstaclesData[i] = pset;
+        }
+        obstacles = new RTree<PointSet*, double, 2, double> (nbObstacles, bmin, bmax, obstaclesData);
+        delete[] obstaclesData;
+        delete context->obstacles;
+        delete context;
+
+        LabelPosition **candidatesData = new LabelPosition*[nbCandidates];
+        i = 0;
+        for (Cell<Feats*> *it = fFeats->getFirst();it;it = it->next) {
+            for (c = 0;c < it->item->nblp;c++, i++) {
+                it->item->lPos[c]->getBoundingBox (bmin + 2 * i, bmax + 2 * i);
+                candidatesData[i] = it->item->lPos[c];
+            }
+        }
+        prob->candidates->BulkLoad (nbCandidates, bmin, bmax, candidatesData);
+        delete[] candidatesData;
+        delete[] bmin;
+        delete[] bmax;
+
+        prob->nbCandidates = nbCandidates;
+        prob->extractTime = wallTime() - phaseStart;
+        phaseStart = wallTime();
+
 
         prob->nbLabelledLayers = labLayers->size();
         prob->labelledLayersName = new char*[prob->nbLabelledLayers];
@@ -741,8 +923,12 @@ namespace pal {
         FilterContext filterCtx;
         filterCtx.cdtsIndex = prob->candidates;
         filterCtx.scale = prob->scale;
+        filterCtx.simplifyTolerance = simplifyDist;
         filterCtx.pal = this;
-        obstacles->Search (amin, amax, filteringCallback, (void*) &filterCtx);
+        filterCtx.nbQueries = 0;
+        StaticCallback<PointSet*, filteringCallback> filterVisitor (&filterCtx);
+        obstacles->Visit (amin, amax, filterVisitor);
+        prob->nbRTreeQueries += filterCtx.nbQueries + 1;
 
 
         int idlp = 0;
@@ -795,17 +981,17 @@ namespace pal {
 #endif
 
             // Sets costs for candidates of polygon
-            if (feat->feature->type == GEOS_POLYGON && (feat->feature->layer->arrangement == P_FREE || feat->feature->layer->arrangement == P_HORIZ))
-                LabelPosition::setCost (stop, feat->lPos, max_p, obstacles, bbx, bby);
+            if (feat->feature->type == GEOS_POLYGON && (feat->feature->layer->arrangement == P_FREE || feat->feature->layer->arrangement == P_HORIZ)) {
+                LabelPosition::setCost (stop, feat->lPos, max_p, obstacles, bbx, bby, simplifyDist);
+                prob->nbRTreeQueries += stop + 1;
+            }
 
 #ifdef _DEBUG_FULL_
             std::cout << "All Cost are setted" << std::endl;
 #endif
             // only keep the 'max_p' best candidates
             for (j = max_p;j < feat->nblp;j++) {
-                // TODO remove from index
                 feat->lPos[j]->removeFromIndex (prob->candidates);
-                delete feat->lPos[j];
             }
             feat->nblp = max_p;
 
@@ -829,8 +1015,7 @@ namespace pal {
 
 
         idlp = 0;
-        int nbOverlaps = 0;
-        prob->labelpositions = new LabelPosition*[prob->nblp];
+        prob->labelpositions = prob->arena->allocArray<LabelPosition*> (prob->nblp);
         //prob->feat = new int[prob->nblp];
 
 #ifdef _DEBUG_FULL_
@@ -852,33 +1037,8 @@ namespace pal {
 
                 prob->labelpositions[idlp] = lp;
                 //prob->feat[idlp] = j;
-
-
-                amin[0] = DBL_MAX;
-                amax[0] = -DBL_MAX;
-                amin[1] = DBL_MAX;
-                amax[1] = -DBL_MAX;
-                for (c = 0;c < 4;c++) {
-                    if (lp->x[c] < amin[0])
-                        amin[0] = lp->x[c];
-                    if (lp->x[c] > amax[0])
-                        amax[0] = lp->x[c];
-                    if (lp->y[c] < amin[1])
-                        amin[1] = lp->y[c];
-                    if (lp->y[c] > amax[1])
-                        amax[1] = lp->y[c];
-                }
-                // lookup for overlapping candidate
-                prob->candidates->Search (amin, amax, countOverlapCallback, (void*) lp);
-
-                nbOverlaps += lp->nbOverlap;
-#ifdef _DEBUG_FULL_
-                std::cout << "Nb overlap for " << idlp << "/" << prob->nblp - 1 << " : " << lp->nbOverlap << std::endl;
-#endif
             }
             j++;
-            delete[] feat->lPos;
-            delete feat;
         }
         delete fFeats;
 
@@ -886,10 +1046,18 @@ namespace pal {
         releaseAllInIndex (obstacles);
         delete obstacles;
 
+        prob->filterTime = wallTime() - phaseStart;
+        phaseStart = wallTime();
 
-        nbOverlaps /= 2;
         prob->all_nblp = prob->nblp;
-        prob->nbOverlap = nbOverlaps;
+
+        prob->geom = new (prob->arena) CandidateGeom (prob->all_nblp, prob->labelpositions, prob->arena);
+
+        // lookup for overlapping candidates once for all
+        prob->buildConflictGraph (nbThreads);
+
+        prob->conflictGraphTime = wallTime() - phaseStart;
+        phaseStart = wallTime();
 
 
 #ifdef _VERBOSE_
@@ -907,10 +1075,21 @@ namespace pal {
                   << prob->nbOverlap;
 #endif
 
+        prob->decompose();
+
+        prob->reduceTime = wallTime() - phaseStart;
+
+        if (session)
+            session->warmStart (prob);
+
         return prob;
     }
 
-    std::list<Label*>* Pal::labeller (double scale, double bbox[4], PalStat **stats, bool displayAll) {
+    std::list<Label*>* Pal::labeller (double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget) {
+        return labeller (scale, bbox, stats, displayAll, NULL, timeBudget);
+    }
+
+    std::list<Label*>* Pal::labeller (double scale, double bbox[4], PalStat **stats, bool displayAll, LabellingSession *session, double timeBudget) {
 
 #ifdef _DEBUG_FULL_
         std::cout << "LABELLER (active)" << std::endl;
@@ -932,7 +1111,7 @@ namespace pal {
         }
         lyrsMutex->unlock();
 
-        std::list<Label*> * solution = labeller (nbLayers, layersName, priorities, scale, bbox, stats, displayAll);
+        std::list<Label*> * solution = labeller (nbLayers, layersName, priorities, scale, bbox, stats, displayAll, session, timeBudget);
 
         delete[] layersName;
         delete[] priorities;
@@ -943,11 +1122,17 @@ namespace pal {
     /*
      * BIG MACHINE
      */
-    std::list<Label*>* Pal::labeller (int nbLayers, char **layersName , double *layersFactor, double scale, double bbox[4], PalStat **stats, bool displayAll) {
+    std::list<Label*>* Pal::labeller (int nbLayers, char **layersName , double *layersFactor, double scale, double bbox[4], PalStat **stats, bool displayAll, double timeBudget) {
+        return labeller (nbLayers, layersName, layersFactor, scale, bbox, stats, displayAll, NULL, timeBudget);
+    }
+
+    std::list<Label*>* Pal::labeller (int nbLayers, char **layersName , double *layersFactor, double scale, double bbox[4], PalStat **stats, bool displayAll, LabellingSession *session, double timeBudget) {
 #ifdef _DEBUG_
         std::cout << "LABELLER (selection)" << std::endl;
 #endif
 
+        double labellerStart = wallTime();
+
         Problem *prob;
 
         SearchMethod old_searchMethod = searchMethod;
@@ -979,15 +1164,21 @@ namespace pal {
         << "height=\"" << convert2pt (bbox[3] - bbox[1], scale, dpi, map_unit, bbox[2] - bbox[0])  << "\">" << std::endl; // TODO xmax ymax
 #endif
 
+        if (session)
+            session->begin (scale);
+
         // First, extract the problem
         // TODO which is the minimum scale ? (> 0, >= 0, >= 1, >1 )
         if (scale < 1 || (prob = extract (nbLayers, layersName, layersFactor, bbox[0], bbox[1], bbox[2], bbox[3], scale,
 #ifdef _EXPORT_MAP_
-                                          & svgmap
+                                          & svgmap,
 #else
-                                          NULL
+                                          NULL,
 #endif
-                                         )) == NULL) {
+                                          session)) == NULL) {
+
+            if (session)
+                session->end (NULL);
 
 #ifdef _VERBOSE_
             if (scale < 1)
@@ -1002,13 +1193,22 @@ namespace pal {
 #endif
 
             // nothing to be done => return an empty result set
-            if (stats)
+            if (stats) {
                 (*stats) = new PalStat();
+                (*stats)->nbCoordCacheHits = coordCache->getNbHits();
+                (*stats)->nbCoordCacheMisses = coordCache->getNbMisses();
+                (*stats)->nbCandidateCacheHits = candidateCache->getNbHits();
+                (*stats)->nbCandidateCacheMisses = candidateCache->getNbMisses();
+            }
             return new std::list<Label*>();
         }
 
         prob->displayAll = displayAll;
 
+        // the budget includes the problem extraction
+        if (timeBudget >= 0)
+            prob->deadline = labellerStart + timeBudget;
+
 #ifdef _VERBOSE_
         create_time = double (clock() - start) / double (CLOCKS_PER_SEC);
 
@@ -1017,7 +1217,9 @@ namespace pal {
 #endif
 
         // search a solution
-        if (searchMethod != CHAIN)
+        if (nbStarts > 1)
+            prob->multiStart (nbStarts);
+        else if (searchMethod != CHAIN && searchMethod != BRANCH_AND_BOUND)
             prob->popmusic();
         else
             prob->chain_search();
@@ -1028,8 +1230,21 @@ namespace pal {
 
         std::list<Label*> * solution = prob->getSolution (displayAll);
 
-        if (stats)
+        if (session)
+            session->end (prob);
+
+        if (stats) {
             *stats = prob->getStats();
+            (*stats)->nbCoordCacheHits = coordCache->getNbHits();
+            (*stats)->nbCoordCacheMisses = coordCache->getNbMisses();
+            (*stats)->nbCandidateCacheHits = candidateCache->getNbHits();
+            (*stats)->nbCandidateCacheMisses = candidateCache->getNbMisses();
+        }
+
+#ifdef _VERBOSE_
+        std::cout << "Coordinates cache: " << coordCache->getNbHits() << " hits, " << coordCache->getNbMisses() << " misses, " << coordCache->getSize() << " bytes" << std::endl;
+        std::cout << "Candidates cache: " << candidateCache->getNbHits() << " hits, " << candidateCache->getNbMisses() << " misses, " << candidateCache->getSize() << " bytes" << std::endl;
+#endif
 
 #ifdef _EXPORT_MAP_
         prob->drawLabels (svgmap);
@@ -1125,10 +1340,93 @@ namespace pal {
         return dpi;
     }
 
+    void Pal::setSimplifyTolerance (double tolerance) {
+        if (tolerance >= 0)
+            simplifyTolerance = tolerance;
+    }
+
+    double Pal::getSimplifyTolerance () {
+        return simplifyTolerance;
+    }
+
     SearchMethod Pal::getSearch() {
         return searchMethod;
     }
 
+    void Pal::setNbThreads (int nbThreads) {
+        if (nbThreads > 0)
+            this->nbThreads = nbThreads;
+    }
+
+    int Pal::getNbThreads () {
+        return nbThreads;
+    }
+
+    void Pal::setNbStarts (int nbStarts) {
+        if (nbStarts > 0)
+            this->nbStarts = nbStarts;
+    }
+
+    int Pal::getNbStarts () {
+        return nbStarts;
+    }
+
+    void Pal::setExactSearchSize (int size) {
+        exactSearchSize = size;
+    }
+
+    int Pal::getExactSearchSize () {
+        return exactSearchSize;
+    }
+
+    void Pal::setDeterministic (bool deterministic) {
+        this->deterministic = deterministic;
+    }
+
+    bool Pal::isDeterministic () {
+        return deterministic;
+    }
+
+    void Pal::setSeed (unsigned int seed) {
+        this->seed = seed;
+    }
+
+    unsigned int Pal::getSeed () {
+        return seed;
+    }
+
+    void Pal::setCoordCacheSize (size_t size) {
+        coordCache->setMaxSize (size);
+    }
+
+    size_t Pal::getCoordCacheSize () {
+        return coordCache->getMaxSize();
+    }
+
+    long Pal::getCoordCacheHits () {
+        return coordCache->getNbHits();
+    }
+
+    long Pal::getCoordCacheMisses () {
+        return coordCache->getNbMisses();
+    }
+
+    void Pal::setCandidateCacheSize (size_t size) {
+        candidateCache->setMaxSize (size);
+    }
+
+    size_t Pal::getCandidateCacheSize () {
+        return candidateCache->getMaxSize();
+    }
+
+    long Pal::getCandidateCacheHits () {
+        return candidateCache->getNbHits();
+    }
+
+    long Pal::getCandidateCacheMisses () {
+        return candidateCache->getNbMisses();
+    }
+
     void Pal::setSearch (SearchMethod method) {
         switch (method) {
         case POPMUSIC_CHAIN:
@@ -1144,6 +1442,10 @@ namespace pal {
             searchMethod      = method;
             ejChainDeg         = 50;
             break;
+        case BRANCH_AND_BOUND:
+            searchMethod = method;
+            ejChainDeg = 50;
+            break;
         case POPMUSIC_TABU:
             searchMethod = method;
             popmusic_r = 25;
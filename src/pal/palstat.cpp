@@ -39,6 +39,24 @@ namespace pal {
         layersName = NULL;
         layersNbObjects = NULL;
         layersNbLabelledObjects = NULL;
+        nbCoordCacheHits = 0;
+        nbCoordCacheMisses = 0;
+        nbCandidateCacheHits = 0;
+        nbCandidateCacheMisses = 0;
+        extractTime = 0;
+        filterTime = 0;
+        conflictGraphTime = 0;
+        reduceTime = 0;
+        initSolTime = 0;
+        searchTime = 0;
+        nbCandidates = 0;
+        nbPrunedCandidates = 0;
+        nbConflicts = 0;
+        nbRTreeQueries = 0;
+        nbConflictTests = 0;
+        nbSearchIterations = 0;
+        solutionCost = 0;
+        budgetHit = false;
     }
 
     PalStat::~PalStat() {
@@ -88,6 +106,78 @@ namespace pal {
             return -1;
     }
 
+    long PalStat::getNbCoordCacheHits() {
+        return nbCoordCacheHits;
+    }
+
+    long PalStat::getNbCoordCacheMisses() {
+        return nbCoordCacheMisses;
+    }
+
+    long PalStat::getNbCandidateCacheHits() {
+        return nbCandidateCacheHits;
+    }
+
+    long PalStat::getNbCandidateCacheMisses() {
+        return nbCandidateCacheMisses;
+    }
+
+    double PalStat::getExtractTime() {
+        return extractTime;
+    }
+
+    double PalStat::getFilteringTime() {
+        return filterTime;
+    }
+
+    double PalStat::getConflictGraphTime() {
+        return conflictGraphTime;
+    }
+
+    double PalStat::getReduceTime() {
+        return reduceTime;
+    }
+
+    double PalStat::getInitialSolutionTime() {
+        return initSolTime;
+    }
+
+    double PalStat::getSearchTime() {
+        return searchTime;
+    }
+
+    long PalStat::getNbCandidates() {
+        return nbCandidates;
+    }
+
+    long PalStat::getNbPrunedCandidates() {
+        return nbPrunedCandidates;
+    }
+
+    long PalStat::getNbConflicts() {
+        return nbConflicts;
+    }
+
+    long PalStat::getNbRTreeQueries() {
+        return nbRTreeQueries;
+    }
+
+    long PalStat::getNbConflictTests() {
+        return nbConflictTests;
+    }
+
+    long PalStat::getNbSearchIterations() {
+        return nbSearchIterations;
+    }
+
+    double PalStat::getSolutionCost() {
+        return solutionCost;
+    }
+
+    bool PalStat::isBudgetHit() {
+        return budgetHit;
+    }
+
 
 } // namespace
 
@@ -1535,6 +1535,145 @@ namespace pal {
 
 
 
+    /*
+     * squared distance from (px,py) to the segment a->b
+     */
+    static inline double distToSegment_sq (double px, double py, double ax, double ay, double bx, double by) {
+        double dx = bx - ax;
+        double dy = by - ay;
+        double len = dx * dx + dy * dy;
+        double t;
+
+        if (len < EPSILON)
+            return dist_euc2d_sq (px, py, ax, ay);
+
+        t = ( (px - ax) * dx + (py - ay) * dy) / len;
+        if (t < 0)
+            t = 0;
+        else if (t > 1)
+            t = 1;
+
+        return dist_euc2d_sq (px, py, ax + t * dx, ay + t * dy);
+    }
+
+
+    /*
+     * Douglas-Peucker over points first..last, indices modulo nbPoints so
+     * that a ring can end with its first point. Points to keep are flagged
+     * in keep, stack holds 2 * (last - first) ints.
+     */
+    static void douglasPeucker (int nbPoints, double *x, double *y, int first, int last,
+                                double tolerance_sq, bool *keep, int *stack) {
+        int i, a, b;
+        int far;
+        int top = 0;
+        double d;
+        double dmax;
+
+        stack[top++] = first;
+        stack[top++] = last;
+
+        while (top > 0) {
+            b = stack[--top];
+            a = stack[--top];
+
+            far = -1;
+            dmax = tolerance_sq;
+            for (i = a + 1;i < b;i++) {
+                d = distToSegment_sq (x[i % nbPoints], y[i % nbPoints],
+                                      x[a % nbPoints], y[a % nbPoints], x[b % nbPoints], y[b % nbPoints]);
+                if (d > dmax) {
+                    dmax = d;
+                    far = i;
+                }
+            }
+
+            if (far >= 0) {
+                keep[far % nbPoints] = true;
+                stack[top++] = a;
+                stack[top++] = far;
+                stack[top++] = far;
+                stack[top++] = b;
+            }
+        }
+    }
+
+
+    PointSet *PointSet::simplify (double tolerance) {
+        int i, j;
+        int nbKept;
+        bool ring = (type == GEOS_POLYGON);
+
+        if (type == GEOS_POINT || nbPoints < (ring ? 4 : 3))
+            return NULL;
+
+        bool *keep = new bool[nbPoints];
+        int *stack = new int[2 * (nbPoints + 1)];
+
+        for (i = 0;i < nbPoints;i++)
+            keep[i] = false;
+        keep[0] = true;
+
+        if (ring) {
+            // the ring is split at its point the farthest from the first one
+            int far = 0;
+            double d;
+            double dmax = 0.0;
+            for (i = 1;i < nbPoints;i++) {
+                d = dist_euc2d_sq (x[0], y[0], x[i], y[i]);
+                if (d > dmax) {
+                    dmax = d;
+                    far = i;
+                }
+            }
+            keep[far] = true;
+            douglasPeucker (nbPoints, x, y, 0, far, tolerance * tolerance, keep, stack);
+            douglasPeucker (nbPoints, x, y, far, nbPoints, tolerance * tolerance, keep, stack);
+        } else {
+            keep[nbPoints-1] = true;
+            douglasPeucker (nbPoints, x, y, 0, nbPoints - 1, tolerance * tolerance, keep, stack);
+        }
+
+        delete[] stack;
+
+        nbKept = 0;
+        for (i = 0;i < nbPoints;i++)
+            if (keep[i])
+                nbKept++;
+
+        if (nbKept == nbPoints || (ring && nbKept < 3)) {
+            delete[] keep;
+            return NULL;
+        }
+
+        PointSet *shape = new PointSet();
+        shape->type = type;
+        shape->nbPoints = nbKept;
+        shape->x = new double[nbKept];
+        shape->y = new double[nbKept];
+        shape->holeOf = NULL;
+        shape->parent = NULL;
+
+        shape->xmin = shape->ymin = DBL_MAX;
+        shape->xmax = shape->ymax = -DBL_MAX;
+        for (i = 0, j = 0;i < nbPoints;i++) {
+            if (keep[i]) {
+                shape->x[j] = x[i];
+                shape->y[j] = y[i];
+                shape->xmin = min (shape->xmin, x[i]);
+                shape->xmax = max (shape->xmax, x[i]);
+                shape->ymin = min (shape->ymin, y[i]);
+                shape->ymax = max (shape->ymax, y[i]);
+                j++;
+            }
+        }
+
+        delete[] keep;
+
+        return shape;
+    }
+
+
     void PointSet::getCentroid (double &px, double &py) {
         double ix, iy;
         double mesh = min ( (xmax - xmin) / 10, (ymax - ymin) / 10);
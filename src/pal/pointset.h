@@ -42,6 +42,7 @@
 namespace pal {
 
     class Pal;
+    class PalGeometry;
     class Feat;
     class Feature;
     class Projection;
@@ -83,6 +84,7 @@ namespace pal {
 
     class PointSet {
         friend class Feature;
+        friend class CoordCache;
         friend class Pal;
         friend class Layer;
         friend class LabelPosition;
@@ -92,8 +94,11 @@ namespace pal {
         //friend Feat *splitButterflyPolygon (Feat *f, int pt_a, int pt_b, double cx, double cy);
         friend bool obstacleCallback (PointSet *feat, void *ctx);
         friend bool extractFeatCallback (Feature*, void*);
+        friend void generateCandidatesJob (int job, int thread, void *ctx);
         friend void extractXYCoord (Feat *f);
         friend LinkedList<Feat*> * splitGeom (GEOSGeometry *the_geom, const char *geom_id);
+        friend void extractSpanCoord (Feat *f, PalGeometry *userGeom, int part);
+        friend void deleteFeat (Feat *f);
         friend void releaseAllInIndex (RTree<PointSet*, double, 2, double> *obstacles);
         friend bool releaseCallback (PointSet *pset, void *ctx);
         friend bool filteringCallback (PointSet*, void*);
@@ -246,6 +251,17 @@ namespace pal {
          */
         double getDist(double px, double py, double *rx, double *ry);
 
+        /**
+         * \brief Douglas-Peucker simplification
+         *
+         * Points closer than tolerance to the simplified line or ring are
+         * removed. A ring keeps at least three points.
+         *
+         * @param tolerance largest distance between a removed point and the result [map unit]
+         * @return a new point set, NULL when no point can be removed
+         */
+        PointSet *simplify (double tolerance);
+
 
 
         //double getDistInside(double px, double py);
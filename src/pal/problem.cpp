@@ -40,6 +40,7 @@
 #include <climits>
 #include <ctime>
 #include <list>
+#include <algorithm>
 
 #include <pal/pal.h>
 #include <pal/palstat.h>
@@ -48,12 +49,16 @@
 
 #include "linkedlist.hpp"
 #include "rtree.hpp"
+#include "arena.h"
+#include "candidategeom.h"
 #include "feature.h"
 #include "geomfunction.h"
 #include "labelposition.h"
 #include "problem.h"
 #include "util.h"
 #include "priorityqueue.h"
+#include "simplemutex.h"
+#include "threadpool.h"
 
 
 
@@ -67,15 +72,102 @@ namespace pal {
         }
     }
 
+    /*
+     * xorshift generator of the multi-start search, the same sequence for
+     * a given seed whatever the platform and the threads. The state must
+     * not be 0.
+     */
+    inline unsigned int nextRandom (unsigned int *state) {
+        unsigned int x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *state = x;
+        return x;
+    }
+
     Problem::Problem() : nblp (0), all_nblp (0), nbft (0), displayAll (0), labelpositions (NULL), featStartId (NULL), featNbLp (NULL), inactiveCost (NULL), sol (NULL) {
         bbox[0] = 0;
         bbox[1] = 0;
         bbox[2] = 0;
         bbox[3] = 0;
-        featWrap = NULL;
         candidates = new RTree<LabelPosition*, double, 2, double>();
         candidates_sol = new RTree<LabelPosition*, double, 2, double>();
-        candidates_subsol = NULL;
+        arena = new Arena();
+        geom = NULL;
+        conflictStart = NULL;
+        conflictList = NULL;
+        nbComponents = 0;
+        componentStart = NULL;
+        componentFeats = NULL;
+        featComponent = NULL;
+        warmSol = NULL;
+        featNbOverlap = NULL;
+        nbActive = 0;
+        nbSolOverlap = 0;
+        deadline = -1;
+        budgetHit = false;
+        model = NULL;
+        startSeed = 0;
+        extractTime = 0;
+        filterTime = 0;
+        conflictGraphTime = 0;
+        reduceTime = 0;
+        initSolTime = 0;
+        searchTime = 0;
+        nbCandidates = 0;
+        nbRTreeQueries = 0;
+        nbConflictTests = 0;
+        nbSearchIterations = 0;
+    }
+
+    Problem::Problem (Problem *model, unsigned int startSeed) : model (model), startSeed (startSeed) {
+        int i;
+
+        nbLabelledLayers = model->nbLabelledLayers;
+        labelledLayersName = model->labelledLayersName;
+        nblp = model->nblp;
+        all_nblp = model->all_nblp;
+        nbft = model->nbft;
+        displayAll = model->displayAll;
+        for (i = 0;i < 4;i++)
+            bbox[i] = model->bbox[i];
+        scale = model->scale;
+        labelpositions = model->labelpositions;
+        geom = model->geom;
+        candidates = model->candidates;
+        conflictStart = model->conflictStart;
+        conflictList = model->conflictList;
+        nbComponents = model->nbComponents;
+        componentStart = model->componentStart;
+        componentFeats = model->componentFeats;
+        featComponent = model->featComponent;
+        featStartId = model->featStartId;
+        featNbLp = model->featNbLp;
+        inactiveCost = model->inactiveCost;
+        warmSol = model->warmSol;
+        nbOverlap = model->nbOverlap;
+        deadline = model->deadline;
+        pal = model->pal;
+
+        // owned by the start
+        candidates_sol = new RTree<LabelPosition*, double, 2, double>();
+        arena = new Arena();
+        sol = NULL;
+        featNbOverlap = NULL;
+        nbActive = 0;
+        nbSolOverlap = 0;
+        budgetHit = false;
+        extractTime = 0;
+        filterTime = 0;
+        conflictGraphTime = 0;
+        reduceTime = 0;
+        initSolTime = 0;
+        searchTime = 0;
+        nbCandidates = 0;
+        nbRTreeQueries = 0;
+        nbConflictTests = 0;
+        nbSearchIterations = 0;
     }
 
     Problem::~Problem() {
@@ -87,9 +179,17 @@ namespace pal {
             delete sol;
         }
 
+        if (featNbOverlap)
+            delete[] featNbOverlap;
+
+        delete candidates_sol;
+
+        // sub parts and search scratch
+        if (model) {
+            delete arena;
+            return;
+        }
 
-        if (featWrap)
-            delete[] featWrap;
         if (featStartId)
             delete[] featStartId;
         if (featNbLp)
@@ -100,21 +200,27 @@ namespace pal {
 
         delete[] labelledLayersName;
 
-        for (i = 0;i < all_nblp;i++)
-            delete labelpositions[i];
-
-        if (labelpositions)
-            delete[] labelpositions;
-
         if (inactiveCost)
             delete[] inactiveCost;
 
         delete candidates;
-        delete candidates_sol;
 
-        if (candidates_subsol) {
-            delete candidates_subsol;
-        }
+        if (conflictStart)
+            delete[] conflictStart;
+        if (conflictList)
+            delete[] conflictList;
+
+        if (componentStart)
+            delete[] componentStart;
+        if (componentFeats)
+            delete[] componentFeats;
+        if (featComponent)
+            delete[] featComponent;
+        if (warmSol)
+            delete[] warmSol;
+
+        // candidates and labelpositions
+        delete arena;
     }
 
     typedef struct {
@@ -141,21 +247,144 @@ namespace pal {
     }
 
 
+    /*
+     * per thread buffers for index hits
+     */
     typedef struct {
-        LabelPosition *lp;
-        int *nbOverlaps;
-    } RemoveOverlapContext;
+        LabelPosition **hits;
+        int capacity;
+        int *ids;
+        int idsCapacity;
+    } HitsBuffer;
+
+    typedef struct {
+        CandidateGeom *geom;
+        RTree<LabelPosition*, double, 2, double> *candidates;
+        int **rows;
+        int *rowSizes;
+        int *rowTests;
+        HitsBuffer *buffers; // [nbThreads]
+    } ConflictGraphContext;
+
+    /*
+     * Look up conflicts of one candidate, concurrent jobs only
+     * read the candidates index
+     */
+    template <class Shape>
+    void conflictGraphJob (int job, int thread, void *ctx) {
+        ConflictGraphContext *context = (ConflictGraphContext*) ctx;
+        HitsBuffer *buffer = context->buffers + thread;
+        int nbHits;
+        int size;
+        int *row;
 
-    bool removeOverlapCallback (LabelPosition *lp, void *ctx) {
-        LabelPosition *lp2 = (LabelPosition *) ctx;
+        double amin[2];
+        double amax[2];
 
-        if (lp2->isInConflict (lp)) {
-            //std::cout << "   hit !" << std::endl;
-            lp->nbOverlap--;
-            lp2->nbOverlap--;
+        context->geom->getBoundingBox (job, amin, amax);
+
+        nbHits = context->candidates->Collect (amin, amax, &buffer->hits, &buffer->capacity);
+        if (buffer->idsCapacity < buffer->capacity) {
+            delete[] buffer->ids;
+            buffer->ids = new int[buffer->capacity];
+            buffer->idsCapacity = buffer->capacity;
         }
 
-        return true;
+        size = context->geom->conflicts<Shape> (job, buffer->hits, nbHits, buffer->ids);
+
+        row = new int[size];
+        memcpy (row, buffer->ids, sizeof (int) * size);
+        std::sort (row, row + size);
+
+        context->rows[job] = row;
+        context->rowSizes[job] = size;
+        context->rowTests[job] = nbHits;
+    }
+
+
+    void Problem::buildConflictGraph (int nbThreads) {
+        int i;
+        int total = 0;
+
+        ConflictGraphContext context;
+        context.geom = geom;
+        context.candidates = candidates;
+        context.rows = new int*[all_nblp];
+        context.rowSizes = new int[all_nblp];
+        context.rowTests = new int[all_nblp];
+        context.buffers = new HitsBuffer[nbThreads];
+        for (i = 0;i < nbThreads;i++) {
+            context.buffers[i].hits = NULL;
+            context.buffers[i].capacity = 0;
+            context.buffers[i].ids = NULL;
+            context.buffers[i].idsCapacity = 0;
+        }
+
+        // shape is chosen once, not for each pair of candidates
+        if (geom->allAxisAligned)
+            parallelRun (nbThreads, all_nblp, conflictGraphJob<AxisAlignedRect>, (void*) &context);
+        else
+            parallelRun (nbThreads, all_nblp, conflictGraphJob<RotatedRect>, (void*) &context);
+
+        for (i = 0;i < nbThreads;i++) {
+            delete[] context.buffers[i].hits;
+            delete[] context.buffers[i].ids;
+        }
+        delete[] context.buffers;
+
+        nbRTreeQueries += all_nblp;
+
+        if (conflictStart)
+            delete[] conflictStart;
+        if (conflictList)
+            delete[] conflictList;
+
+        conflictStart = new int[all_nblp+1];
+        for (i = 0;i < all_nblp;i++) {
+            conflictStart[i] = total;
+            labelpositions[i]->nbOverlap = context.rowSizes[i];
+            total += context.rowSizes[i];
+            nbConflictTests += context.rowTests[i];
+#ifdef _DEBUG_FULL_
+            std::cout << "Nb overlap for " << i << "/" << all_nblp - 1 << " : " << context.rowSizes[i] << std::endl;
+#endif
+        }
+        conflictStart[all_nblp] = total;
+
+        conflictList = new int[total];
+        for (i = 0;i < all_nblp;i++) {
+            memcpy (conflictList + conflictStart[i], context.rows[i], sizeof (int) * context.rowSizes[i]);
+            delete[] context.rows[i];
+        }
+
+        delete[] context.rows;
+        delete[] context.rowSizes;
+        delete[] context.rowTests;
+
+        // each overlap is seen from both candidates
+        nbOverlap = total / 2;
+    }
+
+
+    void Problem::compactConflictGraph (bool *removed) {
+        int i;
+        int k;
+        int start;
+        int end = 0;
+        int size = 0;
+
+        for (i = 0;i < all_nblp;i++) {
+            start = end;
+            end = conflictStart[i+1];
+            conflictStart[i] = size;
+            if (!removed[i]) {
+                for (k = start;k < end;k++) {
+                    if (!removed[conflictList[k]])
+                        conflictList[size++] = conflictList[k];
+                }
+            }
+        }
+        conflictStart[all_nblp] = size;
     }
 
 
@@ -170,17 +399,18 @@ namespace pal {
         int lpid;
 
         bool *ok = new bool[nblp];
+        bool *removed = new bool[nblp];
         bool run = true;
 
-        for (i = 0;i < nblp;i++)
+        for (i = 0;i < nblp;i++) {
             ok[i] = false;
+            removed[i] = false;
+        }
 
 
-        double amin[2];
-        double amax[2];
         LabelPosition *lp;
         LabelPosition *lp2;
-        int c;
+        int n;
 
 
         while (run) {
@@ -202,24 +432,15 @@ namespace pal {
                                 ok[lpid] = true;
                                 lp2 = labelpositions[lpid];
 
-                                amin[0] = DBL_MAX;
-                                amax[0] = -DBL_MAX;
-                                amin[1] = DBL_MAX;
-                                amax[1] = -DBL_MAX;
-                                for (c = 0;c < 4;c++) {
-                                    if (lp2->x[c] < amin[0])
-                                        amin[0] = lp2->x[c];
-                                    if (lp2->x[c] > amax[0])
-                                        amax[0] = lp2->x[c];
-                                    if (lp2->y[c] < amin[1])
-                                        amin[1] = lp2->y[c];
-                                    if (lp2->y[c] > amax[1])
-                                        amax[1] = lp2->y[c];
-                                }
-
                                 nbOverlap -= lp2->nbOverlap;
-                                candidates->Search (amin, amax, removeOverlapCallback, (void*) lp2);
-                                lp2->removeFromIndex (candidates);
+                                for (n = conflictStart[lpid];n < conflictStart[lpid+1];n++) {
+                                    if (!removed[conflictList[n]]) {
+                                        labelpositions[conflictList[n]]->nbOverlap--;
+                                        lp2->nbOverlap--;
+                                    }
+                                }
+                                removed[lpid] = true;
+                                geom->removeFromIndex (lpid, candidates);
                             }
 
                             //lp->removeFromIndex(candidates);
@@ -236,7 +457,70 @@ namespace pal {
 #ifdef _VERBOSE_
         std::cout << "problem reduce to " << nblp << " candidates which makes " << nbOverlap << " overlaps"  << std::endl;
 #endif
+        compactConflictGraph (removed);
+
         delete[] ok;
+        delete[] removed;
+    }
+
+
+    void Problem::decompose() {
+        int i;
+        int f;
+        int g;
+        int lp;
+        int n;
+        int head;
+        int size = 0;
+
+        if (componentStart)
+            delete[] componentStart;
+        if (componentFeats)
+            delete[] componentFeats;
+        if (featComponent)
+            delete[] featComponent;
+
+        featComponent = new int[nbft];
+        componentFeats = new int[nbft];
+        componentStart = new int[nbft+1];
+        nbComponents = 0;
+
+        for (i = 0;i < nbft;i++)
+            featComponent[i] = -1;
+
+        for (i = 0;i < nbft;i++) {
+            if (featComponent[i] == -1) {
+                componentStart[nbComponents] = size;
+                featComponent[i] = nbComponents;
+                componentFeats[size++] = i;
+
+                // breadth-first walk, componentFeats is the queue
+                for (head = componentStart[nbComponents];head < size;head++) {
+                    f = componentFeats[head];
+                    for (lp = featStartId[f];lp < featStartId[f] + featNbLp[f];lp++) {
+                        for (n = conflictStart[lp];n < conflictStart[lp+1];n++) {
+                            g = geom->feat[conflictList[n]];
+                            if (featComponent[g] == -1) {
+                                featComponent[g] = nbComponents;
+                                componentFeats[size++] = g;
+                            }
+                        }
+                    }
+                }
+
+                std::sort (componentFeats + componentStart[nbComponents], componentFeats + size);
+                nbComponents++;
+            }
+        }
+        componentStart[nbComponents] = size;
+
+#ifdef _VERBOSE_
+        int nbSingle = 0;
+        for (i = 0;i < nbComponents;i++)
+            if (componentStart[i+1] - componentStart[i] == 1)
+                nbSingle++;
+        std::cout << "problem splits into " << nbComponents << " components (" << nbSingle << " single features)" << std::endl;
+#endif
     }
 
     /**
@@ -253,81 +537,141 @@ namespace pal {
 
         sol = new Sol();
         sol->s = new int[nbft];
+        sol->cost = 0;
 
-        for (i = 0;i < nbft;i++)
+        if (featNbOverlap)
+            delete[] featNbOverlap;
+        featNbOverlap = new int[nbft];
+
+        for (i = 0;i < nbft;i++) {
             sol->s[i] = -1;
+            sol->cost += inactiveCost[i];
+            featNbOverlap[i] = 0;
+        }
 
-        sol->cost = nbft;
+        nbActive = 0;
+        nbSolOverlap = 0;
     }
 
 
+    void Problem::setLabel (int f, int label) {
+        int n;
+        int c;
+        int g;
+        int old = sol->s[f];
+        LabelPosition *lp;
 
+        if (old == label)
+            return;
 
-    typedef struct {
-        PriorityQueue *list;
-        LabelPosition *lp;
-        RTree <LabelPosition*, double, 2, double> *candidates;
-    } FalpContext;
+        if (old >= 0) {
+            geom->removeFromIndex (old, candidates_sol);
+            sol->s[f] = -1;
+
+            lp = labelpositions[old];
+            if (featNbOverlap[f] == 0)
+                nbActive--;
+
+            // each overlap costs both labels and the inactivity of both features
+            for (n = conflictStart[old];n < conflictStart[old+1];n++) {
+                c = conflictList[n];
+                g = geom->feat[c];
+                if (sol->s[g] == c) {
+                    sol->cost -= inactiveCost[f] + lp->cost + inactiveCost[g] + labelpositions[c]->cost;
+                    if (--featNbOverlap[g] == 0)
+                        nbActive++;
+                    nbSolOverlap--;
+                }
+            }
+            featNbOverlap[f] = 0;
+            sol->cost += inactiveCost[f] - lp->cost;
+        }
 
-    bool falpCallback2 (LabelPosition *lp, void *  ctx) {
-        LabelPosition *lp2 = ( (FalpContext*) ctx)->lp;
-        PriorityQueue *list = ( (FalpContext*) ctx)->list;
+        if (label >= 0) {
+            lp = labelpositions[label];
+            sol->cost += lp->cost - inactiveCost[f];
+
+            for (n = conflictStart[label];n < conflictStart[label+1];n++) {
+                c = conflictList[n];
+                g = geom->feat[c];
+                if (sol->s[g] == c) {
+                    sol->cost += inactiveCost[f] + lp->cost + inactiveCost[g] + labelpositions[c]->cost;
+                    if (featNbOverlap[g]++ == 0)
+                        nbActive--;
+                    featNbOverlap[f]++;
+                    nbSolOverlap++;
+                }
+            }
+            if (featNbOverlap[f] == 0)
+                nbActive++;
 
-        if (lp->id != lp2->id && list->isIn (lp->id) && lp->isInConflict (lp2)) {
-            list->decreaseKey (lp->id);
+            sol->s[f] = label;
+            geom->insertIntoIndex (label, candidates_sol);
         }
-        return true;
     }
 
 
-    void ignoreLabel (LabelPosition *lp, PriorityQueue *list, RTree <LabelPosition*, double, 2, double> *candidates) {
 
 
-        FalpContext *context = new FalpContext();
-        context->candidates = NULL;
-        context->list = list;
-        double amin[2];
-        double amax[2];
-        int c;
+    void Problem::ignoreLabel (int label, PriorityQueue *list) {
+        int n;
 
-        if (list->isIn (lp->id)) {
-            list->remove (lp->id);
+        if (list->isIn (label)) {
+            list->remove (label);
 
-            amin[0] = DBL_MAX;
-            amax[0] = -DBL_MAX;
-            amin[1] = DBL_MAX;
-            amax[1] = -DBL_MAX;
-            for (c = 0;c < 4;c++) {
-                if (lp->x[c] < amin[0])
-                    amin[0] = lp->x[c];
-                if (lp->x[c] > amax[0])
-                    amax[0] = lp->x[c];
-                if (lp->y[c] < amin[1])
-                    amin[1] = lp->y[c];
-                if (lp->y[c] > amax[1])
-                    amax[1] = lp->y[c];
+            for (n = conflictStart[label];n < conflictStart[label+1];n++) {
+                if (list->isIn (conflictList[n]))
+                    list->decreaseKey (conflictList[n]);
             }
-            context->lp = lp;
-            candidates->Search (amin, amax, falpCallback2, context);
         }
+    }
+
+
+
+    void Problem::retainLabel (int label, PriorityQueue *list) {
+        int i;
+        int n;
+
+        LabelPosition *lp = labelpositions[label];
+
+        if (lp->id != label) {
+            std::cout << "Error: " << lp->id << " <--> " << label << std::endl;
+        }
+
+
+        setLabel (lp->probFeat, label);
+
+#ifdef _DEBUG_FULL_
+        std::cout << "sol->s[" << lp->probFeat << "] :" << label << std::endl;
+#endif
+
+        for (i = featStartId[lp->probFeat];i < featStartId[lp->probFeat] + featNbLp[lp->probFeat];i++) {
+            ignoreLabel (i, list);
 
-        delete context;
+        }
+
+        // candidates in conflict with the retained one are ignored
+        for (n = conflictStart[label];n < conflictStart[label+1];n++)
+            ignoreLabel (conflictList[n], list);
     }
 
 
-    bool falpCallback1 (LabelPosition *lp, void *  ctx) {
-        LabelPosition *lp2 = ( (FalpContext*) ctx)->lp;
-        PriorityQueue *list = ( (FalpContext*) ctx)->list;
-        RTree <LabelPosition*, double, 2, double> *candidates = ( (FalpContext*) ctx)->candidates;
+    bool Problem::isWarm (int c) {
+        int k;
+        int f;
+
+        if (!warmSol)
+            return false;
 
-        if (lp2->isInConflict (lp)) {
-            ignoreLabel (lp, list, candidates);
+        for (k = componentStart[c];k < componentStart[c+1];k++) {
+            f = componentFeats[k];
+            if (warmSol[f] == -2 || sol->s[f] != warmSol[f])
+                return false;
         }
         return true;
     }
 
 
-
     /* Better initial solution
      * Step one FALP (Yamamoto, Camara, Lorena 2005)
      */
@@ -338,77 +682,54 @@ namespace pal {
 
         int i, j;
         int label;
+        double priority;
+        unsigned int random = startSeed * 2654435761u;
         PriorityQueue *list;
 
         init_sol_empty();
 
         list = new PriorityQueue (nblp, all_nblp, true);
 
-        double amin[2];
-        double amax[2];
-        int c;
-
-        FalpContext *context = new FalpContext();
-        context->candidates = candidates;
-        context->list = list;
+        int n;
 
         LabelPosition *lp;
 
-        for (i = 0;i < nbft;i++)
+        for (i = 0;i < nbft;i++) {
+            if (featNbLp[i] > 0 && componentStart[featComponent[i] + 1] - componentStart[featComponent[i]] == 1) {
+                // feature without any conflict : fixed to its best candidate
+                setLabel (i, featStartId[i]);
+                continue;
+            }
             for (j = 0;j < featNbLp[i];j++) {
                 label = featStartId[i] + j;
-                list->insert (label, (double) labelpositions[label]->nbOverlap);
+                priority = (double) labelpositions[label]->nbOverlap;
+                // other starts break ties at random
+                if (startSeed)
+                    priority += (nextRandom (&random) & 0xffff) / 65536.0;
+                list->insert (label, priority);
             }
+        }
 
-        while (list->getSize() > 0) { // O (log size)
-            label = list->getBest();   // O (log size)
-
-
-            lp = labelpositions[label];
-
-            if (lp->id != label) {
-                std::cout << "Error: " << lp->id << " <--> " << label << std::endl;
-            }
-
-
-            sol->s[lp->probFeat] = label;
-
-#ifdef _DEBUG_FULL_
-            std::cout << "sol->s[" << lp->probFeat << "] :" << label << std::endl;
-#endif
-
-            for (i = featStartId[lp->probFeat];i < featStartId[lp->probFeat] + featNbLp[lp->probFeat];i++) {
-                ignoreLabel (labelpositions[i], list, candidates);
-
+        // previous labels first, as long as they are not in conflict
+        if (warmSol) {
+            for (i = 0;i < nbft;i++) {
+                if (warmSol[i] >= 0 && list->isIn (warmSol[i]))
+                    retainLabel (warmSol[i], list);
             }
+        }
 
+        while (list->getSize() > 0) { // O (log size)
+            label = list->getBest();   // O (log size)
 
-            amin[0] = DBL_MAX;
-            amax[0] = -DBL_MAX;
-            amin[1] = DBL_MAX;
-            amax[1] = -DBL_MAX;
-            for (c = 0;c < 4;c++) {
-                if (lp->x[c] < amin[0])
-                    amin[0] = lp->x[c];
-                if (lp->x[c] > amax[0])
-                    amax[0] = lp->x[c];
-                if (lp->y[c] < amin[1])
-                    amin[1] = lp->y[c];
-                if (lp->y[c] > amax[1])
-                    amax[1] = lp->y[c];
-            }
-            context->lp = lp;
-            candidates->Search (amin, amax, falpCallback1, (void*) context);
-            candidates_sol->Insert (amin, amax, lp);
+            retainLabel (label, list);
         }
 
-        delete context;
-
 
 
 
         if (displayAll) {
             int nbOverlap;
+            int nbOv;
             int start_p;
             LabelPosition* retainedLabel = NULL;
             int p;
@@ -419,39 +740,243 @@ namespace pal {
                     start_p = featStartId[i];
                     for (p = 0;p < featNbLp[i];p++) {
                         lp = labelpositions[start_p+p];
-                        lp->nbOverlap = 0;
-                        amin[0] = DBL_MAX;
-                        amax[0] = -DBL_MAX;
-                        amin[1] = DBL_MAX;
-                        amax[1] = -DBL_MAX;
-                        for (c = 0;c < 4;c++) {
-                            if (lp->x[c] < amin[0])
-                                amin[0] = lp->x[c];
-                            if (lp->x[c] > amax[0])
-                                amax[0] = lp->x[c];
-                            if (lp->y[c] < amin[1])
-                                amin[1] = lp->y[c];
-                            if (lp->y[c] > amax[1])
-                                amax[1] = lp->y[c];
-                        }
-
+                        nbOv = 0;
 
-                        candidates_sol->Search (amin, amax, countOverlapCallback, lp);
+                        // count conflicts with active labels (candidates are shared by the starts)
+                        for (n = conflictStart[lp->id];n < conflictStart[lp->id+1];n++) {
+                            if (sol->s[geom->feat[conflictList[n]]] == conflictList[n])
+                                nbOv++;
+                        }
 
-                        if (lp->nbOverlap < nbOverlap) {
+                        if (nbOv < nbOverlap) {
                             retainedLabel = lp;
-                            nbOverlap = lp->nbOverlap;
+                            nbOverlap = nbOv;
                         }
                     }
-                    sol->s[i] = retainedLabel->id;
+                    setLabel (i, retainedLabel->id);
+                }
+            }
+        }
+
+        delete list;
+    }
+
+    typedef struct _popmusiccontext {
+        Problem *problem;
+        SearchMethod searchMethod;
+        SubPart **parts;
+        int nbParts;
+        SubPartState **states;
+        bool *ok;       // [nbft] ok[i] is true when sub part seeded by i can't be improved
+        bool *busy;     // [nbft] features of the sub parts being optimized
+        int seed;       // position of the last selected sub part
+        int nbRunning;  // # sub parts being optimized
+        int popit;
+        SimpleMutex *mutex;
+        SimpleCondition *released; // a running sub part released its features
+        int *round;     // [nbParts] deterministic mode : sub parts of the current round
+        double *deltas; // [nbParts] and their improvement
+    } PopmusicContext;
+
+    /*
+     * Optimize sub parts until every seed is ok. Each running sub part owns
+     * its features (border included), so sub parts optimized at the same
+     * time never share a feature and their improvements can be merged as
+     * they are.
+     */
+    void popmusicJob (int job, int /*thread*/, void *ctx) {
+        PopmusicContext *context = (PopmusicContext*) ctx;
+        Problem *prob = context->problem;
+        SubPartState *state = context->states[job];
+        Sol *sol = prob->sol;
+        SubPart *current;
+
+        int i;
+        int j;
+        int k;
+        int seed;
+        double delta = 0.0;
+
+        context->mutex->lock();
+        while (true) {
+            /* find the next seed not ok whose features are not in use */
+            seed = -1;
+            for (j = 1;j <= context->nbParts && seed == -1;j++) {
+                i = (context->seed + j) % context->nbParts;
+                current = context->parts[i];
+                if (!context->ok[current->seed]) {
+                    for (k = 0;k < current->subSize && !context->busy[current->sub[k]];k++);
+                    if (k == current->subSize)
+                        seed = i;
+                }
+            }
+
+            if (seed == -1) {
+                if (context->nbRunning == 0)
+                    break; // everything is OK :-)
+
+                // wait for a running sub part to release its features
+                context->released->wait (context->mutex);
+                continue;
+            }
+
+            // time budget spent : the solution is the best found so far
+            if (prob->deadlineReached()) {
+                prob->budgetHit = true;
+                break;
+            }
+
+            context->seed = seed;
+            current = context->parts[seed];
+
+            // update sub part solution
+            for (i = 0;i < current->subSize;i++) {
+                context->busy[current->sub[i]] = true;
+                current->sol[i] = sol->s[current->sub[i]];
+            }
+            context->nbRunning++;
+            context->mutex->unlock();
+
+            delta = prob->optimizeSubPart (context->searchMethod, current, state);
+
+            context->mutex->lock();
+
+            context->popit++;
+            context->nbRunning--;
+            for (i = 0;i < current->subSize;i++)
+                context->busy[current->sub[i]] = false;
+            context->released->broadcast();
+
+            // search of the sub part cut by the time budget
+            if (prob->deadlineReached())
+                prob->budgetHit = true;
+
+            if (delta > EPSILON) {
+                /* Update solution */
+#ifdef _DEBUG_FULL_
+                std::cout << "Update solution from subpart, current cost:" << std::endl;
+                prob->solution_cost ();
+                std::cout << "Delta > EPSILON: update solution" << std::endl;
+                std::cout << "after modif cost:" << std::endl;
+                prob->solution_cost ();
+#endif
+                prob->commitSubPart (current, context->ok);
+            } else {// not improved
+#ifdef _DEBUG_FULL_
+                std::cout << "subpart not improved" << std::endl;
+#endif
+                context->ok[current->seed] = true;
+            }
+        }
+        context->mutex->unlock();
+    }
+
+    /*
+     * Deterministic mode : optimize one sub part of the round. Sub parts of
+     * a round do not share any feature and start from the solution of the
+     * previous round, whatever the thread running them.
+     */
+    void popmusicRoundJob (int job, int thread, void *ctx) {
+        PopmusicContext *context = (PopmusicContext*) ctx;
+        SubPart *current = context->parts[context->round[job]];
+
+        context->deltas[job] = context->problem->optimizeSubPart (context->searchMethod, current, context->states[thread]);
+    }
 
-                    retainedLabel->insertIntoIndex (candidates_sol);
+    /*
+     * Deterministic mode : rounds of disjoint sub parts, selected in their
+     * order, are optimized concurrently then merged in the same order, so
+     * that the solution does not depend on the number of threads.
+     */
+    void Problem::popmusicRounds (PopmusicContext *context, int nbThreads) {
+        int i;
+        int j;
+        int k;
+        int nbRound;
+        SubPart *current;
 
+        while (true) {
+            nbRound = 0;
+            for (j = 1;j <= context->nbParts;j++) {
+                i = (context->seed + j) % context->nbParts;
+                current = context->parts[i];
+                if (!context->ok[current->seed]) {
+                    for (k = 0;k < current->subSize && !context->busy[current->sub[k]];k++);
+                    if (k == current->subSize) {
+                        for (k = 0;k < current->subSize;k++) {
+                            context->busy[current->sub[k]] = true;
+                            current->sol[k] = sol->s[current->sub[k]];
+                        }
+                        context->round[nbRound++] = i;
+                    }
                 }
             }
+
+            if (nbRound == 0)
+                break; // everything is OK :-)
+
+            // time budget spent : the solution is the best found so far
+            if (deadlineReached()) {
+                budgetHit = true;
+                break;
+            }
+
+            parallelRun (nbThreads, nbRound, popmusicRoundJob, (void*) context);
+
+            for (j = 0;j < nbRound;j++) {
+                current = context->parts[context->round[j]];
+                for (k = 0;k < current->subSize;k++)
+                    context->busy[current->sub[k]] = false;
+
+                if (context->deltas[j] > EPSILON)
+                    commitSubPart (current, context->ok);
+                else
+                    context->ok[current->seed] = true;
+            }
+
+            context->seed = context->round[nbRound-1];
+            context->popit += nbRound;
         }
+    }
 
-        delete list;
+    double Problem::optimizeSubPart (SearchMethod searchMethod, SubPart *part, SubPartState *state) {
+        int i;
+
+        state->candidates_subsol->RemoveAll();
+
+        for (i = 0;i < part->subSize;i++) {
+            if (part->sol[i] != -1) {
+                geom->insertIntoIndex (part->sol[i], state->candidates_subsol);
+            }
+        }
+
+        switch (searchMethod) {
+            //case branch_and_bound :
+            //delta = current->branch_and_bound_search();
+            //   break;
+
+        case POPMUSIC_TABU :
+            return popmusic_tabu (part, state);
+        case POPMUSIC_TABU_CHAIN :
+            return popmusic_tabu_chain (part, state);
+        case POPMUSIC_CHAIN :
+            return popmusic_chain (part, state);
+        default:
+            return 0.0;
+        }
+    }
+
+    void Problem::commitSubPart (SubPart *part, bool *ok) {
+        int i;
+
+        for (i = 0;i < part->borderSize;i++) {
+            ok[part->sub[i]] = false;
+        }
+
+        for (i = part->borderSize;i < part->subSize;i++) {
+            setLabel (part->sub[i], part->sol[i]);
+            ok[part->sub[i]] = false;
+        }
     }
 
 //#define _DEBUG_
@@ -461,18 +986,19 @@ namespace pal {
             return;
 
         int i;
-        int seed;
         bool *ok = new bool[nbft];
 
         int r = pal->popmusic_r;
 
         SearchMethod searchMethod = pal->searchMethod;
 
-        candidates_subsol = new RTree<LabelPosition*, double, 2, double>();
-
-        double delta = 0.0;
-
-        int it = 0;
+        if (searchMethod != POPMUSIC_TABU && searchMethod != POPMUSIC_TABU_CHAIN && searchMethod != POPMUSIC_CHAIN) {
+#ifdef _VERBOSE_
+            std::cerr << "Unknown search method..." << std::endl;
+#endif
+            delete[] ok;
+            return;
+        }
 
 #ifdef _VERBOSE_
         clock_t start_time = clock();
@@ -481,138 +1007,151 @@ namespace pal {
         clock_t search_time;
 #endif
 
-        SubPart *current = NULL;
+        double phaseStart = wallTime();
+        double initSolStart;
 
         int subPartTotalSize = 0;
 
-        labelPositionCost = new double[all_nblp];
-        nbOlap = new int[all_nblp];
+        // features without conflicts don't need any sub part
+        int nbParts = 0;
+        for (i = 0;i < nbft;i++) {
+            if (componentStart[featComponent[i] + 1] - componentStart[featComponent[i]] > 1)
+                nbParts++;
+        }
 
-        featWrap = new int[nbft];
-        memset (featWrap, -1, sizeof (int) *nbft);
+        // starts of a multi-start search run on one thread each
+        int nbThreads = (model ? 1 : pal->nbThreads);
+        if (nbThreads > nbParts)
+            nbThreads = nbParts;
+        if (nbThreads < 1)
+            nbThreads = 1;
+
+        // working data for each thread
+        SubPartState **states = arena->allocArray<SubPartState*> (nbThreads);
+        for (i = 0;i < nbThreads;i++) {
+            states[i] = new (arena) SubPartState();
+            states[i]->featWrap = arena->allocArray<int> (nbft);
+            memset (states[i]->featWrap, -1, sizeof (int) *nbft);
+            states[i]->labelPositionCost = arena->allocArray<double> (all_nblp);
+            states[i]->nbOlap = arena->allocArray<int> (all_nblp);
+            states[i]->candidates_subsol = new RTree<LabelPosition*, double, 2, double>();
+        }
 
-        SubPart ** parts = new SubPart*[nbft];
+        SubPart ** parts = arena->allocArray<SubPart*> (nbParts);
         int *isIn = new int[nbft];
 
         memset (isIn, 0, sizeof (int) *nbft);
 
 
+        nbParts = 0;
         for (i = 0;i < nbft;i++) {
-            parts[i] = subPart (r, i, isIn);
-            subPartTotalSize += parts[i]->subSize;
-            ok[i] = false;
+            if (componentStart[featComponent[i] + 1] - componentStart[featComponent[i]] > 1) {
+                parts[nbParts] = subPart (r, i, isIn);
+                subPartTotalSize += parts[nbParts]->subSize;
+                nbParts++;
+                ok[i] = false;
+            } else {
+                ok[i] = true;
+            }
         }
         delete[] isIn;
-        sort ( (void**) parts, nbft, borderSizeInc);
+        sort ( (void**) parts, nbParts, borderSizeInc);
+
+        // other starts visit the sub parts in another order
+        if (startSeed) {
+            unsigned int random = startSeed * 2654435761u;
+            SubPart *part;
+            int j;
+            for (i = nbParts - 1;i > 0;i--) {
+                j = nextRandom (&random) % (i + 1);
+                part = parts[i];
+                parts[i] = parts[j];
+                parts[j] = part;
+            }
+        }
         //sort ((void**)parts, nbft, borderSizeDec);
 
 #ifdef _VERBOSE_
         create_part_time = clock();
-        std::cout << "   SubPart (averagesize: " << subPartTotalSize / nbft <<  ") creation: " << (double) (create_part_time - start_time) / (double) CLOCKS_PER_SEC << std::endl;
+        std::cout << "   SubPart (averagesize: " << (nbParts > 0 ? subPartTotalSize / nbParts : 0) <<  ") creation: " << (double) (create_part_time - start_time) / (double) CLOCKS_PER_SEC << std::endl;
 #endif
 
+        initSolStart = wallTime();
         init_sol_falp();
 
+        // clusters labelled as previously are not optimized again
+        if (warmSol) {
+            for (i = 0;i < nbft;i++) {
+                if (!ok[i] && isWarm (featComponent[i]))
+                    ok[i] = true;
+            }
+        }
+        initSolTime = wallTime() - initSolStart;
+
+        // small clusters are solved exactly
+        bool *exact = new bool[nbComponents];
+        exactSearch (pal->exactSearchSize, exact);
+        for (i = 0;i < nbft;i++) {
+            if (!ok[i] && exact[featComponent[i]])
+                ok[i] = true;
+        }
+        delete[] exact;
+
 #ifdef _VERBOSE_
         init_sol_time = clock();
         std::cout << "   Compute initial solution: " << (double) (init_sol_time - create_part_time) / (double) CLOCKS_PER_SEC;
 #endif
 
+#ifdef _DEBUG_
         solution_cost();
+#endif
 
 #ifdef _VERBOSE_
         std::cerr << "\t" << sol->cost << "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
         std::cout << " (solution cost: " << sol->cost << ", nbDisplayed: " << nbActive  << "(" << (double) nbActive / (double) nbft << "%)" << std::endl;
 #endif
 
+        PopmusicContext context;
+        context.problem = this;
+        context.searchMethod = searchMethod;
+        context.parts = parts;
+        context.nbParts = nbParts;
+        context.states = states;
+        context.ok = ok;
+        context.busy = new bool[nbft];
+        context.seed = 0;
+        context.nbRunning = 0;
+        context.popit = 0;
+        context.mutex = new SimpleMutex();
+        context.released = new SimpleCondition();
+        context.round = NULL;
+        context.deltas = NULL;
 
-        int popit = 0;
-
-        seed = 0;
-        while (true) {
-            it++;
-            /* find the next seed not ok */
-            for (i = (seed + 1) % nbft;ok[i] && i != seed;i = (i + 1) % nbft);
+        for (i = 0;i < nbft;i++)
+            context.busy[i] = false;
 
-            if (i == seed && ok[seed]) {
-                current = NULL; // everything is OK :-)
-                break;
+        if (nbParts > 0) {
+            if (pal->deterministic) {
+                context.round = new int[nbParts];
+                context.deltas = new double[nbParts];
+                popmusicRounds (&context, nbThreads);
             } else {
-                seed = i;
-                current = parts[seed];
+                parallelRun (nbThreads, nbThreads, popmusicJob, (void*) &context);
             }
+        }
 
-            // update sub part solution
-            candidates_subsol->RemoveAll();
-
-            for (i = 0;i < current->subSize;i++) {
-                current->sol[i] = sol->s[current->sub[i]];
-                if (current->sol[i] != -1) {
-                    labelpositions[current->sol[i]]->insertIntoIndex (candidates_subsol);
-                }
-            }
-
-
-
-            switch (searchMethod) {
-                //case branch_and_bound :
-                //delta = current->branch_and_bound_search();
-                //   break;
-
-            case POPMUSIC_TABU :
-                delta = popmusic_tabu (current);
-                break;
-            case POPMUSIC_TABU_CHAIN :
-                delta = popmusic_tabu_chain (current);
-                break;
-            case POPMUSIC_CHAIN :
-                delta = popmusic_chain (current);
-                break;
-            default:
-#ifdef _VERBOSE_
-                std::cerr << "Unknown search method..." << std::endl;
-#endif
-                return;
-            }
-
-            popit++;
-
-            if (delta > EPSILON) {
-                /* Update solution */
-#ifdef _DEBUG_FULL_
-                std::cout << "Update solution from subpart, current cost:" << std::endl;
-                solution_cost ();
-                std::cout << "Delta > EPSILON: update solution" << std::endl;
-                std::cout << "after modif cost:" << std::endl;
-                solution_cost ();
-#endif
-                for (i = 0;i < current->borderSize;i++) {
-                    ok[current->sub[i]] = false;
-                }
-
-                for (i = current->borderSize;i < current->subSize;i++) {
-
-                    if (sol->s[current->sub[i]] != -1) {
-                        labelpositions[sol->s[current->sub[i]]]->removeFromIndex (candidates_sol);
-                    }
-
-                    sol->s[current->sub[i]] = current->sol[i];
-
-                    if (current->sol[i] != -1) {
-                        labelpositions[current->sol[i]]->insertIntoIndex (candidates_sol);
-                    }
+        delete[] context.busy;
+        delete[] context.round;
+        delete[] context.deltas;
+        delete context.mutex;
+        delete context.released;
 
-                    ok[current->sub[i]] = false;
-                }
-            } else {// not improved
-#ifdef _DEBUG_FULL_
-                std::cout << "subpart not improved" << std::endl;
+#ifdef _DEBUG_
+        solution_cost();
 #endif
-                ok[seed] = true;
-            }
-        }
 
-        solution_cost();
+        nbSearchIterations = context.popit;
+        searchTime = wallTime() - phaseStart - initSolTime;
 #ifdef _VERBOSE_
         search_time = clock();
         std::cout << "   Improved solution: " << (double) (search_time - start_time) / (double) CLOCKS_PER_SEC << " (solution cost: " << sol->cost << ", nbDisplayed: " << nbActive << " (" << (double) nbActive / (double) nbft << ")" << std::endl;
@@ -625,19 +1164,13 @@ namespace pal {
         else if (searchMethod == POPMUSIC_CHAIN)
             std::cerr << "\tpop_chain\t";
 
-        std::cerr << r << "\t" << popit << "\t" << (create_part_time - start_time) / (double) CLOCKS_PER_SEC <<   "\t" << (init_sol_time - create_part_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - init_sol_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - start_time) / (double) CLOCKS_PER_SEC <<   "\t" << sol->cost << "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
+        std::cerr << r << "\t" << context.popit << "\t" << (create_part_time - start_time) / (double) CLOCKS_PER_SEC <<   "\t" << (init_sol_time - create_part_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - init_sol_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - start_time) / (double) CLOCKS_PER_SEC <<   "\t" << sol->cost << "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
 
 #endif
 
-        delete[] labelPositionCost;
-        delete[] nbOlap;
-
-        for (i = 0;i < nbft;i++) {
-            delete[] parts[i]->sub;
-            delete[] parts[i]->sol;
-            delete parts[i];
-        }
-        delete[] parts;
+        // sub parts and states are left in the arena
+        for (i = 0;i < nbThreads;i++)
+            delete states[i]->candidates_subsol;
 
         delete[] ok;
 
@@ -645,27 +1178,6 @@ namespace pal {
     }
 #undef _DEBUG_
 
-    typedef struct {
-        LinkedList<int> *queue;
-        int *isIn;
-        LabelPosition *lp;
-    } SubPartContext;
-
-    bool subPartCallback (LabelPosition *lp, void *ctx) {
-        int lpid = lp->id;
-        int *isIn = ( (SubPartContext*) ctx)->isIn;
-        LinkedList<int> *queue = ( (SubPartContext*) ctx)->queue;
-
-
-        int id = lp->probFeat;
-        if (!isIn[id] && lp->isInConflict ( ( (SubPartContext*) ctx)->lp)) {
-            queue->push_back (id);
-            isIn[id] = 1;
-        }
-
-        return true;
-    }
-
     /* Select a sub part, expected size of r, from seed */
     SubPart * Problem::subPart (int r, int featseed, int *isIn) {
         LinkedList<int> *queue = new LinkedList<int> (intCompare);
@@ -677,23 +1189,15 @@ namespace pal {
         register int featS;
         register int p;
         int i;
-        int c;
+        int k;
+        int ftid;
 
         int n = 0;
         int nb = 0;
 
-        double amin[2];
-        double amax[2];
-
-        SubPartContext context;
-        context.queue = queue;
-        context.isIn = isIn;
-
         queue->push_back (featseed);
         isIn[featseed] = 1;
 
-        LabelPosition *lp;
-
         while (ri->size() < r && queue->size() > 0) {
             id = queue->pop_front();
             ri->push_back (id);
@@ -702,30 +1206,20 @@ namespace pal {
             p = featNbLp[id];
 
             for (i = featS;i < featS + p;i++) {  // foreach candidat of feature 'id'
-                lp = labelpositions[i];
-                amin[0] = DBL_MAX;
-                amax[0] = -DBL_MAX;
-                amin[1] = DBL_MAX;
-                amax[1] = -DBL_MAX;
-                for (c = 0;c < 4;c++) {
-                    if (lp->x[c] < amin[0])
-                        amin[0] = lp->x[c];
-                    if (lp->x[c] > amax[0])
-                        amax[0] = lp->x[c];
-                    if (lp->y[c] < amin[1])
-                        amin[1] = lp->y[c];
-                    if (lp->y[c] > amax[1])
-                        amax[1] = lp->y[c];
+                for (k = conflictStart[i];k < conflictStart[i+1];k++) {
+                    ftid = geom->feat[conflictList[k]];
+                    if (!isIn[ftid]) {
+                        queue->push_back (ftid);
+                        isIn[ftid] = 1;
+                    }
                 }
-                context.lp = lp;
-                candidates->Search (amin, amax, subPartCallback, (void*) &context);
             }
         }
 
         nb = queue->size();
         n = ri->size();
 
-        sub = new int[n+nb];
+        sub = arena->allocArray<int> (n + nb);
 
         i = 0;
 
@@ -744,13 +1238,13 @@ namespace pal {
         delete queue;
         delete ri;
 
-        SubPart *subPart = new SubPart();
+        SubPart *subPart = new (arena) SubPart();
 
         subPart->probSize = n;
         subPart->borderSize = nb;
         subPart->subSize = n + nb;
         subPart->sub = sub;
-        subPart->sol = new int [subPart->subSize];
+        subPart->sol = arena->allocArray<int> (subPart->subSize);
         subPart->seed = featseed;
         return subPart;
     }
@@ -758,19 +1252,16 @@ namespace pal {
 
     /** From SubPart.cpp ***/
 
-    double Problem::compute_feature_cost (SubPart *part, int feat_id, int label_id, int *nbOverlap) {
+    double Problem::compute_feature_cost (SubPart *part, int feat_id, int label_id, int *nbOverlap, SubPartState *state) {
+        int *featWrap = state->featWrap;
+
         double cost;
         *nbOverlap = 0;
 
-        int c;
-
-        CountContext context;
-        context.inactiveCost = inactiveCost;
-        context.nbOv = nbOverlap;
-        context.cost = &cost;
+        int n;
+        int k;
+        int f;
 
-        double amin[2];
-        double amax[2];
         LabelPosition *lp;
 
         cost = 0.0;
@@ -778,22 +1269,14 @@ namespace pal {
         if (label_id >= 0) { // is the feature displayed ?
             lp = labelpositions[label_id];
 
-            amin[0] = DBL_MAX;
-            amax[0] = -DBL_MAX;
-            amin[1] = DBL_MAX;
-            amax[1] = -DBL_MAX;
-            for (c = 0;c < 4;c++) {
-                if (lp->x[c] < amin[0])
-                    amin[0] = lp->x[c];
-                if (lp->x[c] > amax[0])
-                    amax[0] = lp->x[c];
-                if (lp->y[c] < amin[1])
-                    amin[1] = lp->y[c];
-                if (lp->y[c] > amax[1])
-                    amax[1] = lp->y[c];
-            }
-            context.lp = lp;
-            candidates_subsol->Search (amin, amax, countFullOverlapCallback, (void*) &context);
+            // conflicts with labels active in the sub part solution
+            for (n = conflictStart[label_id];n < conflictStart[label_id+1];n++) {
+                k = conflictList[n];
+                if ( (f = featWrap[geom->feat[k]]) >= 0 && part->sol[f] == k) {
+                    (*nbOverlap) ++;
+                    cost += inactiveCost[geom->feat[k]] + labelpositions[k]->cost;
+                }
+            }
 
             cost += lp->cost;
         } else {
@@ -805,7 +1288,7 @@ namespace pal {
 
     }
 
-    double Problem::compute_subsolution_cost (SubPart *part, int *s, int *nbOverlap) {
+    double Problem::compute_subsolution_cost (SubPart *part, int *s, int *nbOverlap, SubPartState *state) {
         int i;
         double cost = 0.0;
         int nbO = 0;
@@ -813,7 +1296,7 @@ namespace pal {
         *nbOverlap = 0;
 
         for (i = 0;i < part->subSize;i++) {
-            cost += compute_feature_cost (part, i, s[i], &nbO);
+            cost += compute_feature_cost (part, i, s[i], &nbO, state);
             *nbOverlap += nbO;
         }
 
@@ -886,23 +1369,24 @@ namespace pal {
         int borderSize;
     } UpdateContext;
 
+    /*
+     * lp is in conflict with ctx->lp (neighbours in the conflict graph)
+     */
     bool updateCandidatesCost (LabelPosition *lp, void *context) {
         UpdateContext *ctx = (UpdateContext*) context;
 
-        if (ctx->lp->isInConflict (lp)) {
-            ctx->labelPositionCost[lp->id] += ctx->diff_cost;
-            if (ctx->diff_cost > 0)
-                ctx->nbOlap[lp->id]++;
-            else
-                ctx->nbOlap[lp->id]--;
-
-            int feat_id = ctx->featWrap[ctx->lp->probFeat];
-            int feat_id2;
-            if (feat_id >= 0 && ctx->sol[feat_id] == lp->id) { // this label is in use
-                if ( (feat_id2 = feat_id - ctx->borderSize) >= 0) {
-                    ctx->candidates[feat_id2]->cost += ctx->diff_cost;
-                    ctx->candidates[feat_id2]->nbOverlap--;
-                }
+        ctx->labelPositionCost[lp->id] += ctx->diff_cost;
+        if (ctx->diff_cost > 0)
+            ctx->nbOlap[lp->id]++;
+        else
+            ctx->nbOlap[lp->id]--;
+
+        int feat_id = ctx->featWrap[ctx->lp->probFeat];
+        int feat_id2;
+        if (feat_id >= 0 && ctx->sol[feat_id] == lp->id) { // this label is in use
+            if ( (feat_id2 = feat_id - ctx->borderSize) >= 0) {
+                ctx->candidates[feat_id2]->cost += ctx->diff_cost;
+                ctx->candidates[feat_id2]->nbOverlap--;
             }
         }
         return true;
@@ -911,7 +1395,7 @@ namespace pal {
 
 
 
-    double Problem::popmusic_tabu (SubPart *part) {
+    double Problem::popmusic_tabu (SubPart *part, SubPartState *state) {
 #ifdef _DEBUG_FULL_
         std::cout << "Subpart: Tabu Search" << std::endl;
 #endif
@@ -922,6 +1406,11 @@ namespace pal {
         int *sub = part->sub;
         int *sol = part->sol;
 
+        int *featWrap = state->featWrap;
+        double *labelPositionCost = state->labelPositionCost;
+        int *nbOlap = state->nbOlap;
+        RTree<LabelPosition*, double, 2, double> *candidates_subsol = state->candidates_subsol;
+
         Triple **candidateList = new Triple*[probSize];
         Triple **candidateListUnsorted = new Triple*[probSize];
 
@@ -998,7 +1487,7 @@ namespace pal {
                 it = j + lp;
                 //std::cerr << "it = " << j << " + " << lp << std::endl;
                 // std::cerr << "it/nblp:" << it << "/" << all_nblp << std::endl;
-                labelPositionCost[it] = compute_feature_cost (part, i, it, & (nbOlap[it]));
+                labelPositionCost[it] = compute_feature_cost (part, i, it, & (nbOlap[it]), state);
                 //std::cerr << "nbOlap[" << it << "] : " << nbOlap[it] << std::endl;
             }
         }
@@ -1044,7 +1533,7 @@ namespace pal {
         // START TABU
 
         it = 0;
-        while (it < stop_it && best_cost >= EPSILON) {
+        while (it < stop_it && best_cost >= EPSILON && !deadlineReached()) {
 #ifdef _DEBUG_FULL_
             std::cout << "  ITERATION : " << it << " stop: " << stop_it << std::endl;
 #endif
@@ -1148,7 +1637,7 @@ namespace pal {
                 candidateList[candidateId]->label_id = choosed_label;
 
                 if (old_label != -1)
-                    labelpositions[old_label]->removeFromIndex (candidates_subsol);
+                    geom->removeFromIndex (old_label, candidates_subsol);
 
                 /* re-compute all labelpositioncost that overlap with old an new label */
                 double local_inactive = inactiveCost[sub[choosed_feat]];
@@ -1163,9 +1652,7 @@ namespace pal {
 
                 cur_cost += delta_min;
 
-                double amin[2];
-                double amax[2];
-                int c;
+                int n;
                 LabelPosition *lp;
 
                 UpdateContext context;
@@ -1178,55 +1665,23 @@ namespace pal {
                 context.borderSize = borderSize;
 
                 if (old_label >= 0) {
-                    lp = labelpositions[old_label];
-
-
-                    amin[0] = DBL_MAX;
-                    amax[0] = -DBL_MAX;
-                    amin[1] = DBL_MAX;
-                    amax[1] = -DBL_MAX;
-                    for (c = 0;c < 4;c++) {
-                        if (lp->x[c] < amin[0])
-                            amin[0] = lp->x[c];
-                        if (lp->x[c] > amax[0])
-                            amax[0] = lp->x[c];
-                        if (lp->y[c] < amin[1])
-                            amin[1] = lp->y[c];
-                        if (lp->y[c] > amax[1])
-                            amax[1] = lp->y[c];
-                    }
                     context.diff_cost = -local_inactive - labelpositions[old_label]->cost;
                     context.lp = labelpositions[old_label];
 
-                    candidates->Search (amin, amax, updateCandidatesCost, &context);
+                    for (n = conflictStart[old_label];n < conflictStart[old_label+1];n++)
+                        updateCandidatesCost (labelpositions[conflictList[n]], &context);
                 }
 
                 if (choosed_label >= 0) {
                     lp = labelpositions[choosed_label];
 
-
-                    amin[0] = DBL_MAX;
-                    amax[0] = -DBL_MAX;
-                    amin[1] = DBL_MAX;
-                    amax[1] = -DBL_MAX;
-                    for (c = 0;c < 4;c++) {
-                        if (lp->x[c] < amin[0])
-                            amin[0] = lp->x[c];
-                        if (lp->x[c] > amax[0])
-                            amax[0] = lp->x[c];
-                        if (lp->y[c] < amin[1])
-                            amin[1] = lp->y[c];
-                        if (lp->y[c] > amax[1])
-                            amax[1] = lp->y[c];
-                    }
-
                     context.diff_cost = local_inactive + labelpositions[choosed_label]->cost;
-                    context.lp = labelpositions[choosed_label];
+                    context.lp = lp;
 
+                    for (n = conflictStart[choosed_label];n < conflictStart[choosed_label+1];n++)
+                        updateCandidatesCost (labelpositions[conflictList[n]], &context);
 
-                    candidates->Search (amin, amax, updateCandidatesCost, &context);
-
-                    lp->insertIntoIndex (candidates_subsol);
+                    geom->insertIntoIndex (choosed_label, candidates_subsol);
                 }
 
                 sort ( (void**) candidateList, probSize, decreaseCost);
@@ -1246,7 +1701,7 @@ namespace pal {
 #ifdef _DEBUG_FULL_
             std::cout << "cost : " << cur_cost << std::endl;
             int nbover;
-            std::cout << "computed cost: " << compute_subsolution_cost (part, sol, &nbover) << std::endl;
+            std::cout << "computed cost: " << compute_subsolution_cost (part, sol, &nbover, state) << std::endl;
             std::cout << "best_cost: " << best_cost << std::endl << std::endl;
 #endif
             it++;
@@ -1287,6 +1742,9 @@ namespace pal {
     } ChainContext;
 
 
+    /*
+     * lp is an active label in conflict with ctx->lp
+     */
     bool chainCallback (LabelPosition *lp, void *context) {
         ChainContext *ctx = (ChainContext*) context;
 
@@ -1306,58 +1764,53 @@ namespace pal {
 
 #ifdef _DEBUG_FULL_
         std::cout << "ejChCallBack: " << lp->id << "<->" << ctx->lp->id << std::endl;
+        std::cout << "    Conflictual..." << std::endl;
 #endif
-        if (lp->isInConflict (ctx->lp)) {
-#ifdef _DEBUG_FULL_
-            std::cout << "ejChCallBack: " << lp->id << "<->" << ctx->lp->id << std::endl;
-            std::cout << "    Conflictual..." << std::endl;
-#endif
-            int feat, rfeat;
-            bool sub = ctx->featWrap;
+        int feat, rfeat;
+        bool sub = ctx->featWrap;
 
-            feat = lp->probFeat;
-            if (sub) {
-                rfeat = feat;
-                feat = ctx->featWrap[feat];
-            } else
-                rfeat = feat;
+        feat = lp->probFeat;
+        if (sub) {
+            rfeat = feat;
+            feat = ctx->featWrap[feat];
+        } else
+            rfeat = feat;
 
 #ifdef _DEBUG_FULL_
-            std::cout << "    feat: " << feat << std::endl;
-            std::cout << "    sol: " << ctx->tmpsol[feat] << "/" << lp->id << std::endl;
-            std::cout << "    border:" << ctx->borderSize << std::endl;
+        std::cout << "    feat: " << feat << std::endl;
+        std::cout << "    sol: " << ctx->tmpsol[feat] << "/" << lp->id << std::endl;
+        std::cout << "    border:" << ctx->borderSize << std::endl;
 #endif
-            if (feat >= 0 && ctx->tmpsol[feat] == lp->id) {
-                if (sub && feat < ctx->borderSize) {
+        if (feat >= 0 && ctx->tmpsol[feat] == lp->id) {
+            if (sub && feat < ctx->borderSize) {
 #ifdef _DEBUG_FULL_
-                    std::cout << "    Cannot touch border (throw) !" << std::endl;
+                std::cout << "    Cannot touch border (throw) !" << std::endl;
 #endif
-                    throw - 2;
-                }
+                throw - 2;
             }
+        }
 
-            // is there any cycles ?
-            Cell<ElemTrans*> *cur = ctx->currentChain->getFirst();
+        // is there any cycles ?
+        Cell<ElemTrans*> *cur = ctx->currentChain->getFirst();
 
-            while (cur) {
-                if (cur->item->feat == feat) {
+        while (cur) {
+            if (cur->item->feat == feat) {
 #ifdef _DEBUG_FULL_
-                    std::cout << "Cycle into chain (throw) !" << std::endl;
+                std::cout << "Cycle into chain (throw) !" << std::endl;
 #endif
-                    throw - 1;
-                }
-                cur = cur->next;
+                throw - 1;
             }
+            cur = cur->next;
+        }
 
-            if (!ctx->conflicts->isIn (feat)) {
-                ctx->conflicts->push_back (feat);
-                *ctx->delta_tmp += lp->cost + ctx->inactiveCost[rfeat];
-            }
+        if (!ctx->conflicts->isIn (feat)) {
+            ctx->conflicts->push_back (feat);
+            *ctx->delta_tmp += lp->cost + ctx->inactiveCost[rfeat];
         }
         return true;
     }
 
-    inline Chain *Problem::chain (SubPart *part, int seed) {
+    inline Chain *Problem::chain (SubPart *part, int seed, SubPartState *state) {
 
         int i;
         int j;
@@ -1369,6 +1822,10 @@ namespace pal {
         int subSize    = part->subSize;
         int *sub       = part->sub;
         int *sol       = part->sol;
+
+        int *featWrap = state->featWrap;
+        RTree<LabelPosition*, double, 2, double> *candidates_subsol = state->candidates_subsol;
+
         register int subseed;
 
         double delta;
@@ -1391,9 +1848,9 @@ namespace pal {
         memcpy (tmpsol, sol, sizeof (int) *subSize);
 
         LabelPosition *lp;
-        double amin[2];
-        double amax[2];
-        int c;
+        int n;
+        int k;
+        int f;
 
         ChainContext context;
         context.featWrap = featWrap;
@@ -1434,27 +1891,17 @@ namespace pal {
                             lp = labelpositions[lid];
 
                             // evaluate conflicts graph in solution after moving seed's label
-                            amin[0] = DBL_MAX;
-                            amax[0] = -DBL_MAX;
-                            amin[1] = DBL_MAX;
-                            amax[1] = -DBL_MAX;
-                            for (c = 0;c < 4;c++) {
-                                if (lp->x[c] < amin[0])
-                                    amin[0] = lp->x[c];
-                                if (lp->x[c] > amax[0])
-                                    amax[0] = lp->x[c];
-                                if (lp->y[c] < amin[1])
-                                    amin[1] = lp->y[c];
-                                if (lp->y[c] > amax[1])
-                                    amax[1] = lp->y[c];
-                            }
                             context.lp = lp;
 
                             if (conflicts->size() != 0)
                                 std::cerr << "Conflicts not empty !!" << std::endl;
 
                             // search ative conflicts and count them
-                            candidates_subsol->Search (amin, amax, chainCallback, (void*) &context);
+                            for (n = conflictStart[lid];n < conflictStart[lid+1];n++) {
+                                k = conflictList[n];
+                                if ( (f = featWrap[geom->feat[k]]) >= 0 && tmpsol[f] == k)
+                                    chainCallback (labelpositions[k], (void*) &context);
+                            }
 
 #ifdef _DEBUG_FULL_
                             std::cout << "Conflicts:" <<  conflicts->size() << std::endl;
@@ -1595,11 +2042,11 @@ namespace pal {
                 currentChain->push_back (et);
 
                 if (et->old_label != -1) {
-                    labelpositions[et->old_label]->removeFromIndex (candidates_subsol);
+                    geom->removeFromIndex (et->old_label, candidates_subsol);
                 }
 
                 if (et->new_label != -1) {
-                    labelpositions[et->new_label]->insertIntoIndex (candidates_subsol);
+                    geom->insertIntoIndex (et->new_label, candidates_subsol);
                 }
 
                 tmpsol[seed] = retainedLabel;
@@ -1612,11 +2059,11 @@ namespace pal {
             ElemTrans* et =  currentChain->pop_front();
 
             if (et->new_label != -1) {
-                labelpositions[et->new_label]->removeFromIndex (candidates_subsol);
+                geom->removeFromIndex (et->new_label, candidates_subsol);
             }
 
             if (et->old_label != -1) {
-                labelpositions[et->old_label]->insertIntoIndex (candidates_subsol);
+                geom->insertIntoIndex (et->old_label, candidates_subsol);
             }
 
             delete et;
@@ -1631,7 +2078,7 @@ namespace pal {
     }
 
 
-    inline Chain *Problem::chain (int seed) {
+    inline Chain *Problem::chain (int seed, int *tmpsol) {
 
         int i;
         int j;
@@ -1654,13 +2101,9 @@ namespace pal {
         LinkedList<ElemTrans*> *currentChain = new LinkedList<ElemTrans*> (ptrETCompare);
         LinkedList<int> *conflicts = new LinkedList<int> (intCompare);
 
-        int *tmpsol = new int[nbft];
-        memcpy (tmpsol, sol->s, sizeof (int) *nbft);
-
         LabelPosition *lp;
-        double amin[2];
-        double amax[2];
-        int c;
+        int n;
+        int k;
 
         ChainContext context;
         context.featWrap = NULL;
@@ -1697,25 +2140,15 @@ namespace pal {
                             lp = labelpositions[lid];
 
                             // evaluate conflicts graph in solution after moving seed's label
-                            amin[0] = DBL_MAX;
-                            amax[0] = -DBL_MAX;
-                            amin[1] = DBL_MAX;
-                            amax[1] = -DBL_MAX;
-                            for (c = 0;c < 4;c++) {
-                                if (lp->x[c] < amin[0])
-                                    amin[0] = lp->x[c];
-                                if (lp->x[c] > amax[0])
-                                    amax[0] = lp->x[c];
-                                if (lp->y[c] < amin[1])
-                                    amin[1] = lp->y[c];
-                                if (lp->y[c] > amax[1])
-                                    amax[1] = lp->y[c];
-                            }
                             context.lp = lp;
                             if (conflicts->size() != 0)
                                 std::cerr << "Conflicts not empty" << std::endl;
 
-                            candidates_sol->Search (amin, amax, chainCallback, (void*) &context);
+                            for (n = conflictStart[lid];n < conflictStart[lid+1];n++) {
+                                k = conflictList[n];
+                                if (tmpsol[geom->feat[k]] == k)
+                                    chainCallback (labelpositions[k], (void*) &context);
+                            }
 
                             // no conflict -> end of chain
                             if (conflicts->size() == 0) {
@@ -1852,15 +2285,6 @@ namespace pal {
                 et->new_label = retainedLabel;
                 currentChain->push_back (et);
 
-                if (et->old_label != -1) {
-                    labelpositions[et->old_label]->removeFromIndex (candidates_sol);
-                }
-
-                if (et->new_label != -1) {
-                    labelpositions[et->new_label]->insertIntoIndex (candidates_sol);
-                }
-
-
                 tmpsol[seed] = retainedLabel;
                 delta += labelpositions[retainedLabel]->cost;
                 seed = next_seed;
@@ -1868,22 +2292,14 @@ namespace pal {
         }
 
 
+        // restore caller's solution
         while (currentChain->size() > 0) {
             ElemTrans* et =  currentChain->pop_front();
-
-            if (et->new_label != -1) {
-                labelpositions[et->new_label]->removeFromIndex (candidates_sol);
-            }
-
-            if (et->old_label != -1) {
-                labelpositions[et->old_label]->insertIntoIndex (candidates_sol);
-            }
-
+            tmpsol[et->feat] = et->old_label;
             delete et;
         }
         delete currentChain;
 
-        delete[] tmpsol;
         delete conflicts;
 
 
@@ -1894,7 +2310,7 @@ namespace pal {
     /**
      *  POPMUSIC,  chain
      */
-    double Problem::popmusic_chain (SubPart *part) {
+    double Problem::popmusic_chain (SubPart *part, SubPartState *state) {
         int i;
         //int j;
 
@@ -1904,6 +2320,9 @@ namespace pal {
         int *sub       = part->sub;
         int *sol       = part->sol;
 
+        int *featWrap = state->featWrap;
+        RTree<LabelPosition*, double, 2, double> *candidates_subsol = state->candidates_subsol;
+
         int *best_sol = new int[subSize];
 
         for (i = 0;i < subSize;i++) {
@@ -1938,7 +2357,7 @@ namespace pal {
         int tenure = pal->tenure;
 
         for (i = 0;i < subSize;i++) {
-            cur_cost += compute_feature_cost (part, i, sol[i], &featOv);
+            cur_cost += compute_feature_cost (part, i, sol[i], &featOv, state);
             nbOverlap += featOv;
         }
 
@@ -1960,10 +2379,10 @@ namespace pal {
         for (i = 0;i < probSize;i++)
             tabu_list[i+borderSize] = -1; // others aren't
 
-        while (it < stop_it) {
+        while (it < stop_it && !deadlineReached()) {
             seed = (it % probSize) + borderSize;
 
-            if ( (current_chain = chain (part, seed))) {
+            if ( (current_chain = chain (part, seed, state))) {
 
                 /* we accept a modification only if the seed is not tabu or
                  * if the nmodification will generate a new best solution */
@@ -1974,12 +2393,12 @@ namespace pal {
                         lid = current_chain->label[i];
 
                         if (sol[fid] >= 0) {
-                            labelpositions[sol[fid]]->removeFromIndex (candidates_subsol);
+                            geom->removeFromIndex (sol[fid], candidates_subsol);
                         }
                         sol[fid] = lid;
 
                         if (sol[fid] >= 0) {
-                            labelpositions[lid]->insertIntoIndex (candidates_subsol);
+                            geom->insertIntoIndex (lid, candidates_subsol);
                         }
 
                         tabu_list[fid] = it + tenure;
@@ -1989,7 +2408,7 @@ namespace pal {
 #ifdef _DEBUG_FULL_
                     std::cout << "cur->cost: " << cur_cost << std::endl;
                     int kov;
-                    std::cout << "computed cost: " << compute_subsolution_cost (part, sol, &kov) << std::endl << std::endl;
+                    std::cout << "computed cost: " << compute_subsolution_cost (part, sol, &kov, state) << std::endl << std::endl;
 #endif
                     /* check if new solution is a new best solution */
                     if (best_cost - cur_cost > EPSILON) {
@@ -2042,7 +2461,7 @@ namespace pal {
      * POPMUSIC, Tabu search with  chain'
      *
      */
-    double Problem::popmusic_tabu_chain (SubPart *part) {
+    double Problem::popmusic_tabu_chain (SubPart *part, SubPartState *state) {
         int i;
 
         int probSize   = part->probSize;
@@ -2051,6 +2470,9 @@ namespace pal {
         int *sub       = part->sub;
         int *sol       = part->sol;
 
+        int *featWrap = state->featWrap;
+        RTree<LabelPosition*, double, 2, double> *candidates_subsol = state->candidates_subsol;
+
         int *best_sol = new int[subSize];
 
         for (i = 0;i < subSize;i++) {
@@ -2097,7 +2519,7 @@ namespace pal {
         LinkedList<int> *conflicts = new LinkedList<int> (intCompare);
 
         for (i = 0;i < subSize;i++) {
-            cur_cost += compute_feature_cost (part, i, sol[i], &featOv);
+            cur_cost += compute_feature_cost (part, i, sol[i], &featOv, state);
             nbOverlap += featOv;
         }
 
@@ -2140,10 +2562,10 @@ namespace pal {
 #ifdef _DEBUG_FULL_
         int nbOv;
         std::cout << std::endl << "Initial solution cost " << cur_cost << std::endl;
-        std::cout << "Computed: " << compute_subsolution_cost (part, sol, &nbOv);
+        std::cout << "Computed: " << compute_subsolution_cost (part, sol, &nbOv, state);
         std::cout << "NbOverlap: " << nbOv << std::endl;
 #endif
-        while (it < stop_it) {
+        while (it < stop_it && !deadlineReached()) {
             retainedChain = NULL;
             bestChain = DBL_MAX;
             validCandidateId = -1;
@@ -2158,7 +2580,7 @@ namespace pal {
 #ifdef _DEBUG_FULL_
                 std::cout << "new candidates:" << std::endl;
 #endif
-                current_chain = chain (part, seed);
+                current_chain = chain (part, seed, state);
 
 #ifdef _DEBUG_FULL_
                 std::cout << "get chain:" << current_chain << std::endl;
@@ -2214,12 +2636,12 @@ namespace pal {
 #endif
 
                     if (sol[fid] >= 0)
-                        labelpositions[sol[fid]]->removeFromIndex (candidates_subsol);
+                        geom->removeFromIndex (sol[fid], candidates_subsol);
 
                     sol[fid] = lid;
 
                     if (lid >= 0)
-                        labelpositions[lid]->insertIntoIndex (candidates_subsol);
+                        geom->insertIntoIndex (lid, candidates_subsol);
 
                     tabu_list[fid] = it + tenure;
 #ifdef _DEBUG_FULL_
@@ -2247,7 +2669,7 @@ namespace pal {
 
                 //std::cout << "new solution cost:" << cur_cost << std::endl;
                 //int nbOv;
-                //std::cout << "computed solution cost:" << compute_subsolution_cost (part, sol, &nbOv) << std::endl;
+                //std::cout << "computed solution cost:" << compute_subsolution_cost (part, sol, &nbOv, state) << std::endl;
                 //std::cout << "Overlap: " << nbOv << std::endl;
 
                 delete_chain (retainedChain);
@@ -2360,18 +2782,18 @@ namespace pal {
         int *wrap;
     } NokContext;
 
+    /*
+     * lp is in conflict with context's lp
+     */
     bool nokCallback (LabelPosition *lp, void *context) {
 
-        LabelPosition *lp2 = ( (NokContext*) context)->lp;
         bool *ok = ( (NokContext*) context)->ok;
         int *wrap = ( (NokContext*) context)->wrap;
 
-        if (lp2->isInConflict (lp)) {
-            if (wrap) {
-                ok[wrap[lp->probFeat]] = false;
-            } else {
-                ok[lp->probFeat] = false;
-            }
+        if (wrap) {
+            ok[wrap[lp->probFeat]] = false;
+        } else {
+            ok[lp->probFeat] = false;
         }
 
         return true;
@@ -2521,88 +2943,83 @@ namespace pal {
     }
 #endif
 
-    void Problem::chain_search() {
+    typedef struct {
+        Problem *problem;
+        int *components;  // components to solve, largest first
+        bool *ok;
+        int **tmpsols;    // [nbThreads] working solution of each thread
+        int popit;
+        SimpleMutex *mutex;
+    } ChainSearchContext;
+
+    /*
+     * Improve the solution of one connected component with ejection chains.
+     * Components do not share any feature, only the merge into the global
+     * solution is serialized.
+     */
+    void chainComponentJob (int job, int thread, void *ctx) {
+        ChainSearchContext *context = (ChainSearchContext*) ctx;
+        Problem *prob = context->problem;
+        Sol *sol = prob->sol;
+        bool *ok = context->ok;
+        int *tmpsol = context->tmpsols[thread];
 
-        if (nbft == 0)
-            return;
+        int component = context->components[job];
+        int *feats = prob->componentFeats + prob->componentStart[component];
+        int size = prob->componentStart[component+1] - prob->componentStart[component];
 
         int i;
-
+        int k;
         int seed;
-        bool *ok = new bool[nbft];
-
         int fid;
         int lid;
-
-#ifdef _VERBOSE_
-        clock_t start_time = clock();
-        clock_t init_sol_time;
-        clock_t search_time;
-#endif
-
+        int n;
+        int iter = 0;
         int popit = 0;
 
-        int c;
-        double amin[2];
-        double amax[2];
-
-        NokContext context;
-
-        context.ok = ok;
-        context.wrap = NULL;
-
         Chain *retainedChain;
 
-        featWrap = NULL;
-
-        for (i = 0;i < nbft;i++) {
-            ok[i] = false;
-        }
-
-        //initialization();
-        init_sol_falp();
-
-        //check_solution();
-
-#ifdef _VERBOSE_
-        std::cout << "   Compute initial solution: " << (double) ( (init_sol_time = clock()) - start_time) / (double) CLOCKS_PER_SEC;
-#endif
-
-        solution_cost();
-
+        NokContext nokContext;
+        nokContext.ok = ok;
+        nokContext.wrap = NULL;
 
-#ifdef _VERBOSE_
-        std::cerr << "\t" << sol->cost << "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
-        std::cout << " (solution cost: " << sol->cost << ", nbDisplayed: " << nbActive  << "(" << double (nbActive) / nbft << "%)" << std::endl;
-#endif
-        int iter = 0;
+        for (i = 0;i < size;i++)
+            tmpsol[feats[i]] = sol->s[feats[i]];
 
         while (true) {
 
-            //check_solution();
-
-            for (seed = (iter + 1) % nbft;
-                    ok[seed] && seed != iter;
-                    seed = (seed + 1) % nbft);
+            for (k = (iter + 1) % size;
+                    ok[feats[k]] && k != iter;
+                    k = (k + 1) % size);
 
             // All seeds are OK
-            if (seed == iter) {
+            if (k == iter) {
                 break;
             }
 
-            iter = (iter + 1) % nbft;
+            // time budget spent, keep the improvements done so far
+            if (prob->deadlineReached()) {
+                context->mutex->lock();
+                prob->budgetHit = true;
+                context->mutex->unlock();
+                break;
+            }
+
+            iter = (iter + 1) % size;
+            seed = feats[k];
 
 #ifdef _DEBUG_FULL_
             std::cout << "Seed for it " << popit << " is " << seed << std::endl;
 #endif
 
-            retainedChain = chain (seed);
+            retainedChain = prob->chain (seed, tmpsol);
 
             if (retainedChain && retainedChain->delta < - EPSILON) {
 #ifdef _DEBUG_FULL_
                 std::cout << "chain's degree & delta : " << retainedChain->degree << "     " << retainedChain->delta << std::endl;
 #endif
                 // apply modification
+                context->mutex->lock();
                 for (i = 0;i < retainedChain->degree;i++) {
                     fid = retainedChain->feat[i];
                     lid = retainedChain->label[i];
@@ -2610,49 +3027,29 @@ namespace pal {
                     std::cout << "   " << i << " :" << fid << " " << lid << std::endl;
                     std::cout << "    sol->s[fid]: " << sol->s[fid] << " <=> " << lid << std::endl;
                     if (sol->s[fid] == -1 || lid == -1)
-                        std::cout << "feat inactive :" << inactiveCost[fid] << std::endl;
+                        std::cout << "feat inactive :" << prob->inactiveCost[fid] << std::endl;
                     if (sol->s[fid] >= 0)
-                        std::cout << "old cost : " << labelpositions[sol->s[fid]]->cost << std::endl;
+                        std::cout << "old cost : " << prob->labelpositions[sol->s[fid]]->cost << std::endl;
                     if (lid >= 0)
-                        std::cout << "new cost : " << labelpositions[lid]->cost << std::endl;
+                        std::cout << "new cost : " << prob->labelpositions[lid]->cost << std::endl;
 #endif
 
                     if (sol->s[fid] >= 0) {
-                        LabelPosition *old = labelpositions[sol->s[fid]];
-                        old->removeFromIndex (candidates_sol);
-
+                        LabelPosition *old = prob->labelpositions[sol->s[fid]];
 
-                        amin[0] = DBL_MAX;
-                        amax[0] = -DBL_MAX;
-                        amin[1] = DBL_MAX;
-                        amax[1] = -DBL_MAX;
-                        for (c = 0;c < 4;c++) {
-                            if (old->x[c] < amin[0])
-                                amin[0] = old->x[c];
-                            if (old->x[c] > amax[0])
-                                amax[0] = old->x[c];
-                            if (old->y[c] < amin[1])
-                                amin[1] = old->y[c];
-                            if (old->y[c] > amax[1])
-                                amax[1] = old->y[c];
-                        }
-
-                        context.lp = old;
-                        candidates->Search (amin, amax, nokCallback, &context);
+                        nokContext.lp = old;
+                        for (n = prob->conflictStart[old->id];n < prob->conflictStart[old->id+1];n++)
+                            nokCallback (prob->labelpositions[prob->conflictList[n]], &nokContext);
                     }
 
-                    sol->s[fid] = lid;
-
-                    if (sol->s[fid] >= 0) {
-                        labelpositions[lid]->insertIntoIndex (candidates_sol);
-                    }
+                    prob->setLabel (fid, lid);
+                    tmpsol[fid] = lid;
 
                     ok[fid] = false;
                 }
-                sol->cost += retainedChain->delta;
+                context->mutex->unlock();
 #ifdef _DEBUG_FULL_
                 std::cout << "Expected cost: " << sol->cost << std::endl;
-                solution_cost ();
                 std::cout << "chain iteration " << popit << ": " << sol->cost << ", " << retainedChain->delta << ", " << retainedChain->degree << std::endl;
 #endif
             } else {
@@ -2664,18 +3061,131 @@ namespace pal {
             popit++;
         }
 
+        context->mutex->lock();
+        context->popit += popit;
+        context->mutex->unlock();
+    }
+
+    typedef struct {
+        int id;
+        int size;
+    } ComponentSize;
+
+    inline bool decreaseComponentSize (void *l, void *r) {
+        return ( (ComponentSize*) l)->size < ( (ComponentSize*) r)->size;
+    }
+
+    void Problem::chain_search() {
+
+        if (nbft == 0)
+            return;
+
+        int i;
+        int c;
+        int nbComp = 0;
+
+        bool *ok = new bool[nbft];
+
+#ifdef _VERBOSE_
+        clock_t start_time = clock();
+        clock_t init_sol_time;
+        clock_t search_time;
+#endif
+
+        for (i = 0;i < nbft;i++) {
+            ok[i] = false;
+        }
+
+        double phaseStart = wallTime();
+
+        //initialization();
+        init_sol_falp();
+
+        initSolTime = wallTime() - phaseStart;
+        phaseStart = wallTime();
+
+        //check_solution();
+
+#ifdef _VERBOSE_
+        std::cout << "   Compute initial solution: " << (double) ( (init_sol_time = clock()) - start_time) / (double) CLOCKS_PER_SEC;
+#endif
+
+#ifdef _DEBUG_
+        solution_cost();
+#endif
+
+
+#ifdef _VERBOSE_
+        std::cerr << "\t" << sol->cost << "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
+        std::cout << " (solution cost: " << sol->cost << ", nbDisplayed: " << nbActive  << "(" << double (nbActive) / nbft << "%)" << std::endl;
+#endif
+
+        // small clusters are solved exactly, all of them with BRANCH_AND_BOUND
+        bool *exact = new bool[nbComponents];
+        exactSearch (pal->searchMethod == BRANCH_AND_BOUND ? nbft : pal->exactSearchSize, exact);
+
+        // single features are already solved, as clusters labelled as
+        // previously and solved ones, largest components first
+        ComponentSize **sizes = new ComponentSize*[nbComponents];
+        for (c = 0;c < nbComponents;c++) {
+            if (componentStart[c+1] - componentStart[c] > 1 && !isWarm (c) && !exact[c]) {
+                sizes[nbComp] = new ComponentSize();
+                sizes[nbComp]->id = c;
+                sizes[nbComp]->size = componentStart[c+1] - componentStart[c];
+                nbComp++;
+            }
+        }
+        sort ( (void**) sizes, nbComp, decreaseComponentSize);
+        delete[] exact;
+
+        // starts of a multi-start search run on one thread each
+        int nbThreads = (model ? 1 : pal->nbThreads);
+        if (nbThreads > nbComp)
+            nbThreads = nbComp;
+        if (nbThreads < 1)
+            nbThreads = 1;
+
+        ChainSearchContext context;
+        context.problem = this;
+        context.components = new int[nbComp];
+        context.ok = ok;
+        context.tmpsols = new int*[nbThreads];
+        context.popit = 0;
+        context.mutex = new SimpleMutex();
+
+        for (c = 0;c < nbComp;c++) {
+            context.components[c] = sizes[c]->id;
+            delete sizes[c];
+        }
+        delete[] sizes;
+
+        for (i = 0;i < nbThreads;i++)
+            context.tmpsols[i] = new int[nbft];
+
+        parallelRun (nbThreads, nbComp, chainComponentJob, (void*) &context);
+
+        for (i = 0;i < nbThreads;i++)
+            delete[] context.tmpsols[i];
+        delete[] context.tmpsols;
+        delete[] context.components;
+        delete context.mutex;
+
 #ifdef _DEBUG_FULL_
         std::cout << "Cur_cost:  " << sol->cost << std::endl;
-        sol->cost = 0;
 #endif
 
+#ifdef _DEBUG_
         solution_cost();
+#endif
+
+        nbSearchIterations = context.popit;
+        searchTime = wallTime() - phaseStart;
 
 #ifdef _VERBOSE_
         std::cout << "   Improved solution: " << (double) ( (search_time = clock()) - start_time) / (double) CLOCKS_PER_SEC << " (solution cost: " << sol->cost << ", nbDisplayed: " << nbActive << " (" << (double) nbActive / (double) nbft << "%)" << std::endl;
 
 
-        std::cerr << "\tna\tchain" << "\tna\t" << popit << "\tna\t" << (init_sol_time - start_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - init_sol_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - start_time) / (double) CLOCKS_PER_SEC << "\t" << sol->cost <<   "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
+        std::cerr << "\tna\tchain" << "\tna\t" << context.popit << "\tna\t" << (init_sol_time - start_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - init_sol_time) / (double) CLOCKS_PER_SEC << "\t" << (search_time - start_time) / (double) CLOCKS_PER_SEC << "\t" << sol->cost <<   "\t" << nbActive << "\t" << (double) nbActive / (double) nbft;
 #endif
 
         delete[] ok;
@@ -2683,6 +3193,377 @@ namespace pal {
         return;
     }
 
+    typedef struct {
+        Problem *problem;
+        int *components;  // components to solve
+        int **pos;        // [nbThreads] index of each feature in its component
+        int **cur;        // [nbThreads] label assigned to each feature
+        int *result;      // [nbft] best labels found
+        bool *improved;   // [nbComponents]
+        bool *solved;     // [nbComponents] the best labels are optimal
+        bool *cut;        // [nbComponents] the search was stopped by the deadline
+        long maxNodes;    // # nodes explored per component before giving up
+    } ExactSearchContext;
+
+    /*
+     * Branch and bound over the labels of one component. Each feature gets
+     * its candidates by increasing cost then hidden. The overlaps of a
+     * candidate with the labels already assigned are kept up to date, so
+     * that a feature left costs at least its best option, and the feature
+     * left with the fewest candidates free of overlaps is assigned next. A
+     * branch is cut as soon as its cost plus these lower bounds reaches the
+     * best solution, which is the current one at start.
+     */
+    void exactComponentJob (int job, int thread, void *ctx) {
+        ExactSearchContext *context = (ExactSearchContext*) ctx;
+        Problem *prob = context->problem;
+        int *pos = context->pos[thread];
+        int *cur = context->cur[thread];
+
+        int component = context->components[job];
+        int *feats = prob->componentFeats + prob->componentStart[component];
+        int size = prob->componentStart[component+1] - prob->componentStart[component];
+
+        int i;
+        int k;
+        int n;
+        int c;
+        int f;
+        int g;
+        int label;
+        int depth;
+        int nbFree;
+        int minFree;
+        int next;
+        long nbNodes = 0;
+        long maxNodes = context->maxNodes;
+        double cost;
+        double bound;
+        double featBound;
+        double candCost;
+        double bestCost;
+        double initialCost;
+        LabelPosition *lp;
+
+        int *order = new int[size];     // feature assigned at each depth
+        int *depthOf = new int[size];   // depth of each feature, size while unassigned
+        int *choice = new int[size];
+        int *first = new int[size+1];   // first candidate of each feature in extra
+        double *costs = new double[size+1];
+
+        for (i = 0;i < size;i++) {
+            pos[feats[i]] = i;
+            depthOf[i] = size;
+        }
+
+        first[0] = 0;
+        for (i = 0;i < size;i++)
+            first[i+1] = first[i] + prob->featNbLp[feats[i]];
+
+        // cost of the overlaps of each candidate with the labels assigned
+        double *extra = new double[first[size]];
+        for (i = 0;i < first[size];i++)
+            extra[i] = 0.0;
+
+        initialCost = 0.0;
+        for (i = 0;i < size;i++) {
+            f = feats[i];
+            label = prob->sol->s[f];
+            context->result[f] = label;
+            if (label == -1) {
+                initialCost += prob->inactiveCost[f];
+                continue;
+            }
+            lp = prob->labelpositions[label];
+            initialCost += lp->cost;
+            for (k = prob->conflictStart[label];k < prob->conflictStart[label+1];k++) {
+                c = prob->conflictList[k];
+                g = prob->geom->feat[c];
+                if (pos[g] < i && prob->sol->s[g] == c)
+                    initialCost += prob->inactiveCost[f] + lp->cost + prob->inactiveCost[g] + prob->labelpositions[c]->cost;
+            }
+        }
+        bestCost = initialCost;
+
+        depth = 0;
+        costs[0] = 0.0;
+        choice[0] = -1;
+        order[0] = 0;
+        depthOf[0] = 0;
+        cur[feats[0]] = -1;
+        context->solved[component] = true;
+        context->cut[component] = false;
+
+        while (depth >= 0) {
+            f = feats[order[depth]];
+
+            // withdraw the previous option
+            label = cur[f];
+            if (label >= 0) {
+                lp = prob->labelpositions[label];
+                for (n = prob->conflictStart[label];n < prob->conflictStart[label+1];n++) {
+                    c = prob->conflictList[n];
+                    g = prob->geom->feat[c];
+                    if (depthOf[pos[g]] > depth)
+                        extra[first[pos[g]] + c - prob->featStartId[g]] -= prob->inactiveCost[f] + lp->cost + prob->inactiveCost[g] + prob->labelpositions[c]->cost;
+                }
+                cur[f] = -1;
+            }
+
+            // next option : candidates then hidden
+            k = ++choice[depth];
+            if (k > prob->featNbLp[f] || (k == prob->featNbLp[f] && prob->displayAll)) {
+                depthOf[order[depth]] = size;
+                depth--;
+                continue;
+            }
+
+            if (k < prob->featNbLp[f]) {
+                label = prob->featStartId[f] + k;
+                lp = prob->labelpositions[label];
+                cost = costs[depth] + lp->cost + extra[first[order[depth]] + k];
+                if (cost >= bestCost - EPSILON)
+                    continue;
+
+                for (n = prob->conflictStart[label];n < prob->conflictStart[label+1];n++) {
+                    c = prob->conflictList[n];
+                    g = prob->geom->feat[c];
+                    if (depthOf[pos[g]] > depth)
+                        extra[first[pos[g]] + c - prob->featStartId[g]] += prob->inactiveCost[f] + lp->cost + prob->inactiveCost[g] + prob->labelpositions[c]->cost;
+                }
+                cur[f] = label;
+            } else {
+                cost = costs[depth] + prob->inactiveCost[f];
+            }
+
+            // lower bound of the features left, the most constrained one is next
+            bound = cost;
+            next = -1;
+            minFree = INT_MAX;
+            for (i = 0;i < size && bound < bestCost - EPSILON;i++) {
+                if (depthOf[i] < size)
+                    continue;
+                g = feats[i];
+                featBound = (prob->displayAll ? DBL_MAX : prob->inactiveCost[g]);
+                nbFree = 0;
+                for (n = 0;n < prob->featNbLp[g];n++) {
+                    if (extra[first[i] + n] == 0.0)
+                        nbFree++;
+                    candCost = prob->labelpositions[prob->featStartId[g] + n]->cost + extra[first[i] + n];
+                    if (candCost < featBound)
+                        featBound = candCost;
+                }
+                bound += featBound;
+                if (nbFree < minFree) {
+                    minFree = nbFree;
+                    next = i;
+                }
+            }
+
+            if (bound >= bestCost - EPSILON)
+                continue;
+
+            if (depth + 1 == size) {
+                bestCost = cost;
+                for (i = 0;i < size;i++)
+                    context->result[feats[i]] = cur[feats[i]];
+                continue;
+            }
+
+            // the best solution found so far is kept
+            if (++nbNodes > maxNodes) {
+                context->solved[component] = false;
+                break;
+            }
+            if ( (nbNodes & 1023) == 0 && prob->deadlineReached()) {
+                context->solved[component] = false;
+                context->cut[component] = true;
+                break;
+            }
+
+            depth++;
+            costs[depth] = cost;
+            choice[depth] = -1;
+            order[depth] = next;
+            depthOf[next] = depth;
+            cur[feats[next]] = -1;
+        }
+
+        context->improved[component] = (bestCost < initialCost - EPSILON);
+
+        delete[] order;
+        delete[] depthOf;
+        delete[] choice;
+        delete[] first;
+        delete[] costs;
+        delete[] extra;
+    }
+
+    void Problem::exactSearch (int maxSize, bool *solved, long maxNodes) {
+        int i;
+        int c;
+        int size;
+        int nbComp = 0;
+
+        for (c = 0;c < nbComponents;c++)
+            solved[c] = false;
+
+        // single features are already solved, as clusters labelled as previously
+        ExactSearchContext context;
+        context.problem = this;
+        context.components = new int[nbComponents];
+        for (c = 0;c < nbComponents;c++) {
+            size = componentStart[c+1] - componentStart[c];
+            if (size > 1 && size <= maxSize && !isWarm (c))
+                context.components[nbComp++] = c;
+        }
+
+        if (nbComp == 0) {
+            delete[] context.components;
+            return;
+        }
+
+        // starts of a multi-start search run on one thread each
+        int nbThreads = (model ? 1 : pal->nbThreads);
+        if (nbThreads > nbComp)
+            nbThreads = nbComp;
+
+        context.pos = new int*[nbThreads];
+        context.cur = new int*[nbThreads];
+        for (i = 0;i < nbThreads;i++) {
+            context.pos[i] = new int[nbft];
+            context.cur[i] = new int[nbft];
+        }
+        context.result = new int[nbft];
+        context.improved = new bool[nbComponents];
+        context.solved = solved;
+        context.cut = new bool[nbComponents];
+        context.maxNodes = maxNodes;
+
+        parallelRun (nbThreads, nbComp, exactComponentJob, (void*) &context);
+
+        // merged in components order, whatever the threads
+        for (i = 0;i < nbComp;i++) {
+            c = context.components[i];
+            if (context.cut[c])
+                budgetHit = true;
+            if (context.improved[c]) {
+                for (int k = componentStart[c];k < componentStart[c+1];k++)
+                    setLabel (componentFeats[k], context.result[componentFeats[k]]);
+            }
+        }
+
+#ifdef _VERBOSE_
+        int nbSolved = 0;
+        for (i = 0;i < nbComp;i++)
+            if (solved[context.components[i]])
+                nbSolved++;
+        std::cout << "   exact search: " << nbSolved << "/" << nbComp << " components solved" << std::endl;
+#endif
+
+        for (i = 0;i < nbThreads;i++) {
+            delete[] context.pos[i];
+            delete[] context.cur[i];
+        }
+        delete[] context.pos;
+        delete[] context.cur;
+        delete[] context.result;
+        delete[] context.improved;
+        delete[] context.cut;
+        delete[] context.components;
+    }
+
+    typedef struct {
+        Problem **starts;
+        SearchMethod searchMethod;
+    } MultiStartContext;
+
+    /*
+     * One start of the multi-start search. Starts only share read-only
+     * data, each one searches its own solution.
+     */
+    void multiStartJob (int job, int /*thread*/, void *ctx) {
+        MultiStartContext *context = (MultiStartContext*) ctx;
+        Problem *start = context->starts[job];
+
+        if (context->searchMethod != CHAIN && context->searchMethod != BRANCH_AND_BOUND)
+            start->popmusic();
+        else
+            start->chain_search();
+    }
+
+    void Problem::multiStart (int nbStarts) {
+
+        if (nbft == 0)
+            return;
+
+        int i;
+        int best = -1;
+        Problem *start;
+
+        double phaseStart = wallTime();
+
+        MultiStartContext context;
+        context.starts = new Problem*[nbStarts];
+        context.searchMethod = pal->searchMethod;
+
+        // start 0 is the plain search, the others are perturbed from Pal's seed
+        unsigned int perturbation;
+        for (i = 0;i < nbStarts;i++) {
+            perturbation = pal->seed * 2654435761u + i;
+            if (i > 0 && perturbation == 0)
+                perturbation = i;
+            context.starts[i] = new Problem (this, i == 0 ? 0 : perturbation);
+        }
+
+        parallelRun (pal->nbThreads, nbStarts, multiStartJob, (void*) &context);
+
+        // lowest cost, first start on ties
+        for (i = 0;i < nbStarts;i++) {
+            start = context.starts[i];
+            if (start->sol && (best == -1 || start->sol->cost < context.starts[best]->sol->cost - EPSILON))
+                best = i;
+
+            nbSearchIterations += start->nbSearchIterations;
+            if (start->budgetHit)
+                budgetHit = true;
+        }
+
+#ifdef _VERBOSE_
+        for (i = 0;i < nbStarts;i++) {
+            if (context.starts[i]->sol)
+                std::cout << "   start " << i << " solution cost: " << context.starts[i]->sol->cost << std::endl;
+        }
+#endif
+
+        if (best != -1) {
+            // take the solution over, the start gets the empty one
+            start = context.starts[best];
+
+            Sol *bestSol = start->sol;
+            start->sol = sol;
+            sol = bestSol;
+
+            int *bestNbOverlap = start->featNbOverlap;
+            start->featNbOverlap = featNbOverlap;
+            featNbOverlap = bestNbOverlap;
+
+            RTree<LabelPosition*, double, 2, double> *bestIndex = start->candidates_sol;
+            start->candidates_sol = candidates_sol;
+            candidates_sol = bestIndex;
+
+            nbActive = start->nbActive;
+            nbSolOverlap = start->nbSolOverlap;
+            initSolTime = start->initSolTime;
+        }
+
+        for (i = 0;i < nbStarts;i++)
+            delete context.starts[i];
+        delete[] context.starts;
+
+        searchTime = wallTime() - phaseStart - initSolTime;
+    }
+
 #if 0
     double Problem::popmusic_chain (SubPart *part) {
         int i;
@@ -2895,9 +3776,28 @@ namespace pal {
             }
         }
 
+        stats->extractTime = extractTime;
+        stats->filterTime = filterTime;
+        stats->conflictGraphTime = conflictGraphTime;
+        stats->reduceTime = reduceTime;
+        stats->initSolTime = initSolTime;
+        stats->searchTime = searchTime;
+        stats->nbCandidates = nbCandidates;
+        stats->nbPrunedCandidates = nbCandidates - nblp;
+        stats->nbConflicts = nbOverlap;
+        stats->nbRTreeQueries = nbRTreeQueries;
+        stats->nbConflictTests = nbConflictTests;
+        stats->nbSearchIterations = nbSearchIterations;
+        stats->solutionCost = sol->cost;
+        stats->budgetHit = budgetHit;
+
         return stats;
     }
 
+    bool Problem::deadlineReached () {
+        return deadline >= 0 && wallTime() >= deadline;
+    }
+
     void Problem::post_optimization() {
 #if 0
         /*
@@ -2970,18 +3870,20 @@ namespace pal {
         std::cout << "Global solution evaluation" << std::endl;
 #endif
 
-        sol->cost = 0.0;
-        nbActive = 0;
+        double cost = 0.0;
+        int active = 0;
+        int overlaps = 0;
 
         int nbOv;
 
-        int c;
-        int i;
+        int i, k;
+
+        LabelPosition **hits = NULL;
+        int capacity = 0;
+        int nbHits;
+        int *ids = NULL;
+        int idsCapacity = 0;
 
-        CountContext context;
-        context.inactiveCost = inactiveCost;
-        context.nbOv = &nbOv;
-        context.cost = &sol->cost;
         double amin[2];
         double amax[2];
         LabelPosition *lp;
@@ -2990,39 +3892,61 @@ namespace pal {
 
         for (i = 0;i < nbft;i++) {
             if (sol->s[i] == -1) {
-                sol->cost += inactiveCost[i];
+                cost += inactiveCost[i];
                 nbHidden++;
             } else {
-                nbOv = 0;
                 lp = labelpositions[sol->s[i]];
 
-                amin[0] = DBL_MAX;
-                amax[0] = -DBL_MAX;
-                amin[1] = DBL_MAX;
-                amax[1] = -DBL_MAX;
-                for (c = 0;c < 4;c++) {
-                    if (lp->x[c] < amin[0])
-                        amin[0] = lp->x[c];
-                    if (lp->x[c] > amax[0])
-                        amax[0] = lp->x[c];
-                    if (lp->y[c] < amin[1])
-                        amin[1] = lp->y[c];
-                    if (lp->y[c] > amax[1])
-                        amax[1] = lp->y[c];
+                geom->getBoundingBox (sol->s[i], amin, amax);
+                nbHits = candidates_sol->Collect (amin, amax, &hits, &capacity);
+                nbRTreeQueries++;
+                nbConflictTests += nbHits;
+
+                if (idsCapacity < capacity) {
+                    delete[] ids;
+                    ids = new int[capacity];
+                    idsCapacity = capacity;
+                }
+
+                if (geom->allAxisAligned)
+                    nbOv = geom->conflicts<AxisAlignedRect> (sol->s[i], hits, nbHits, ids);
+                else
+                    nbOv = geom->conflicts<RotatedRect> (sol->s[i], hits, nbHits, ids);
+
+                for (k = 0;k < nbOv;k++) {
+#ifdef _DEBUG_FULL_
+                    std::cout <<  "count overlap : " << ids[k] << "<->" << sol->s[i] << std::endl;
+#endif
+                    cost += inactiveCost[geom->feat[ids[k]]] + labelpositions[ids[k]]->cost;
                 }
-                context.lp = lp;
-                candidates_sol->Search (amin, amax, countFullOverlapCallback, &context);
 
-                sol->cost += lp->cost;
+                cost += lp->cost;
+                overlaps += nbOv;
 
                 if (nbOv == 0)
-                    nbActive++;
+                    active++;
             }
         }
 
+        delete[] hits;
+        delete[] ids;
+
+        // each overlap is seen from both labels
+        overlaps /= 2;
+
+        if (vabs (cost - sol->cost) > EPSILON * (1 + vabs (cost)) || active != nbActive || overlaps != nbSolOverlap) {
+            std::cerr << "Solution drift: cost " << sol->cost << " <> " << cost
+                      << ", nbActive " << nbActive << " <> " << active
+                      << ", overlaps " << nbSolOverlap << " <> " << overlaps << std::endl;
+        }
+
+        sol->cost = cost;
+        nbActive = active;
+        nbSolOverlap = overlaps;
+
 #ifdef _DEBUG_
         if (nbActive + nbHidden != nbft) {
-            std::cout << "Conflicts in solution: " << nbHidden / 2 << std::endl;
+            std::cout << "Conflicts in solution: " << nbSolOverlap << std::endl;
         }
         std::cout << "nbActive and free: " << nbActive << " (" << double (nbActive) / double (nbft) << " %)" << std::endl;
         std::cout << "solution cost:" << sol->cost << std::endl;
@@ -36,8 +36,12 @@
 
 namespace pal {
 
+    class Arena;
+    class CandidateGeom;
     class LabelPosition;
     class Label;
+    class PriorityQueue;
+    struct _popmusiccontext;
 
     class Sol {
     public:
@@ -75,6 +79,22 @@ namespace pal {
         int seed;
     } SubPart;
 
+    /**
+     * \brief working data of a thread optimizing sub parts
+     */
+    typedef struct _subpartstate {
+        /**
+         * wrap bw main feat and sub feat (-1 if not in sub part)
+         */
+        int *featWrap;            // [nbft]
+        double *labelPositionCost; // [all_nblp]
+        int *nbOlap;              // [all_nblp]
+        /**
+         * index active candidates of the sub part
+         */
+        RTree<LabelPosition*, double, 2, double> *candidates_subsol;
+    } SubPartState;
+
     typedef struct _chain {
         int degree;
         double delta;
@@ -88,6 +108,13 @@ namespace pal {
     class Problem {
 
         friend class Pal;
+        friend class LabellingSession;
+        friend void popmusicJob (int job, int thread, void *ctx);
+        friend void chainComponentJob (int job, int thread, void *ctx);
+        friend void multiStartJob (int job, int thread, void *ctx);
+        friend void popmusicRoundJob (int job, int thread, void *ctx);
+        friend void exactComponentJob (int job, int thread, void *ctx);
+        friend class ExactSearchTest;
 
     private:
 
@@ -131,14 +158,40 @@ namespace pal {
          */
         double scale;
 
-        double *labelPositionCost;
-        int *nbOlap;
+        /**
+         * Candidates, Feats records and search scratch of the problem,
+         * released at once with the problem
+         */
+        Arena *arena;
 
         LabelPosition **labelpositions;
 
+        /**
+         * Geometry of labelpositions as arrays indexed by candidate id, for
+         * conflicts look up and indexes maintenance
+         */
+        CandidateGeom *geom;
+
         RTree<LabelPosition*, double, 2, double> *candidates;  // index all candidates
         RTree<LabelPosition*, double, 2, double> *candidates_sol; // index active candidates
-        RTree<LabelPosition*, double, 2, double> *candidates_subsol; // idem for subparts
+
+        /**
+         * Conflict graph (compressed sparse row) : candidates in conflict
+         * with candidate i are conflictList[conflictStart[i]] to
+         * conflictList[conflictStart[i+1]-1], sorted by id
+         */
+        int *conflictStart; // [all_nblp+1]
+        int *conflictList;
+
+        /**
+         * Connected components of the conflict graph : features of
+         * component c are componentFeats[componentStart[c]] to
+         * componentFeats[componentStart[c+1]-1]
+         */
+        int nbComponents;
+        int *componentStart; // [nbComponents+1]
+        int *componentFeats; // [nbft]
+        int *featComponent;  // [nbft]
 
         //int *feat;        // [nblp]
         int *featStartId; // [nbft]
@@ -148,43 +201,181 @@ namespace pal {
         Sol *sol;         // [nbft]
         int nbActive;
 
+        /**
+         * Overlaps between retained labels, kept up to date by setLabel() :
+         * # retained labels overlapping the one of feature i, # overlapping pairs
+         */
+        int *featNbOverlap; // [nbft]
+        int nbSolOverlap;
+
+        /**
+         * Solution to start from (labelling session) : candidate retained
+         * for feature i by the previous labelling, -1 if feature i was not
+         * labelled, -2 if feature i is new (NULL without session)
+         */
+        int *warmSol;     // [nbft]
+
         int nbOverlap;
 
-        int *featWrap;
+        /**
+         * Wall-clock time (see wallTime()) at which the search must stop,
+         * -1 without time budget. The initial solution is always computed.
+         */
+        double deadline;
+        bool budgetHit;   // the search was stopped by the deadline
+
+        /**
+         * Multi-start search : the problem this one is a start of (NULL
+         * otherwise) and the seed perturbing its initial solution and
+         * sub parts order (0 for the plain search)
+         */
+        Problem *model;
+        unsigned int startSeed;
+
+        /**
+         * Phases durations and counters, see PalStat
+         */
+        double extractTime;
+        double filterTime;
+        double conflictGraphTime;
+        double reduceTime;
+        double initSolTime;
+        double searchTime;
+        long nbCandidates;
+        long nbRTreeQueries;
+        long nbConflictTests;
+        long nbSearchIterations;
 
-        Chain *chain (SubPart *part, int seed);
+        Chain *chain (SubPart *part, int seed, SubPartState *state);
 
-        Chain *chain (int seed);
+        Chain *chain (int seed, int *tmpsol);
 
         Pal *pal;
 
+        /**
+         * \brief set the label of feature f in the solution (-1 to hide it)
+         *
+         * The solution index, its cost, nbActive and the overlaps are updated
+         * from the conflict graph of the old and new labels.
+         */
+        void setLabel (int f, int label);
+
+        /**
+         * \brief recompute the cost of the whole solution
+         *
+         * Debug check of the values maintained by setLabel(), mismatches
+         * are reported and fixed.
+         */
         void solution_cost();
         void check_solution();
 
         Problem();
 
+        /**
+         * \brief a start of the multi-start search of model
+         *
+         * The start shares the candidates, the conflict graph and the
+         * components of model (which must outlive it) and only owns its
+         * solution.
+         */
+        Problem (Problem *model, unsigned int startSeed);
+
         //Problem(char *lorena_file, bool displayAll);
 
         ~Problem();
 
 
+        /**
+         * \brief build the conflict graph of all indexed candidates
+         *
+         * Set candidates' nbOverlap and the problem's nbOverlap.
+         * \param nbThreads number of threads used to look up conflicts
+         */
+        void buildConflictGraph (int nbThreads);
+
+        /**
+         * \brief remove dropped candidates from the conflict graph
+         * \param removed removed[i] is true when candidate i was dropped
+         */
+        void compactConflictGraph (bool *removed);
+
         void reduce();
 
+        /**
+         * \brief split features into connected components of the conflict graph
+         *
+         * To be called once reduce() is done. Features alone in their
+         * component are labelled with their best candidate by the searches
+         * and never optimized.
+         */
+        void decompose();
+
 
         void post_optimization();
 
+        /**
+         * \brief true once the time budget of the labelling is spent
+         */
+        bool deadlineReached ();
+
 
 
         /**
          * \brief popmusic framework
+         *
+         * Sub parts which do not share any feature are optimized
+         * concurrently on Pal's threads.
          */
         void popmusic();
 
+        /**
+         * \brief deterministic POPMUSIC search (see Pal::setDeterministic())
+         *
+         * Rounds of sub parts which do not share any feature are optimized
+         * concurrently and merged in their order.
+         */
+        void popmusicRounds (struct _popmusiccontext *context, int nbThreads);
+
+        /**
+         * \brief optimize a sub part from its current solution with searchMethod
+         * @return the improvement of the sub part cost
+         */
+        double optimizeSubPart (SearchMethod searchMethod, SubPart *part, SubPartState *state);
+
+        /**
+         * \brief apply the solution of an improved sub part, its seeds are to be optimized again
+         */
+        void commitSubPart (SubPart *part, bool *ok);
+
         /**
          * \brief Test with very-large scale neighborhood
+         *
+         * Connected components are improved concurrently on Pal's threads.
          */
         void chain_search();
 
+        /**
+         * \brief solve small connected components exactly by branch and bound
+         *
+         * Components of at most maxSize features, but single features and
+         * components labelled as previously, are solved concurrently on
+         * Pal's threads from their current labels.
+         * @param maxSize # features of the largest component to solve
+         * @param solved [nbComponents] true for components whose labels are optimal
+         * @param maxNodes # nodes explored per component, the best labels
+         * found are kept when a component needs more
+         */
+        void exactSearch (int maxSize, bool *solved, long maxNodes = 100000);
+
+        /**
+         * \brief run nbStarts independent searches, keep the best solution
+         *
+         * Starts other than the first one begin from a perturbed FALP
+         * solution and visit the sub parts in another order. They run
+         * concurrently on Pal's threads, each search being sequential.
+         */
+        void multiStart (int nbStarts);
+
         std::list<Label*> * getSolution (bool returnInactive);
 
         PalStat * getStats();
@@ -196,17 +387,41 @@ namespace pal {
 
         void initialization();
 
-        double compute_feature_cost (SubPart *part, int feat_id, int label_id, int *nbOverlap);
-        double compute_subsolution_cost (SubPart *part, int *s, int * nbOverlap);
+        double compute_feature_cost (SubPart *part, int feat_id, int label_id, int *nbOverlap, SubPartState *state);
+        double compute_subsolution_cost (SubPart *part, int *s, int * nbOverlap, SubPartState *state);
 
-        double popmusic_chain (SubPart *part);
+        double popmusic_chain (SubPart *part, SubPartState *state);
 
-        double popmusic_tabu (SubPart *part);
-        double popmusic_tabu_chain (SubPart *part);
+        double popmusic_tabu (SubPart *part, SubPartState *state);
+        double popmusic_tabu_chain (SubPart *part, SubPartState *state);
 
         void init_sol_empty();
+
+        /**
+         * \brief FALP initial solution
+         *
+         * Candidates of warmSol are retained first.
+         */
         void init_sol_falp();
 
+        /**
+         * \brief is the component labelled as in the previous labelling ?
+         *
+         * Such a component is not optimized again.
+         * @param c the component
+         */
+        bool isWarm (int c);
+
+        /**
+         * \brief retain a candidate in FALP and ignore its concurrents
+         */
+        void retainLabel (int label, PriorityQueue *list);
+
+        /**
+         * \brief remove a candidate from FALP list and make its conflicts more attractive
+         */
+        void ignoreLabel (int label, PriorityQueue *list);
+
 #ifdef _EXPORT_MAP_
         void drawLabels (std::ofstream &svgmap);
 #endif
@@ -27,6 +27,8 @@
 #include <cmath>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #define ASSERT assert // RTree uses ASSERT( condition )
 #ifndef Min
@@ -40,16 +42,143 @@
 // RTree.h
 //
 
-#define RTREE_TEMPLATE template<class DATATYPE, class ELEMTYPE, int NUMDIMS, class ELEMTYPEREAL, int TMAXNODES, int TMINNODES>
-#define RTREE_QUAL RTree<DATATYPE, ELEMTYPE, NUMDIMS, ELEMTYPEREAL, TMAXNODES, TMINNODES>
-
-#define RTREE_DONT_USE_MEMPOOLS // This version does not contain a fixed memory allocator, fill in lines with EXAMPLE to implement one.
+#define RTREE_TEMPLATE template<class DATATYPE, class ELEMTYPE, int NUMDIMS, class ELEMTYPEREAL, int TMAXNODES, int TMINNODES, class ALLOCATOR>
+#define RTREE_QUAL RTree<DATATYPE, ELEMTYPE, NUMDIMS, ELEMTYPEREAL, TMAXNODES, TMINNODES, ALLOCATOR>
 #define RTREE_USE_SPHERICAL_VOLUME // Better split classification, may be slower on some systems
 
 namespace pal {
 
 // Fwd decl
     class RTFileStream;  // File I/O helper class, look below for implementation and notes.
+    class RTMemStream;   // Same as RTFileStream, reading a memory buffer
+
+
+/// \class RTreeHeap
+/// RTree node allocator : one new/delete per node
+    class RTreeHeap {
+    public:
+        RTreeHeap (size_t a_size) : m_size (a_size) {}
+
+        void* Alloc() {
+            return ::operator new (m_size);
+        }
+
+        void Free (void* a_ptr) {
+            ::operator delete (a_ptr);
+        }
+
+        /// Free all blocks at once
+        /// \return false, blocks must be freed one by one
+        bool Release() {
+            return false;
+        }
+
+    private:
+        size_t m_size;
+    };
+
+
+/// \class RTreePool
+/// RTree node allocator : blocks are carved from slabs, aligned on cache lines, and freed blocks are
+/// recycled through a free list. Release() gives all blocks back in O(1) and keeps slabs for the next ones.
+    class RTreePool {
+    public:
+        RTreePool (size_t a_size) : m_first (NULL), m_current (NULL), m_used (0), m_freeList (NULL) {
+            // blocks hold the free list link
+            if (a_size < sizeof (void*)) {
+                a_size = sizeof (void*);
+            }
+            m_stride = (a_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+        }
+
+        ~RTreePool() {
+            Slab* slab;
+            while (m_first) {
+                slab = m_first;
+                m_first = slab->m_next;
+                delete[] (char*) slab;
+            }
+        }
+
+        void* Alloc() {
+            void* ptr;
+
+            if (m_freeList) {
+                ptr = m_freeList;
+                m_freeList = * (void**) ptr;
+                return ptr;
+            }
+
+            if (!m_current || m_used == SLAB_BLOCKS) {
+                if (m_current && m_current->m_next) {
+                    m_current = m_current->m_next; // slab kept by Release()
+                } else {
+                    char* raw = new char[sizeof (Slab) + CACHE_LINE + m_stride * SLAB_BLOCKS];
+                    Slab* slab = (Slab*) raw;
+                    size_t offset = (size_t) (raw + sizeof (Slab)) % CACHE_LINE;
+
+                    slab->m_blocks = raw + sizeof (Slab) + (offset ? CACHE_LINE - offset : 0);
+                    slab->m_next = NULL;
+                    if (m_current) {
+                        m_current->m_next = slab;
+                    } else {
+                        m_first = slab;
+                    }
+                    m_current = slab;
+                }
+                m_used = 0;
+            }
+
+            return m_current->m_blocks + m_stride * m_used++;
+        }
+
+        void Free (void* a_ptr) {
+            * (void**) a_ptr = m_freeList;
+            m_freeList = a_ptr;
+        }
+
+        /// Free all blocks at once
+        /// \return true
+        bool Release() {
+            m_current = m_first;
+            m_used = 0;
+            m_freeList = NULL;
+            return true;
+        }
+
+    private:
+        enum {
+            CACHE_LINE = 64,                              ///< Blocks alignment
+            SLAB_BLOCKS = 64                              ///< # blocks per slab
+        };
+
+        struct Slab {
+            Slab* m_next;
+            char* m_blocks;
+        };
+
+        size_t m_stride;                                  ///< Block size, rounded up to cache lines
+        Slab* m_first;                                    ///< Slabs, in allocation order
+        Slab* m_current;                                  ///< Slab being carved
+        int m_used;                                       ///< # blocks carved from m_current
+        void* m_freeList;                                 ///< Freed blocks
+    };
+
+
+/// \class StaticCallback
+/// RTree::Visit() functor calling a Search() style callback known at compile time : the call can be inlined.
+/// Example usage: StaticCallback<Object*, myCallback> visitor (&myContext); myTree.Visit (min, max, visitor);
+    template < class DATATYPE, bool CALLBACK (DATATYPE a_data, void* a_context) >
+    class StaticCallback {
+    public:
+        void* m_context;
+
+        StaticCallback (void* a_context) : m_context (a_context) {}
+
+        bool operator() (DATATYPE a_data) {
+            return CALLBACK (a_data, m_context);
+        }
+    };
 
 
 /// \class RTree
@@ -63,13 +192,14 @@ namespace pal {
 /// NUMDIMS Number of dimensions such as 2 or 3
 /// ELEMTYPEREAL Type of element that allows fractional and large values such as float or double, for use in volume calcs
 ///
+/// ALLOCATOR Nodes allocator, RTreePool (default) or RTreeHeap
+///
 /// NOTES: Inserting and removing data requires the knowledge of its constant Minimal Bounding Rectangle.
-///        This version uses new/delete for nodes, I recommend using a fixed size allocator for efficiency.
 ///        Instead of using a callback function for returned results, I recommend and efficient pre-sized, grow-only memory
 ///        array similar to MFC CArray or STL Vector for returning search query result.
 ///
     template < class DATATYPE, class ELEMTYPE, int NUMDIMS,
-    class ELEMTYPEREAL = ELEMTYPE, int TMAXNODES = 8, int TMINNODES = TMAXNODES / 2 >
+    class ELEMTYPEREAL = ELEMTYPE, int TMAXNODES = 8, int TMINNODES = TMAXNODES / 2, class ALLOCATOR = RTreePool >
     class RTree {
     protected:
 
@@ -81,15 +211,29 @@ namespace pal {
         // Stuck up here for MSVC 6 compiler.  NSVC .NET 2003 is much happier.
         enum {
             MAXNODES = TMAXNODES,                         ///< Max elements in node
-            MINNODES = TMINNODES                         ///< Min elements in node
+            MINNODES = TMINNODES,                        ///< Min elements in node
+            MAXDEPTH = 32                                 ///< Max tree depth for Visit(), as Iterator
         };
 
 
     public:
 
         RTree();
+
+        /// Build a packed tree from a known set of entries (see BulkLoad)
+        RTree (int a_count, const ELEMTYPE* a_min, const ELEMTYPE* a_max, const DATATYPE* a_dataId);
+
         virtual ~RTree();
 
+        /// Replace tree contents by a_count entries, packed with Sort-Tile-Recursive.
+        /// Nodes are filled up and overlap less than after one Insert per entry,
+        /// the tree remains a regular RTree (Insert and Remove can still be used).
+        /// \param a_count Number of entries
+        /// \param a_min Min of bounding rects, NUMDIMS values per entry
+        /// \param a_max Max of bounding rects, NUMDIMS values per entry
+        /// \param a_dataId Data of each entry
+        void BulkLoad (int a_count, const ELEMTYPE* a_min, const ELEMTYPE* a_max, const DATATYPE* a_dataId);
+
         /// Insert entry
         /// \param a_min Min of bounding rect
         /// \param a_max Max of bounding rect
@@ -111,6 +255,24 @@ namespace pal {
         /// \return Returns the number of entries found
         int Search (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], bool a_resultCallback (DATATYPE a_data, void* a_context), void* a_context);
 
+        /// Find all within search rectangle, without function pointer
+        /// \param a_min Min of search bounding rect
+        /// \param a_max Max of search bounding rect
+        /// \param a_visitor Any object with a 'bool operator() (DATATYPE&)' (a functor or a lambda), called for
+        ///                  each entry found. Return 'true' to continue searching. Unlike a callback, the call can be inlined
+        /// \return Returns the number of entries found
+        template <class VISITOR>
+        int Visit (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], VISITOR& a_visitor);
+
+        /// Append all within search rectangle to a buffer
+        /// \param a_min Min of search bounding rect
+        /// \param a_max Max of search bounding rect
+        /// \param a_buffer Caller's buffer (new[] allocated, may be NULL), replaced by a larger one when full
+        /// \param a_capacity Size of a_buffer, updated when the buffer grows
+        /// \param a_count # entries already in a_buffer, found entries are stored after them
+        /// \return Returns the # entries in a_buffer
+        int Collect (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], DATATYPE** a_buffer, int* a_capacity, int a_count = 0);
+
         /// Remove all entries from tree
         void RemoveAll();
 
@@ -121,12 +283,21 @@ namespace pal {
         bool Load (const char* a_fileName);
         /// Load tree contents from stream
         bool Load (RTFileStream& a_stream);
+        /// Load tree contents from stream, data are read by a_reader
+        /// \param a_stream RTFileStream or RTMemStream
+        /// \param a_reader Any object with a 'bool operator() (STREAM&, DATATYPE&)', returning false on error
+        template <class STREAM, class READER>
+        bool Load (STREAM& a_stream, READER& a_reader);
 
 
         /// Save tree contents to file
         bool Save (const char* a_fileName);
         /// Save tree contents to stream
         bool Save (RTFileStream& a_stream);
+        /// Save tree contents to stream, data are written by a_writer (pointers can be replaced by ids)
+        /// \param a_writer Any object with a 'bool operator() (RTFileStream&, const DATATYPE&)', returning false on error
+        template <class WRITER>
+        bool Save (RTFileStream& a_stream, WRITER& a_writer);
 
         /// Iterator is not remove safe.
         class Iterator {
@@ -297,6 +468,18 @@ namespace pal {
             ELEMTYPEREAL m_coverSplitArea;
         };
 
+        /// Order branches by the center of their rect along one axis
+        struct BranchCenterLess {
+            int m_axis;
+            BranchCenterLess (int a_axis) : m_axis (a_axis) {}
+            bool operator() (const Branch& a_branchA, const Branch& a_branchB) const {
+                return a_branchA.m_rect.m_min[m_axis] + a_branchA.m_rect.m_max[m_axis]
+                       < a_branchB.m_rect.m_min[m_axis] + a_branchB.m_rect.m_max[m_axis];
+            }
+        };
+
+        void Init();
+        void PackRec (Branch* a_branch, int a_count, int a_axis, int a_level, Branch* a_parent, int& a_parentCount);
         Node* AllocNode();
         void FreeNode (Node* a_node);
         void InitNode (Node* a_node);
@@ -324,16 +507,68 @@ namespace pal {
         void FreeListNode (ListNode* a_listNode);
         bool Overlap (Rect* a_rectA, Rect* a_rectB);
         void ReInsert (Node* a_node, ListNode** a_listNode);
-        bool Search (Node* a_node, Rect* a_rect, int& a_foundCount, bool a_resultCallback (DATATYPE a_data, void* a_context), void* a_context);
         void RemoveAllRec (Node* a_node);
         void Reset();
         void CountRec (Node* a_node, int& a_count);
+        template <class VISITOR>
+        bool VisitRec (Node* a_node, Rect* a_rect, int& a_foundCount, VISITOR& a_visitor);
+
+        template <class WRITER>
+        bool SaveRec (Node* a_node, RTFileStream& a_stream, WRITER& a_writer);
+        template <class STREAM, class READER>
+        bool LoadRec (Node* a_node, STREAM& a_stream, READER& a_reader);
+
+        /// Data stored as is by Load() and Save()
+        struct RawReader {
+            template <class STREAM>
+            bool operator() (STREAM& a_stream, DATATYPE& a_data) {
+                return a_stream.Read (a_data) == 1;
+            }
+        };
+
+        struct RawWriter {
+            template <class STREAM>
+            bool operator() (STREAM& a_stream, const DATATYPE& a_data) {
+                return a_stream.Write (a_data) == 1;
+            }
+        };
+
+        /// Visitor calling a Search() callback
+        struct CallbackVisitor {
+            bool (*m_callback) (DATATYPE a_data, void* a_context);
+            void* m_context;
+
+            bool operator() (DATATYPE& a_data) {
+                return m_callback (a_data, m_context);
+            }
+        };
 
-        bool SaveRec (Node* a_node, RTFileStream& a_stream);
-        bool LoadRec (Node* a_node, RTFileStream& a_stream);
+        /// Visitor of Collect()
+        struct BufferVisitor {
+            DATATYPE** m_buffer;
+            int* m_capacity;
+            int m_count;
+
+            bool operator() (DATATYPE& a_data) {
+                if (m_count == *m_capacity) {
+                    int capacity = (*m_capacity > 0 ? *m_capacity * 2 : 64);
+                    DATATYPE* buffer = new DATATYPE[capacity];
+                    for (int index = 0; index < m_count; ++index) {
+                        buffer[index] = (*m_buffer) [index];
+                    }
+                    delete[] *m_buffer;
+                    *m_buffer = buffer;
+                    *m_capacity = capacity;
+                }
+                (*m_buffer) [m_count++] = a_data;
+                return true;
+            }
+        };
 
         Node* m_root;                                    ///< Root of tree
         ELEMTYPEREAL m_unitSphereVolume;                 ///< Unit sphere constant for required number of dimensions
+        ALLOCATOR m_nodeAllocator;                       ///< Allocator of Node
+        ALLOCATOR m_listNodeAllocator;                   ///< Allocator of ListNode
     };
 
 
@@ -402,8 +637,51 @@ namespace pal {
     };
 
 
+// Reads a tree saved by RTFileStream from memory (a mapped file), Read() returns 0 past the end of the buffer.
+    class RTMemStream {
+        const char* m_pos;
+        const char* m_end;
+
+    public:
+        RTMemStream (const void* a_buffer, size_t a_size) {
+            m_pos = (const char*) a_buffer;
+            m_end = m_pos + a_size;
+        }
+
+        template< typename TYPE >
+        size_t Read (TYPE& a_value) {
+            return ReadArray (&a_value, 1);
+        }
+
+        template< typename TYPE >
+        size_t ReadArray (TYPE* a_array, int a_count) {
+            size_t size = sizeof (TYPE) * a_count;
+            if ( (size_t) (m_end - m_pos) < size) {
+                return 0;
+            }
+            memcpy ( (void*) a_array, m_pos, size);
+            m_pos += size;
+            return 1;
+        }
+    };
+
+
+    RTREE_TEMPLATE
+    RTREE_QUAL::RTree() : m_nodeAllocator (sizeof (Node)), m_listNodeAllocator (sizeof (ListNode)) {
+        Init();
+    }
+
+
+    RTREE_TEMPLATE
+    RTREE_QUAL::RTree (int a_count, const ELEMTYPE* a_min, const ELEMTYPE* a_max, const DATATYPE* a_dataId)
+            : m_nodeAllocator (sizeof (Node)), m_listNodeAllocator (sizeof (ListNode)) {
+        Init();
+        BulkLoad (a_count, a_min, a_max, a_dataId);
+    }
+
+
     RTREE_TEMPLATE
-    RTREE_QUAL::RTree() {
+    void RTREE_QUAL::Init() {
         ASSERT (MAXNODES > MINNODES);
         ASSERT (MINNODES > 0);
 
@@ -454,6 +732,83 @@ namespace pal {
     }
 
 
+    RTREE_TEMPLATE
+    void RTREE_QUAL::BulkLoad (int a_count, const ELEMTYPE* a_min, const ELEMTYPE* a_max, const DATATYPE* a_dataId) {
+        RemoveAll();
+
+        if (a_count <= 0)
+            return;
+
+        Branch* branch = new Branch[a_count];
+        for (int index = 0; index < a_count; ++index) {
+            for (int axis = 0; axis < NUMDIMS; ++axis) {
+                ASSERT (a_min[index*NUMDIMS+axis] <= a_max[index*NUMDIMS+axis]);
+                branch[index].m_rect.m_min[axis] = a_min[index*NUMDIMS+axis];
+                branch[index].m_rect.m_max[axis] = a_max[index*NUMDIMS+axis];
+            }
+            branch[index].m_data = a_dataId[index];
+        }
+
+        // Pack each level into nodes until they fit into the root
+        int count = a_count;
+        int level = 0;
+        while (count > MAXNODES) {
+            Branch* parent = new Branch[count];
+            int parentCount = 0;
+            PackRec (branch, count, 0, level, parent, parentCount);
+            delete[] branch;
+            branch = parent;
+            count = parentCount;
+            ++level;
+        }
+
+        m_root->m_level = level;
+        for (int index = 0; index < count; ++index) {
+            m_root->m_branch[index] = branch[index];
+        }
+        m_root->m_count = count;
+
+        delete[] branch;
+    }
+
+
+// Sort-Tile-Recursive : sort branches along a_axis, cut them in slabs and
+// recurse on next axis, the last axis is cut into nodes
+    RTREE_TEMPLATE
+    void RTREE_QUAL::PackRec (Branch* a_branch, int a_count, int a_axis, int a_level, Branch* a_parent, int& a_parentCount) {
+        int nbNodes = (a_count + MAXNODES - 1) / MAXNODES;
+
+        std::sort (a_branch, a_branch + a_count, BranchCenterLess (a_axis));
+
+        if (a_axis == NUMDIMS - 1 || nbNodes <= 1) {
+            // spread branches evenly, so that nodes are not under filled
+            for (int index = 0; index < nbNodes; ++index) {
+                int start = (int) ( (long) a_count * index / nbNodes);
+                int stop = (int) ( (long) a_count * (index + 1) / nbNodes);
+
+                Node* node = AllocNode();
+                node->m_level = a_level;
+                for (int b = start; b < stop; ++b) {
+                    node->m_branch[node->m_count++] = a_branch[b];
+                }
+
+                a_parent[a_parentCount].m_rect = NodeCover (node);
+                a_parent[a_parentCount].m_child = node;
+                ++a_parentCount;
+            }
+            return;
+        }
+
+        int nbSlabs = (int) ceil (pow ( (double) nbNodes, 1.0 / (NUMDIMS - a_axis)) - 1e-9);
+        for (int index = 0; index < nbSlabs; ++index) {
+            int start = (int) ( (long) a_count * index / nbSlabs);
+            int stop = (int) ( (long) a_count * (index + 1) / nbSlabs);
+            if (stop > start)
+                PackRec (a_branch + start, stop - start, a_axis + 1, a_level, a_parent, a_parentCount);
+        }
+    }
+
+
     RTREE_TEMPLATE
     void RTREE_QUAL::Remove (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], const DATATYPE& a_dataId) {
 #ifdef _DEBUG
@@ -481,6 +836,43 @@ namespace pal {
         }
 #endif //_DEBUG
 
+        CallbackVisitor visitor;
+        visitor.m_callback = a_resultCallback;
+        visitor.m_context = a_context;
+
+        return Visit (a_min, a_max, visitor);
+    }
+
+
+    RTREE_TEMPLATE
+    int RTREE_QUAL::Collect (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], DATATYPE** a_buffer, int* a_capacity, int a_count) {
+        BufferVisitor visitor;
+        visitor.m_buffer = a_buffer;
+        visitor.m_capacity = a_capacity;
+        visitor.m_count = a_count;
+
+        Visit (a_min, a_max, visitor);
+
+        return visitor.m_count;
+    }
+
+
+// Iterative depth first search, entries are visited in the same order as
+// a recursive search : children are stacked from the last one
+    RTREE_TEMPLATE
+    template <class VISITOR>
+    int RTREE_QUAL::Visit (const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS], VISITOR& a_visitor) {
+#ifdef _DEBUG
+        for (int index = 0; index < NUMDIMS; ++index) {
+            ASSERT (a_min[index] <= a_max[index]);
+        }
+#endif //_DEBUG
+
+        // at most MAXNODES-1 pending siblings per level
+        Node* stack[MAXDEPTH * MAXNODES];
+        int tos = 0;
+        int foundCount = 0;
+        Node* node;
         Rect rect;
 
         for (int axis = 0; axis < NUMDIMS; ++axis) {
@@ -488,15 +880,66 @@ namespace pal {
             rect.m_max[axis] = a_max[axis];
         }
 
-        // NOTE: May want to return search result another way, perhaps returning the number of found elements here.
+        // a deeper tree would overflow the stack
+        if (m_root->m_level >= MAXDEPTH) {
+            VisitRec (m_root, &rect, foundCount, a_visitor);
+            return foundCount;
+        }
 
-        int foundCount = 0;
-        Search (m_root, &rect, foundCount, a_resultCallback, a_context);
+        stack[tos++] = m_root;
+
+        while (tos > 0) {
+            node = stack[--tos];
+
+            if (node->IsInternalNode()) { // This is an internal node in the tree
+                for (int index = node->m_count - 1; index >= 0; --index) {
+                    if (Overlap (&rect, &node->m_branch[index].m_rect)) {
+                        ASSERT (tos < MAXDEPTH * MAXNODES);
+                        stack[tos++] = node->m_branch[index].m_child;
+                    }
+                }
+            } else { // This is a leaf node
+                for (int index = 0; index < node->m_count; ++index) {
+                    if (Overlap (&rect, &node->m_branch[index].m_rect)) {
+                        ++foundCount;
+                        if (!a_visitor (node->m_branch[index].m_data)) {
+                            return foundCount; // Don't continue searching
+                        }
+                    }
+                }
+            }
+        }
 
         return foundCount;
     }
 
 
+// Recursive Visit(), without any depth limit. Returns false when the visitor stopped the search
+    RTREE_TEMPLATE
+    template <class VISITOR>
+    bool RTREE_QUAL::VisitRec (Node* a_node, Rect* a_rect, int& a_foundCount, VISITOR& a_visitor) {
+        if (a_node->IsInternalNode()) { // This is an internal node in the tree
+            for (int index = 0; index < a_node->m_count; ++index) {
+                if (Overlap (a_rect, &a_node->m_branch[index].m_rect)
+                        && !VisitRec (a_node->m_branch[index].m_child, a_rect, a_foundCount, a_visitor)) {
+                    return false; // Don't continue searching
+                }
+            }
+        } else { // This is a leaf node
+            for (int index = 0; index < a_node->m_count; ++index) {
+                if (Overlap (a_rect, &a_node->m_branch[index].m_rect)) {
+                    ++a_foundCount;
+                    if (!a_visitor (a_node->m_branch[index].m_data)) {
+                        return false; // Don't continue searching
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+
     RTREE_TEMPLATE
     int RTREE_QUAL::Count() {
         int count = 0;
@@ -539,6 +982,14 @@ namespace pal {
 
     RTREE_TEMPLATE
     bool RTREE_QUAL::Load (RTFileStream& a_stream) {
+        RawReader raw;
+        return Load (a_stream, raw);
+    }
+
+
+    RTREE_TEMPLATE
+    template <class STREAM, class READER>
+    bool RTREE_QUAL::Load (STREAM& a_stream, READER& a_reader) {
         // Write some kind of header
         int _dataFileId = ('R' << 0) | ('T' << 8) | ('R' << 16) | ('E' << 24);
         int _dataSize = sizeof (DATATYPE);
@@ -576,7 +1027,7 @@ namespace pal {
                 && (dataMinNodes == _dataMinNodes)
            ) {
             // Recursively load tree
-            result = LoadRec (m_root, a_stream);
+            result = LoadRec (m_root, a_stream, a_reader);
         }
 
         return result;
@@ -584,32 +1035,53 @@ namespace pal {
 
 
     RTREE_TEMPLATE
-    bool RTREE_QUAL::LoadRec (Node* a_node, RTFileStream& a_stream) {
-        a_stream.Read (a_node->m_level);
-        a_stream.Read (a_node->m_count);
+    template <class STREAM, class READER>
+    bool RTREE_QUAL::LoadRec (Node* a_node, STREAM& a_stream, READER& a_reader) {
+        int level = a_node->m_level;
+
+        if (!a_stream.Read (a_node->m_level) || !a_stream.Read (a_node->m_count)) {
+            a_node->m_count = 0;
+            return false;
+        }
+
+        // children are one level below their parent, Visit() walks at most MAXDEPTH levels
+        // and only a root leaf is empty
+        if (a_node->m_count < 0 || a_node->m_count > MAXNODES
+                || a_node->m_level < 0 || a_node->m_level >= MAXDEPTH
+                || (a_node != m_root && a_node->m_level != level)
+                || (a_node->IsInternalNode() && a_node->m_count == 0)) {
+            a_node->m_count = 0;
+            return false;
+        }
 
         if (a_node->IsInternalNode()) { // not a leaf node
             for (int index = 0; index < a_node->m_count; ++index) {
                 Branch* curBranch = &a_node->m_branch[index];
 
-                a_stream.ReadArray (curBranch->m_rect.m_min, NUMDIMS);
-                a_stream.ReadArray (curBranch->m_rect.m_max, NUMDIMS);
-
                 curBranch->m_child = AllocNode();
-                LoadRec (curBranch->m_child, a_stream);
+                curBranch->m_child->m_level = a_node->m_level - 1;
+
+                if (!a_stream.ReadArray (curBranch->m_rect.m_min, NUMDIMS)
+                        || !a_stream.ReadArray (curBranch->m_rect.m_max, NUMDIMS)
+                        || !LoadRec (curBranch->m_child, a_stream, a_reader)) {
+                    a_node->m_count = index + 1; // keep loaded nodes, they are freed with the tree
+                    return false;
+                }
             }
         } else { // A leaf node
             for (int index = 0; index < a_node->m_count; ++index) {
                 Branch* curBranch = &a_node->m_branch[index];
 
-                a_stream.ReadArray (curBranch->m_rect.m_min, NUMDIMS);
-                a_stream.ReadArray (curBranch->m_rect.m_max, NUMDIMS);
-
-                a_stream.Read (curBranch->m_data);
+                if (!a_stream.ReadArray (curBranch->m_rect.m_min, NUMDIMS)
+                        || !a_stream.ReadArray (curBranch->m_rect.m_max, NUMDIMS)
+                        || !a_reader (a_stream, curBranch->m_data)) {
+                    a_node->m_count = index;
+                    return false;
+                }
             }
         }
 
-        return true; // Should do more error checking on I/O operations
+        return true;
     }
 
 
@@ -630,6 +1102,14 @@ namespace pal {
 
     RTREE_TEMPLATE
     bool RTREE_QUAL::Save (RTFileStream& a_stream) {
+        RawWriter raw;
+        return Save (a_stream, raw);
+    }
+
+
+    RTREE_TEMPLATE
+    template <class WRITER>
+    bool RTREE_QUAL::Save (RTFileStream& a_stream, WRITER& a_writer) {
         // Write some kind of header
         int dataFileId = ('R' << 0) | ('T' << 8) | ('R' << 16) | ('E' << 24);
         int dataSize = sizeof (DATATYPE);
@@ -648,38 +1128,36 @@ namespace pal {
         a_stream.Write (dataMinNodes);
 
         // Recursively save tree
-        bool result = SaveRec (m_root, a_stream);
+        bool result = SaveRec (m_root, a_stream, a_writer);
 
         return result;
     }
 
 
     RTREE_TEMPLATE
-    bool RTREE_QUAL::SaveRec (Node* a_node, RTFileStream& a_stream) {
-        a_stream.Write (a_node->m_level);
-        a_stream.Write (a_node->m_count);
+    template <class WRITER>
+    bool RTREE_QUAL::SaveRec (Node* a_node, RTFileStream& a_stream, WRITER& a_writer) {
+        bool result = a_stream.Write (a_node->m_level) && a_stream.Write (a_node->m_count);
 
         if (a_node->IsInternalNode()) { // not a leaf node
-            for (int index = 0; index < a_node->m_count; ++index) {
+            for (int index = 0; result && index < a_node->m_count; ++index) {
                 Branch* curBranch = &a_node->m_branch[index];
 
-                a_stream.WriteArray (curBranch->m_rect.m_min, NUMDIMS);
-                a_stream.WriteArray (curBranch->m_rect.m_max, NUMDIMS);
-
-                SaveRec (curBranch->m_child, a_stream);
+                result = a_stream.WriteArray (curBranch->m_rect.m_min, NUMDIMS)
+                         && a_stream.WriteArray (curBranch->m_rect.m_max, NUMDIMS)
+                         && SaveRec (curBranch->m_child, a_stream, a_writer);
             }
         } else { // A leaf node
-            for (int index = 0; index < a_node->m_count; ++index) {
+            for (int index = 0; result && index < a_node->m_count; ++index) {
                 Branch* curBranch = &a_node->m_branch[index];
 
-                a_stream.WriteArray (curBranch->m_rect.m_min, NUMDIMS);
-                a_stream.WriteArray (curBranch->m_rect.m_max, NUMDIMS);
-
-                a_stream.Write (curBranch->m_data);
+                result = a_stream.WriteArray (curBranch->m_rect.m_min, NUMDIMS)
+                         && a_stream.WriteArray (curBranch->m_rect.m_max, NUMDIMS)
+                         && a_writer (a_stream, curBranch->m_data);
             }
         }
 
-        return true; // Should do more error checking on I/O operations
+        return result;
     }
 
 
@@ -695,13 +1173,11 @@ namespace pal {
 
     RTREE_TEMPLATE
     void RTREE_QUAL::Reset() {
-#ifdef RTREE_DONT_USE_MEMPOOLS
-        // Delete all existing nodes
-        RemoveAllRec (m_root);
-#else // RTREE_DONT_USE_MEMPOOLS
-        // Just reset memory pools.  We are not using complex types
-        // EXAMPLE
-#endif // RTREE_DONT_USE_MEMPOOLS
+        // Just reset memory pools if the allocator can, we are not using complex types
+        if (!m_nodeAllocator.Release()) {
+            // Delete all existing nodes
+            RemoveAllRec (m_root);
+        }
     }
 
 
@@ -721,12 +1197,7 @@ namespace pal {
 
     RTREE_TEMPLATE
     typename RTREE_QUAL::Node* RTREE_QUAL::AllocNode() {
-        Node* newNode;
-#ifdef RTREE_DONT_USE_MEMPOOLS
-        newNode = new Node;
-#else // RTREE_DONT_USE_MEMPOOLS
-        // EXAMPLE
-#endif // RTREE_DONT_USE_MEMPOOLS
+        Node* newNode = (Node*) m_nodeAllocator.Alloc();
         InitNode (newNode);
         return newNode;
     }
@@ -736,11 +1207,7 @@ namespace pal {
     void RTREE_QUAL::FreeNode (Node* a_node) {
         ASSERT (a_node);
 
-#ifdef RTREE_DONT_USE_MEMPOOLS
-        delete a_node;
-#else // RTREE_DONT_USE_MEMPOOLS
-        // EXAMPLE
-#endif // RTREE_DONT_USE_MEMPOOLS
+        m_nodeAllocator.Free (a_node);
     }
 
 
@@ -748,21 +1215,13 @@ namespace pal {
 // store Nodes that are too empty.
     RTREE_TEMPLATE
     typename RTREE_QUAL::ListNode* RTREE_QUAL::AllocListNode() {
-#ifdef RTREE_DONT_USE_MEMPOOLS
-        return new ListNode;
-#else // RTREE_DONT_USE_MEMPOOLS
-        // EXAMPLE
-#endif // RTREE_DONT_USE_MEMPOOLS
+        return (ListNode*) m_listNodeAllocator.Alloc();
     }
 
 
     RTREE_TEMPLATE
     void RTREE_QUAL::FreeListNode (ListNode* a_listNode) {
-#ifdef RTREE_DONT_USE_MEMPOOLS
-        delete a_listNode;
-#else // RTREE_DONT_USE_MEMPOOLS
-        // EXAMPLE
-#endif // RTREE_DONT_USE_MEMPOOLS
+        m_listNodeAllocator.Free (a_listNode);
     }
 
 
@@ -1353,41 +1812,6 @@ namespace pal {
     }
 
 
-// Search in an index tree or subtree for all data retangles that overlap the argument rectangle.
-    RTREE_TEMPLATE
-    bool RTREE_QUAL::Search (Node* a_node, Rect* a_rect, int& a_foundCount, bool a_resultCallback (DATATYPE a_data, void* a_context), void* a_context) {
-        ASSERT (a_node);
-        ASSERT (a_node->m_level >= 0);
-        ASSERT (a_rect);
-
-        if (a_node->IsInternalNode()) { // This is an internal node in the tree
-            for (int index = 0; index < a_node->m_count; ++index) {
-                if (Overlap (a_rect, &a_node->m_branch[index].m_rect)) {
-                    if (!Search (a_node->m_branch[index].m_child, a_rect, a_foundCount, a_resultCallback, a_context)) {
-                        return false; // Don't continue searching
-                    }
-                }
-            }
-        } else { // This is a leaf node
-            for (int index = 0; index < a_node->m_count; ++index) {
-                if (Overlap (a_rect, &a_node->m_branch[index].m_rect)) {
-                    DATATYPE& id = a_node->m_branch[index].m_data;
-
-                    // NOTE: There are different ways to return results.  Here's where to modify
-                    if (&a_resultCallback) {
-                        ++a_foundCount;
-                        if (!a_resultCallback (id, a_context)) {
-                            return false; // Don't continue searching
-                        }
-                    }
-                }
-            }
-        }
-
-        return true; // Continue searching
-    }
-
-
 #undef RTREE_TEMPLATE
 #undef RTREE_QUAL
 
@@ -41,6 +41,12 @@
 #define LOCK(mutex)  (pthread_mutex_lock(&mutex))
 #define UNLOCK(mutex)  (pthread_mutex_unlock(&mutex))
 #define DESTROY_MUTEX(mutex) (pthread_mutex_destroy(&mutex))
+
+#define COND_TYPE pthread_cond_t
+#define CREATE_COND(cond) (pthread_cond_init(&cond, NULL))
+#define WAIT_COND(cond, mutex) (pthread_cond_wait(&cond, &mutex))
+#define BROADCAST_COND(cond) (pthread_cond_broadcast(&cond))
+#define DESTROY_COND(cond) (pthread_cond_destroy(&cond))
 #endif
 
 #ifdef _HAVE_WINDOWS_H_
@@ -50,16 +56,26 @@
 #define LOCK(mutex)  (WaitForSingleObject(mutex, INFINITE))
 #define UNLOCK(mutex)  (ReleaseMutex(mutex))
 #define DESTROY_MUTEX(mutex) (CloseHandle(mutex))
+
+// parallelRun() runs jobs on the calling thread only, nobody else can signal
+#define COND_TYPE int
+#define CREATE_COND(cond) (cond = 0)
+#define WAIT_COND(cond, mutex) (ReleaseMutex(mutex), Sleep(0), WaitForSingleObject(mutex, INFINITE))
+#define BROADCAST_COND(cond) ((void) cond)
+#define DESTROY_COND(cond) ((void) cond)
 #endif
 
 namespace pal {
 
     typedef THREAD_TYPE MUTEX_T;
+    typedef COND_TYPE COND_T;
 
     class SimpleMutex {
     private:
         MUTEX_T mutex;
 
+        friend class SimpleCondition;
+
     public:
         SimpleMutex() {
             CREATE_MUTEX (mutex);
@@ -78,6 +94,39 @@ namespace pal {
         }
     };
 
+    /**
+     * \brief condition variable, waited for with a locked SimpleMutex
+     */
+    class SimpleCondition {
+    private:
+        COND_T cond;
+
+    public:
+        SimpleCondition() {
+            CREATE_COND (cond);
+        }
+
+        ~SimpleCondition() {
+            DESTROY_COND (cond);
+        }
+
+        /**
+         * \brief unlock mutex until the condition is signalled, then lock it again
+         *
+         * Wake ups may be spurious, the caller checks its condition again.
+         */
+        void wait (SimpleMutex *mutex) {
+            WAIT_COND (cond, mutex->mutex);
+        }
+
+        /**
+         * \brief wake up every waiting thread
+         */
+        void broadcast() {
+            BROADCAST_COND (cond);
+        }
+    };
+
 } // namespace
 
 #endif
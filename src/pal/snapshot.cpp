@@ -0,0 +1,186 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+#include <geos_c.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "snapshot.h"
+
+namespace pal {
+
+    bool checkSnapshotHeader (const char *data, size_t size) {
+        const SnapshotHeader *header = (const SnapshotHeader*) data;
+
+        if (size < sizeof (SnapshotHeader)
+                || memcmp (header->magic, SNAPSHOT_MAGIC, sizeof (header->magic)) != 0
+                || header->version != SNAPSHOT_VERSION
+                || header->byteOrder != 0x01020304
+                || header->featureSize != (int) sizeof (SnapshotFeature)
+                || header->holeSize != (int) sizeof (SnapshotHole)
+                || header->nbFeatures < 0 || header->nbHoles < 0)
+            return false;
+
+        // sections follow each other
+        if (header->features < (int64_t) sizeof (SnapshotHeader)
+                || header->holes < header->features + (int64_t) header->nbFeatures * (int64_t) sizeof (SnapshotFeature)
+                || header->ids < header->holes + (int64_t) header->nbHoles * (int64_t) sizeof (SnapshotHole)
+                || header->coordinates <= header->ids
+                || header->rtree < header->coordinates
+                || header->rtree > (int64_t) size)
+            return false;
+
+        if (header->features % 8 || header->holes % 8 || header->coordinates % 8)
+            return false;
+
+        // every id is terminated within the section
+        if (data[header->coordinates - 1] != '\0'
+                || header->name < 0 || header->name >= header->coordinates - header->ids)
+            return false;
+
+        return true;
+    }
+
+
+    bool checkSnapshotFeature (const SnapshotHeader *header, const SnapshotFeature *sf) {
+        int64_t nbCoords = (header->rtree - header->coordinates) / sizeof (double);
+        int i;
+
+        if (sf->uid < 0 || sf->uid >= header->coordinates - header->ids)
+            return false;
+
+        if (sf->type != GEOS_POINT && sf->type != GEOS_LINESTRING && sf->type != GEOS_POLYGON)
+            return false;
+
+        if (sf->nbPoints < 1 || sf->nbHoles < 0 || sf->firstHole < 0 || sf->firstHole > header->nbHoles - sf->nbHoles)
+            return false;
+
+        if (header->withCoordinates) {
+            if (sf->coord < 0 || sf->coord > nbCoords - 2 * (int64_t) sf->nbPoints)
+                return false;
+        } else if (sf->coord != -1) {
+            return false;
+        }
+
+        const SnapshotHole *holes = (const SnapshotHole*) ( (const char*) header + header->holes);
+        for (i = sf->firstHole;i < sf->firstHole + sf->nbHoles;i++) {
+            if (holes[i].nbPoints < 1)
+                return false;
+            if (header->withCoordinates) {
+                if (holes[i].coord < 0 || holes[i].coord > nbCoords - 2 * (int64_t) holes[i].nbPoints)
+                    return false;
+            } else if (holes[i].coord != -1) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    MappedFile::MappedFile () {
+        data = NULL;
+        size = 0;
+    }
+
+#ifndef _WIN32
+
+    MappedFile::~MappedFile() {
+        if (data)
+            munmap (data, size);
+    }
+
+    bool MappedFile::open (const char *fileName) {
+        struct stat st;
+        int fd = ::open (fileName, O_RDONLY);
+
+        if (fd < 0)
+            return false;
+
+        if (fstat (fd, &st) != 0 || st.st_size == 0) {
+            close (fd);
+            return false;
+        }
+
+        void *ptr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close (fd);
+
+        if (ptr == MAP_FAILED)
+            return false;
+
+        data = (char*) ptr;
+        size = st.st_size;
+        return true;
+    }
+
+#else
+
+    MappedFile::~MappedFile() {
+        delete[] data;
+    }
+
+    bool MappedFile::open (const char *fileName) {
+        FILE *file = fopen (fileName, "rb");
+
+        if (!file)
+            return false;
+
+        fseek (file, 0, SEEK_END);
+        long length = ftell (file);
+        fseek (file, 0, SEEK_SET);
+
+        if (length <= 0) {
+            fclose (file);
+            return false;
+        }
+
+        // new[] is aligned for doubles
+        data = new char[length];
+        size = length;
+        if (fread (data, length, 1, file) != 1) {
+            delete[] data;
+            data = NULL;
+            size = 0;
+        }
+        fclose (file);
+
+        return data != NULL;
+    }
+
+#endif
+
+} // namespace pal
@@ -0,0 +1,172 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace pal {
+
+#define SNAPSHOT_MAGIC "PALSNAP"
+#define SNAPSHOT_VERSION 1
+
+    /**
+     * \brief layer snapshot file header
+     *
+     * A snapshot is written by Layer::saveSnapshot() and mapped by
+     * Pal::loadLayer(). All sections are 8 bytes aligned and used in place,
+     * so a snapshot is only valid on the architecture which wrote it.
+     */
+    typedef struct _snapshotheader {
+        char magic[8];
+        int version;
+        int byteOrder;      // 0x01020304
+        int featureSize;    // sizeof (SnapshotFeature)
+        int holeSize;       // sizeof (SnapshotHole)
+
+        int nbFeatures;
+        int nbHoles;
+        int withCoordinates;
+
+        // layer settings
+        int arrangement;
+        int labelUnit;
+        int obstacle;
+        int active;
+        int toLabel;
+        double minScale;
+        double maxScale;
+        double priority;
+
+        int64_t name;        // layer name, offset in the ids section
+
+        // sections, offsets from the beginning of the file
+        int64_t features;    // SnapshotFeature[nbFeatures], in layer order
+        int64_t holes;       // SnapshotHole[nbHoles]
+        int64_t ids;         // '\0' terminated strings
+        int64_t coordinates; // doubles, x of a ring is followed by its y
+        int64_t rtree;       // RTree::Save() stream up to the end of the file, features are given by their rank
+    } SnapshotHeader;
+
+    /**
+     * \brief one part of a registered geometry
+     */
+    typedef struct _snapshotfeature {
+        double xmin;
+        double ymin;
+        double xmax;
+        double ymax;
+
+        double label_x;
+        double label_y;
+
+        int64_t uid;         // offset in the ids section, shared by parts of a geometry (which are consecutive)
+        int64_t coord;       // # doubles before x in the coordinates section, -1 when not saved
+
+        int type;
+        int part;
+        int nPart;
+        int distlabel;
+
+        int nbPoints;
+        int nbHoles;
+        int firstHole;       // rank of the first hole in the holes section
+        int pad;
+    } SnapshotFeature;
+
+    /**
+     * \brief hole of a polygon
+     */
+    typedef struct _snapshothole {
+        double xmin;
+        double ymin;
+        double xmax;
+        double ymax;
+
+        int64_t coord;       // # doubles before x in the coordinates section, -1 when not saved
+
+        int nbPoints;
+        int pad;
+    } SnapshotHole;
+
+
+    /**
+     * \brief check a snapshot was written by this version of Pal and its sections are in the file
+     * @param data file content
+     * @param size file size
+     */
+    bool checkSnapshotHeader (const char *data, size_t size);
+
+    /**
+     * \brief check ids, holes and coordinates of a feature are in their sections
+     * @param header checked by checkSnapshotHeader()
+     * @param sf feature of the snapshot
+     */
+    bool checkSnapshotFeature (const SnapshotHeader *header, const SnapshotFeature *sf);
+
+
+    /**
+     * \brief read-only file mapped in memory
+     *
+     * The file is read in a buffer where mmap() is not available.
+     */
+    class MappedFile {
+    private:
+        char *data;
+        size_t size;
+
+    public:
+        MappedFile ();
+
+        /**
+         * \brief unmap the file, pointers to its content become invalid
+         */
+        ~MappedFile();
+
+        /**
+         * \brief map a file
+         * @param fileName file to map
+         * @return false if the file can't be read
+         */
+        bool open (const char *fileName);
+
+        const char *getData () {
+            return data;
+        }
+
+        size_t getSize () {
+            return size;
+        }
+    };
+
+} // namespace pal
+
+#endif
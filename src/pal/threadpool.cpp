@@ -0,0 +1,119 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef _HAVE_PTHREAD_
+#include <pthread.h>
+#endif
+
+#include "simplemutex.h"
+#include "threadpool.h"
+
+namespace pal {
+
+#ifdef _HAVE_PTHREAD_
+    typedef struct {
+        JobFunction job;
+        void *ctx;
+        int nbJobs;
+        int nextJob;
+        SimpleMutex *mutex;
+    } PoolContext;
+
+    typedef struct {
+        PoolContext *pool;
+        int thread;
+    } WorkerContext;
+
+    void *poolWorker (void *ctx) {
+        WorkerContext *worker = (WorkerContext*) ctx;
+        PoolContext *pool = worker->pool;
+        int job;
+
+        for (;;) {
+            pool->mutex->lock();
+            job = pool->nextJob++;
+            pool->mutex->unlock();
+
+            if (job >= pool->nbJobs)
+                break;
+
+            pool->job (job, worker->thread, pool->ctx);
+        }
+        return NULL;
+    }
+#endif
+
+    void parallelRun (int nbThreads, int nbJobs, JobFunction job, void *ctx) {
+        int i;
+
+        if (nbThreads > nbJobs)
+            nbThreads = nbJobs;
+
+#ifdef _HAVE_PTHREAD_
+        if (nbThreads > 1) {
+            PoolContext pool;
+            pool.job = job;
+            pool.ctx = ctx;
+            pool.nbJobs = nbJobs;
+            pool.nextJob = 0;
+            pool.mutex = new SimpleMutex();
+
+            pthread_t *threads = new pthread_t[nbThreads];
+            WorkerContext *workers = new WorkerContext[nbThreads];
+
+            // the calling thread is the worker #0
+            int nbStarted = 1;
+            for (i = 1;i < nbThreads;i++) {
+                workers[i].pool = &pool;
+                workers[i].thread = i;
+                if (pthread_create (&threads[i], NULL, poolWorker, (void*) &workers[i]) == 0)
+                    nbStarted++;
+                else
+                    break;
+            }
+
+            workers[0].pool = &pool;
+            workers[0].thread = 0;
+            poolWorker ( (void*) &workers[0]);
+
+            for (i = 1;i < nbStarted;i++)
+                pthread_join (threads[i], NULL);
+
+            delete[] workers;
+            delete[] threads;
+            delete pool.mutex;
+            return;
+        }
+#endif
+
+        for (i = 0;i < nbJobs;i++)
+            job (i, 0, ctx);
+    }
+
+} // namespace pal
@@ -0,0 +1,60 @@
+/*
+ *   libpal - Automated Placement of Labels Library     http://pal.heig-vd.ch
+ *
+ *
+ *   Copyright (C) 2007, 2008 MIS-TIC, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *   Copyright (C) 2008, 2009 IICT-SYSIN, HEIG-VD (University of Applied Sciences Western Switzerland)
+ *
+ *
+ * This file is part of libpal.
+ *
+ * libpal is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libpal is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libpal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+namespace pal {
+
+    /**
+     * \brief a job to run through parallelRun()
+     *
+     * @param job index of the job to process (0 <= job < nbJobs)
+     * @param thread index of the thread running the job (0 <= thread < nbThreads)
+     * @param ctx user context given to parallelRun()
+     */
+    typedef void (*JobFunction) (int job, int thread, void *ctx);
+
+    /**
+     * \brief Run nbJobs jobs on a pool of at most nbThreads threads
+     *
+     * Jobs are handed out in increasing order to the first idle thread;
+     * the call returns once every job is done. When nbThreads <= 1 or when
+     * threads are not supported, jobs are run in order on the calling thread.
+     *
+     * @param nbThreads maximum # of threads to use
+     * @param nbJobs # of jobs to run
+     * @param job function to call for each job
+     * @param ctx context given to each call of job
+     */
+    void parallelRun (int nbThreads, int nbJobs, JobFunction job, void *ctx);
+
+} // namespace pal
+
+#endif
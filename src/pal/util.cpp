@@ -38,7 +38,12 @@
 #include <cstdarg>
 #include <ctime>
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
 #include <pal/layer.h>
+#include <pal/palgeometry.h>
 
 #include "internalexception.h"
 #include "util.h"
@@ -168,25 +173,6 @@ namespace pal {
         return true;
     }
 
-    bool countFullOverlapCallback (LabelPosition *lp, void *ctx) {
-        LabelPosition *lp2 = ( (CountContext*) ctx)->lp;
-        double *cost = ( (CountContext*) ctx)->cost;
-        //int *feat = ((CountContext*)ctx)->feat;
-        int *nbOv = ( (CountContext*) ctx)->nbOv;
-        double *inactiveCost = ( (CountContext*) ctx)->inactiveCost;
-        if (lp2->isInConflict (lp)) {
-#ifdef _DEBUG_FULL_
-            std::cout <<  "count overlap : " << lp->id << "<->" << lp2->id << std::endl;
-#endif
-            (*nbOv) ++;
-            *cost += inactiveCost[lp->probFeat] + lp->cost;
-
-        }
-
-        return true;
-    }
-
-
 //inline bool ptrGeomEq (const geos::geom::Geometry *l, const geos::geom::Geometry *r){
     inline bool ptrGeomEq (const GEOSGeometry *l, const GEOSGeometry *r) {
         return l == r;
@@ -395,89 +381,198 @@ namespace pal {
 
 
 
-    LinkedList<Feat*> * splitGeom (GEOSGeometry *the_geom, const char *geom_id) {
-        LinkedList <Feat*> *fCoordQueue = new LinkedList<Feat*> (ptrFeatCompare);
-        LinkedList <Feat*> *finalQueue = new LinkedList<Feat*> (ptrFeatCompare);
+    /*
+     * \brief read coordinates of a part through PalGeometry's direct access
+     */
+    void extractSpanCoord (Feat *f, PalGeometry *userGeom, int part) {
+        int i, j, r;
 
-        LinkedList <const GEOSGeometry*> *simpleGeometries = unmulti (the_geom);
+        int nbRings = userGeom->getNbRings (part);
+        if (nbRings < 1) {
+            f->nbPoints = 0;
+            f->nbHoles = 0;
+            return;
+        }
 
-        int i, j, k, l, j2, l2;
+        const double **rx = new const double*[nbRings];
+        const double **ry = new const double*[nbRings];
+        int *stride = new int[nbRings];
+        int *nbPoints = new int[nbRings];
+
+        bool borrow = true;
+        for (r = 0;r < nbRings;r++) {
+            stride[r] = 1;
+            nbPoints[r] = userGeom->getRing (part, r, &rx[r], &ry[r], &stride[r]);
+            if (stride[r] != 1)
+                borrow = false;
+        }
 
-        const GEOSGeometry *geom;
+        f->nbHoles = (f->type == GEOS_POLYGON ? nbRings - 1 : 0);
 
-        int pt_a = -1;
-        int pt_b = -1;
-        double cX, cY;
-        double tmpX, tmpY;
+        // same checks as extractXYCoord() and splitGeom() : points must not be changed
+        int n = nbPoints[0];
+        if (borrow) {
+            for (i = 0;i < n;i++) {
+                j = (i + 1) % n;
+                if (i == j)
+                    break;
+                if (vabs (rx[0][i] - rx[0][j]) < 0.0000001 && vabs (ry[0][i] - ry[0][j]) < 0.0000001) {
+                    borrow = false;
+                    break;
+                }
+            }
+        }
+        if (borrow && f->type == GEOS_POLYGON) {
+            for (r = 0;r < nbRings && borrow;r++) {
+                if (nbPoints[r] < 3)
+                    continue; // not reordered
+                if (polygonOrientation (nbPoints[r], rx[r], ry[r]) != 1)
+                    borrow = false;
+            }
+        }
 
-        Feat *f;
+        f->borrowed = borrow;
 
-        while (simpleGeometries->size() > 0) {
-            geom = simpleGeometries->pop_front();
-            //std::cout << "    split->typeid : " << geom->getGeometryTypeId() << std::endl;
-            switch (GEOSGeomTypeId (geom)) {
-            case GEOS_MULTIPOINT:
-            case GEOS_MULTILINESTRING:
-            case GEOS_MULTIPOLYGON:
-                std::cerr << "MUTLI geometry should never occurs here" << std::endl;
-                break;
-            case GEOS_POINT:
-            case GEOS_LINESTRING:
-                f = new Feat();
-                f->geom = geom;
-                f->id = geom_id;
-                f->type = GEOSGeomTypeId (geom);
-                extractXYCoord (f);
-                fCoordQueue->push_back (f);
-                break;
-            case GEOS_POLYGON:
-                f = new Feat();
-                f->geom = geom;
-                f->id = geom_id;
-                f->type = GEOS_POLYGON;
-                extractXYCoord (f);
+        if (f->nbHoles > 0)
+            f->holes = new PointSet*[f->nbHoles];
 
-                // BUGFIX #8 by maxence -- 11/03/2008
-                if (f->nbPoints >= 3) {
-#ifdef _DEBUG_FULL_
-                    std::cout << "new polygon for " << geom_id << " (" << f->nbPoints << " pts)" << std::endl;
-                    for (i = 0;i < f->nbPoints;i++) {
-                        std::cout << f->x[i] << " ; " << f->y[i] << std::endl;
-                    }
-#endif
-                    if (reorderPolygon (f->nbPoints, f->x, f->y) == 0) {
-#ifdef _DEBUG_FULL_
-                        std::cout << "reordered: " << geom_id << " (" << f->nbPoints << " pts)" << std::endl;
-                        for (i = 0;i < f->nbPoints;i++) {
-                            std::cout << f->x[i] << " ; " << f->y[i] << std::endl;
-                        }
-#endif
-                        fCoordQueue->push_back (f);
-                    } else {
-                        std::cout << __FILE__ << ":" << __LINE__ << " Unable to reorder the polygon ..." << std::endl;
-                        for (i = 0;i < f->nbHoles;i++)
-                            delete f->holes[i];
-                        delete f->holes;
-                        delete f->x;
-                        delete f->y;
-                        delete f;
-                    }
-                } else {
-                    std::cout << "Geometry " << geom_id << " is invalid (less than 3 real points)" << std::endl;
-                    for (i = 0;i < f->nbHoles;i++)
-                        delete f->holes[i];
-                    delete f->holes;
-                    delete[] f->x;
-                    delete[] f->y;
-                    delete f;
+        for (r = 0;r < nbRings;r++) {
+            double *x;
+            double *y;
+            if (borrow) {
+                x = const_cast<double*> (rx[r]);
+                y = const_cast<double*> (ry[r]);
+            } else {
+                x = new double[nbPoints[r]];
+                y = new double[nbPoints[r]];
+                for (i = 0;i < nbPoints[r];i++) {
+                    x[i] = rx[r][i * stride[r]];
+                    y[i] = ry[r][i * stride[r]];
                 }
+            }
+
+            double xmin = DBL_MAX;
+            double xmax = -DBL_MAX;
+            double ymin = DBL_MAX;
+            double ymax = -DBL_MAX;
+
+            for (i = 0;i < nbPoints[r];i++) {
+                xmax = x[i] > xmax ? x[i] : xmax;
+                xmin = x[i] < xmin ? x[i] : xmin;
+                ymax = y[i] > ymax ? y[i] : ymax;
+                ymin = y[i] < ymin ? y[i] : ymin;
+            }
+
+            if (r == 0) {
+                f->nbPoints = nbPoints[r];
+                f->x = x;
+                f->y = y;
+                f->minmax[0] = xmin;
+                f->minmax[1] = ymin;
+                f->minmax[2] = xmax;
+                f->minmax[3] = ymax;
+            } else if (r <= f->nbHoles) {
+                PointSet *hole = new PointSet();
+                hole->holeOf = NULL;
+                hole->nbPoints = nbPoints[r];
+                hole->x = x;
+                hole->y = y;
+                hole->xmin = xmin;
+                hole->xmax = xmax;
+                hole->ymin = ymin;
+                hole->ymax = ymax;
+                if (!borrow && hole->nbPoints >= 3)
+                    reorderPolygon (hole->nbPoints, hole->x, hole->y);
+                f->holes[r-1] = hole;
+            } else if (!borrow) {
+                delete[] x;
+                delete[] y;
+            }
+        }
+
+        delete[] rx;
+        delete[] ry;
+        delete[] stride;
+        delete[] nbPoints;
+
+        if (borrow)
+            return;
+
+        // remove duplicated points, as extractXYCoord() does
+        int new_nbPoints = f->nbPoints;
+        bool *ok = new bool[new_nbPoints];
+
+        for (i = 0;i < f->nbPoints;i++) {
+            ok[i] = true;
+            j = (i + 1) % f->nbPoints;
+            if (i == j)
                 break;
-            default:
-                throw InternalException::UnknownGeometry();
+            if (vabs (f->x[i] - f->x[j]) < 0.0000001 && vabs (f->y[i] - f->y[j]) < 0.0000001) {
+                new_nbPoints--;
+                ok[i] = false;
             }
         }
 
-        delete simpleGeometries;
+        if (new_nbPoints < f->nbPoints) {
+            double *new_x = new double[new_nbPoints];
+            double *new_y = new double[new_nbPoints];
+            for (i = 0, j = 0;i < f->nbPoints;i++) {
+                if (ok[i]) {
+                    new_x[j] = f->x[i];
+                    new_y[j] = f->y[i];
+                    j++;
+                }
+            }
+            delete[] f->x;
+            delete[] f->y;
+            f->x = new_x;
+            f->y = new_y;
+            f->nbPoints = new_nbPoints;
+        }
+
+        delete[] ok;
+    }
+
+
+    bool isLabellableFeat (Feat *f) {
+        // lines and polygons need enough points
+        return ! ( (f->type == GEOS_LINESTRING && f->nbPoints < 2) ||
+                   (f->type == GEOS_POLYGON && f->nbPoints < 3));
+    }
+
+
+    void deleteFeat (Feat *f) {
+        int i;
+        for (i = 0;i < f->nbHoles;i++) {
+            if (f->borrowed) {
+                f->holes[i]->x = NULL;
+                f->holes[i]->y = NULL;
+            }
+            delete f->holes[i];
+        }
+        delete[] f->holes;
+        if (!f->borrowed) {
+            delete[] f->x;
+            delete[] f->y;
+        }
+        delete f;
+    }
+
+
+    /*
+     * \brief drop invalid polygons and reorder the other ones
+     */
+    LinkedList<Feat*> * checkFeats (LinkedList<Feat*> *fCoordQueue, const char *geom_id) {
+        LinkedList <Feat*> *finalQueue = new LinkedList<Feat*> (ptrFeatCompare);
+
+        int i, j, k, l, j2, l2;
+
+        int pt_a = -1;
+        int pt_b = -1;
+        double cX, cY;
+        double tmpX, tmpY;
+
+        Feat *f;
 
         cX = 0.0;
         cY = 0.0;
@@ -486,10 +581,29 @@ namespace pal {
             f = fCoordQueue->pop_front();
 
             if (f->type == GEOS_POLYGON) {
+                // BUGFIX #8 by maxence -- 11/03/2008
+                if (f->nbPoints < 3) {
+                    std::cout << "Geometry " << geom_id << " is invalid (less than 3 real points)" << std::endl;
+                    deleteFeat (f);
+                    continue;
+                }
+#ifdef _DEBUG_FULL_
+                std::cout << "new polygon for " << geom_id << " (" << f->nbPoints << " pts)" << std::endl;
+                for (i = 0;i < f->nbPoints;i++) {
+                    std::cout << f->x[i] << " ; " << f->y[i] << std::endl;
+                }
+#endif
+                // borrowed coordinates are already in order
+                if (!f->borrowed && reorderPolygon (f->nbPoints, f->x, f->y) != 0) {
+                    std::cout << __FILE__ << ":" << __LINE__ << " Unable to reorder the polygon ..." << std::endl;
+                    deleteFeat (f);
+                    continue;
+                }
 #ifdef _DEBUG_FULL_
-                std::cout << "New feature coordinates:" << std::endl;
-                for (i = 0;i < f->nbPoints;i++)
-                    std::cout << f->x[i] << ";" << f->y[i] << std::endl;
+                std::cout << "reordered: " << geom_id << " (" << f->nbPoints << " pts)" << std::endl;
+                for (i = 0;i < f->nbPoints;i++) {
+                    std::cout << f->x[i] << " ; " << f->y[i] << std::endl;
+                }
 #endif
 
                 // Butterfly detector
@@ -540,12 +654,7 @@ namespace pal {
                 } else {
                     //fCoordQueue->push_back(splitButterflyPolygon (f, (pt_a+1)%f->nbPoints, (pt_b+1)%f->nbPoints, cX, cY));
                     //fCoordQueue->push_back(splitButterflyPolygon (f, (pt_b+1)%f->nbPoints, (pt_a+1)%f->nbPoints, cX, cY));
-                    for (i = 0;i < f->nbHoles;i++)
-                        delete f->holes[i];
-                    delete f->holes;
-                    delete[] f->x;
-                    delete[] f->y;
-                    delete f;
+                    deleteFeat (f);
                 }
             } else {
                 finalQueue->push_back (f);
@@ -553,10 +662,88 @@ namespace pal {
 
         }
         delete fCoordQueue;
-        //delete the_geom;
         return finalQueue;
     }
 
+
+    LinkedList<Feat*> * splitGeom (GEOSGeometry *the_geom, const char *geom_id) {
+        LinkedList <Feat*> *fCoordQueue = new LinkedList<Feat*> (ptrFeatCompare);
+
+        LinkedList <const GEOSGeometry*> *simpleGeometries = unmulti (the_geom);
+
+        const GEOSGeometry *geom;
+
+        Feat *f;
+
+        while (simpleGeometries->size() > 0) {
+            geom = simpleGeometries->pop_front();
+            //std::cout << "    split->typeid : " << geom->getGeometryTypeId() << std::endl;
+            switch (GEOSGeomTypeId (geom)) {
+            case GEOS_MULTIPOINT:
+            case GEOS_MULTILINESTRING:
+            case GEOS_MULTIPOLYGON:
+                std::cerr << "MUTLI geometry should never occurs here" << std::endl;
+                break;
+            case GEOS_POINT:
+            case GEOS_LINESTRING:
+            case GEOS_POLYGON:
+                f = new Feat();
+                f->geom = geom;
+                f->id = geom_id;
+                f->type = GEOSGeomTypeId (geom);
+                extractXYCoord (f);
+                fCoordQueue->push_back (f);
+                break;
+            default:
+                throw InternalException::UnknownGeometry();
+            }
+        }
+
+        delete simpleGeometries;
+
+        //delete the_geom;
+        return checkFeats (fCoordQueue, geom_id);
+    }
+
+
+    LinkedList<Feat*> * splitUserGeom (PalGeometry *userGeom, const char *geom_id) {
+        LinkedList <Feat*> *fCoordQueue = new LinkedList<Feat*> (ptrFeatCompare);
+
+        int nbParts = userGeom->getNbParts();
+        int part;
+
+        Feat *f;
+
+        for (part = 0;part < nbParts;part++) {
+            switch (userGeom->getPartType (part)) {
+            case GEOS_POINT:
+            case GEOS_LINESTRING:
+            case GEOS_POLYGON:
+                f = new Feat();
+                f->geom = NULL;
+                f->id = geom_id;
+                f->type = userGeom->getPartType (part);
+                extractSpanCoord (f, userGeom, part);
+                fCoordQueue->push_back (f);
+                break;
+            default:
+                throw InternalException::UnknownGeometry();
+            }
+        }
+
+        return checkFeats (fCoordQueue, geom_id);
+    }
+
+    double wallTime () {
+#ifdef _WIN32
+        return double (clock()) / double (CLOCKS_PER_SEC);
+#else
+        struct timeval tv;
+        gettimeofday (&tv, NULL);
+        return double (tv.tv_sec) + double (tv.tv_usec) * 1e-6;
+#endif
+    }
+
 } // namespace
 
 
@@ -45,6 +45,7 @@ namespace pal {
     class LabelPosition;
     class Layer;
     class Feature;
+    class PalGeometry;
 
     inline bool ptrFeatureCompare (Feature * a, Feature * b) {
         return a == b;
@@ -68,6 +69,11 @@ namespace pal {
         int nbHoles;
         PointSet **holes;
 
+        /**
+         * if true, x, y and holes coordinates belong to the user geometry
+         */
+        bool borrowed;
+
     } Feat;
 
 
@@ -76,6 +82,24 @@ namespace pal {
      */
     LinkedList<Feat*> * splitGeom (GEOSGeometry *the_geom, const char *geom_id);
 
+    /**
+     * \brief split a geometry through PalGeometry's direct coordinates access
+     *
+     * Same result as splitGeom(), coordinates are borrowed from userGeom when possible.
+     * Only to be called when userGeom->getNbParts() >= 0.
+     */
+    LinkedList<Feat*> * splitUserGeom (PalGeometry *userGeom, const char *geom_id);
+
+    /**
+     * \brief true if the part becomes a Feature (see Layer::registerFeature())
+     */
+    bool isLabellableFeat (Feat *f);
+
+    /**
+     * \brief free a Feat which has not been turned into a Feature
+     */
+    void deleteFeat (Feat *f);
+
     typedef struct _feats {
         Feature *feature;
         PointSet *shape;
@@ -248,22 +272,17 @@ namespace pal {
     void tabcpy (int n, const int* const x, const int* const y,
                  const double* const prob, int *cx, int *cy, double *p);
 
+    /**
+     * \brief wall-clock time in seconds (from an unspecified origin)
+     */
+    double wallTime ();
 
-    typedef struct {
-        LabelPosition *lp;
-        int *nbOv;
-        double *cost;
-        double *inactiveCost;
-        //int *feat;
-    } CountContext;
 
     /*
      * count overlap, ctx = p_lp
      */
     bool countOverlapCallback (LabelPosition *lp, void *ctx);
 
-    bool countFullOverlapCallback (LabelPosition *lp, void *ctx);
-
 } // namespace
 
 #endif
@@ -0,0 +1,96 @@
+//
+// Deterministic labelling
+//
+
+#include <catch2/catch.hpp>
+
+#include "Geom.h"
+#include "pal/pal.h"
+#include "pal/layer.h"
+#include "pal/label.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Labels of a grid of squares whose labels overlap their neighbours
+static std::vector<std::string> labelGrid (pal::SearchMethod method, int nbThreads, int nbStarts)
+{
+    const int num = 10;
+    const double dx = 100;
+
+    pal::Pal pal;
+    pal.setSearch(method);
+    pal.setNbThreads(nbThreads);
+    pal.setNbStarts(nbStarts);
+    pal.setDeterministic(true);
+    pal.setSeed(42);
+
+    pal::Layer *layer = pal.addLayer("main", -1, -1, pal::P_FREE, pal::PIXEL, 1, false, true, true);
+
+    for (int y = 0; y < num; ++y) {
+        for (int x = 0; x < num; ++x) {
+            std::ostringstream wkt;
+            std::ostringstream id;
+
+            id << "G:" << (y * num + x);
+            wkt << "POLYGON((" << x * dx << " " << y * dx
+                << "," << (x + 1) * dx << " " << y * dx
+                << "," << (x + 1) * dx << " " << (y + 1) * dx
+                << "," << x * dx << " " << (y + 1) * dx
+                << "," << x * dx << " " << y * dx << "))";
+
+            layer->registerFeature(id.str().c_str(), new Geom(wkt.str().c_str()), 100, 33);
+        }
+    }
+
+    pal::PalStat *stats;
+    double bbox[4] = {0, 0, num * dx, num * dx};
+
+    std::list<pal::Label*> *labels = pal.labeller(5000, bbox, &stats, false);
+
+    std::vector<std::string> result;
+    for (auto label : *labels) {
+        std::ostringstream line;
+        line.precision(17);
+        line << label->getFeatureId() << " " << label->getOrigX() << " " << label->getOrigY()
+             << " " << label->getRotation();
+        result.push_back(line.str());
+        delete label;
+    }
+
+    delete labels;
+    delete stats;
+    return result;
+}
+
+TEST_CASE("Deterministic labelling", "Same labels whatever the number of threads")
+{
+    const pal::SearchMethod methods[] = {pal::CHAIN, pal::POPMUSIC_TABU_CHAIN, pal::POPMUSIC_TABU, pal::POPMUSIC_CHAIN,
+                                         pal::BRANCH_AND_BOUND};
+    const int threads[] = {2, 8, 32};
+
+    for (auto method : methods) {
+        INFO("search method " << method);
+        auto reference = labelGrid(method, 1, 1);
+        REQUIRE_FALSE(reference.empty());
+
+        for (int nbThreads : threads) {
+            INFO(nbThreads << " threads");
+            REQUIRE(labelGrid(method, nbThreads, 1) == reference);
+        }
+    }
+}
+
+TEST_CASE("Deterministic multi-start labelling", "Same labels whatever the number of threads")
+{
+    const int threads[] = {2, 8, 32};
+
+    auto reference = labelGrid(pal::POPMUSIC_CHAIN, 1, 4);
+    REQUIRE_FALSE(reference.empty());
+
+    for (int nbThreads : threads) {
+        INFO(nbThreads << " threads");
+        REQUIRE(labelGrid(pal::POPMUSIC_CHAIN, nbThreads, 4) == reference);
+    }
+}
@@ -0,0 +1,172 @@
+//
+// Branch and bound over small conflict components
+//
+
+#include <catch2/catch.hpp>
+
+#include "Geom.h"
+#include "pal/pal.h"
+#include "pal/layer.h"
+#include "problem.h"
+
+#include <cfloat>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace pal {
+
+    // Problem of a layer, searched without Pal::labeller()
+    class ExactSearchTest {
+    public:
+        Problem *prob;
+
+        ExactSearchTest (Pal &pal, double bbox[4], double scale) {
+            char name[] = "cluster";
+            char *layersName[1] = {name};
+            double layersFactor[1] = {0.5};
+
+            prob = pal.extract (1, layersName, layersFactor, bbox[0], bbox[1], bbox[2], bbox[3], scale, NULL, NULL);
+            REQUIRE (prob != NULL);
+            prob->displayAll = false;
+            prob->init_sol_falp();
+        }
+
+        ~ExactSearchTest() {
+            delete prob;
+        }
+
+        int nbComponents() {
+            return prob->nbComponents;
+        }
+
+        int componentSize (int c) {
+            return prob->componentStart[c+1] - prob->componentStart[c];
+        }
+
+        // cost of the whole solution, kept up to date by setLabel()
+        double cost() {
+            return prob->sol->cost;
+        }
+
+        // every option of every feature of component c, the labels are restored
+        double bruteForce (int c) {
+            std::vector<int> initial (prob->sol->s, prob->sol->s + prob->nbft);
+            double best = DBL_MAX;
+
+            enumerate (c, prob->componentStart[c], best);
+
+            for (int i = prob->componentStart[c]; i < prob->componentStart[c+1]; i++)
+                prob->setLabel (prob->componentFeats[i], initial[prob->componentFeats[i]]);
+            return best;
+        }
+
+        void enumerate (int c, int i, double &best) {
+            if (i == prob->componentStart[c+1]) {
+                if (prob->sol->cost < best)
+                    best = prob->sol->cost;
+                return;
+            }
+            int f = prob->componentFeats[i];
+            for (int k = -1; k < prob->featNbLp[f]; k++) {
+                prob->setLabel (f, k < 0 ? -1 : prob->featStartId[f] + k);
+                enumerate (c, i + 1, best);
+            }
+        }
+
+        std::vector<bool> exactSearch (int maxSize, long maxNodes) {
+            bool *solved = new bool[prob->nbComponents];
+            prob->exactSearch (maxSize, solved, maxNodes);
+            std::vector<bool> result (solved, solved + prob->nbComponents);
+            delete[] solved;
+            return result;
+        }
+    };
+
+}
+
+// Towns crowded around a point, with labels larger than their spacing
+static void addCluster (pal::Layer *layer, int num, double cx, double cy, unsigned seed)
+{
+    for (int i = 0; i < num; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double dx = (seed >> 8) % 200 / 10.0;
+        seed = seed * 1103515245u + 12345u;
+        double dy = (seed >> 8) % 200 / 10.0;
+
+        std::ostringstream wkt;
+        std::ostringstream id;
+        id << "T:" << cx << ":" << i;
+        wkt << "POINT(" << cx + dx << " " << cy + dy << ")";
+        layer->registerFeature(id.str().c_str(), new Geom(wkt.str().c_str()), 30 + i % 3 * 5, 10);
+    }
+}
+
+typedef struct {
+    double initial;  // cost of the initial solution
+    double optimal;  // brute force
+    double cost;     // cost after the exact search
+    bool solved;
+} ClusterResult;
+
+static ClusterResult solveCluster (unsigned seed, long maxNodes)
+{
+    pal::Pal pal;
+    pal.setPointP(4);
+    pal::Layer *layer = pal.addLayer("cluster", -1, -1, pal::P_POINT, pal::PIXEL, 0.5, false, true, true);
+    addCluster(layer, 8, 0, 0, seed);
+
+    double bbox[4] = {-100, -100, 150, 150};
+    pal::ExactSearchTest test(pal, bbox, 1000);
+
+    // the dense component
+    int c = 0;
+    while (c < test.nbComponents() && test.componentSize(c) < 2)
+        c++;
+    REQUIRE(c < test.nbComponents());
+
+    ClusterResult result;
+    result.initial = test.cost();
+    result.optimal = test.bruteForce(c);
+    REQUIRE(test.cost() == Approx(result.initial).epsilon(0).margin(1e-9));
+    result.solved = test.exactSearch(test.componentSize(c), maxNodes)[c];
+    result.cost = test.cost();
+    return result;
+}
+
+static const unsigned seeds[] = {1, 7, 42, 1234};
+
+TEST_CASE("Exact search", "Branch and bound finds the optimal labels")
+{
+    int nbImproved = 0;
+
+    for (auto seed : seeds) {
+        INFO("seed " << seed);
+        ClusterResult result = solveCluster(seed, 100000);
+
+        REQUIRE(result.solved);
+        REQUIRE(result.cost == Approx(result.optimal).epsilon(0).margin(1e-9));
+        if (result.optimal < result.initial - 1e-9)
+            nbImproved++;
+    }
+
+    // the initial solution is not always optimal
+    CHECK(nbImproved > 0);
+}
+
+TEST_CASE("Exact search node limit", "The best labels found are kept")
+{
+    int nbUnsolved = 0;
+
+    for (auto seed : seeds) {
+        INFO("seed " << seed);
+        ClusterResult result = solveCluster(seed, 2);
+
+        REQUIRE(result.cost <= result.initial + 1e-9);
+        REQUIRE(result.cost >= result.optimal - 1e-9);
+        if (!result.solved)
+            nbUnsolved++;
+    }
+
+    CHECK(nbUnsolved > 0);
+}
@@ -0,0 +1,135 @@
+//
+// Layer features lookup table
+//
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include "hashtable.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> makeKeys (int num)
+{
+    std::vector<std::string> keys;
+    keys.reserve(num);
+
+    for (int i = 0; i < num; ++i) {
+        std::ostringstream id;
+        id << "G:" << i;
+        keys.push_back(id.str());
+    }
+    return keys;
+}
+
+TEST_CASE("HashTable", "Open addressing features lookup")
+{
+    pal::HashTable<int> table(4);
+    auto keys = makeKeys(10000);
+
+    for (int i = 0; i < 10000; ++i)
+        REQUIRE(table.insertItem(keys[i].c_str(), i));
+    REQUIRE(table.size() == 10000);
+
+    SECTION("Find") {
+        for (int i = 0; i < 10000; ++i) {
+            int *data = table.find(keys[i].c_str());
+            REQUIRE(data != nullptr);
+            REQUIRE(*data == i);
+        }
+        REQUIRE(table.find("G:-1") == nullptr);
+    }
+
+    SECTION("Replace") {
+        REQUIRE_FALSE(table.insertItem("G:42", -42));
+        REQUIRE(table.size() == 10000);
+        REQUIRE(*table.find("G:42") == -42);
+    }
+
+    SECTION("Batch find") {
+        const char *batch[3] = {"G:7", "unknown", "G:9999"};
+        int *data[3];
+        table.find(3, batch, data);
+        REQUIRE(*data[0] == 7);
+        REQUIRE(data[1] == nullptr);
+        REQUIRE(*data[2] == 9999);
+    }
+
+    SECTION("Remove") {
+        for (int i = 0; i < 10000; i += 2)
+            REQUIRE(table.removeElement(keys[i].c_str()));
+        REQUIRE_FALSE(table.removeElement(keys[0].c_str()));
+        REQUIRE(table.size() == 5000);
+
+        for (int i = 0; i < 10000; ++i) {
+            int *data = table.find(keys[i].c_str());
+            if (i % 2 == 0) {
+                REQUIRE(data == nullptr);
+            } else {
+                REQUIRE(data != nullptr);
+                REQUIRE(*data == i);
+            }
+        }
+    }
+}
+
+static void benchHashTable (int num)
+{
+    auto keys = makeKeys(num);
+    std::vector<const char*> ptrs(num);
+    for (int i = 0; i < num; ++i)
+        ptrs[i] = keys[i].c_str();
+
+    std::ostringstream name;
+    name << num << " keys";
+
+    BENCHMARK_ADVANCED("Insert " + name.str())(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            pal::HashTable<int> table(5281);
+            for (int i = 0; i < num; ++i)
+                table.insertItem(ptrs[i], i);
+            return table.size();
+        });
+    };
+
+    pal::HashTable<int> table(5281);
+    for (int i = 0; i < num; ++i)
+        table.insertItem(ptrs[i], i);
+
+    BENCHMARK("Find " + name.str()) {
+        long sum = 0;
+        for (int i = 0; i < num; ++i)
+            sum += *table.find(ptrs[i]);
+        return sum;
+    };
+
+    BENCHMARK_ADVANCED("Batch find " + name.str())(Catch::Benchmark::Chronometer meter) {
+        const int batchSize = 64;
+        std::vector<int*> data(batchSize);
+        meter.measure([&] {
+            long sum = 0;
+            for (int i = 0; i < num; i += batchSize) {
+                int n = (num - i < batchSize ? num - i : batchSize);
+                table.find(n, &ptrs[i], data.data());
+                for (int j = 0; j < n; ++j)
+                    sum += *data[j];
+            }
+            return sum;
+        });
+    };
+}
+
+TEST_CASE("HashTable benchmark", "[.][benchmark]")
+{
+    SECTION("10k keys") {
+        benchHashTable(10000);
+    }
+    SECTION("1M keys") {
+        benchHashTable(1000000);
+    }
+    SECTION("10M keys") {
+        benchHashTable(10000000);
+    }
+}
@@ -0,0 +1,217 @@
+//
+// RTree nodes allocators
+//
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include "rtree.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+typedef pal::RTree<intptr_t, double, 2, double, 8, 4, pal::RTreeHeap> HeapTree;
+typedef pal::RTree<intptr_t, double, 2, double, 8, 4, pal::RTreePool> PoolTree;
+
+struct Box {
+    double min[2];
+    double max[2];
+};
+
+// Pseudo random label candidates, as extracted around features
+static std::vector<Box> makeBoxes (int num, unsigned seed)
+{
+    std::vector<Box> boxes(num);
+
+    for (int i = 0; i < num; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double x = (seed >> 8) % 10000;
+        seed = seed * 1103515245u + 12345u;
+        double y = (seed >> 8) % 10000;
+        boxes[i].min[0] = x;
+        boxes[i].min[1] = y;
+        boxes[i].max[0] = x + 10 + i % 30;
+        boxes[i].max[1] = y + 5 + i % 7;
+    }
+    return boxes;
+}
+
+template <class TREE>
+static std::vector<intptr_t> search (TREE &tree, const Box &box)
+{
+    int capacity = 0;
+    intptr_t *found = nullptr;
+    int n = tree.Collect(box.min, box.max, &found, &capacity);
+
+    std::vector<intptr_t> ids(found, found + n);
+    delete[] found;
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+template <class TREE>
+static void fill (TREE &tree, const std::vector<Box> &boxes, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+        tree.Insert(boxes[i].min, boxes[i].max, i);
+}
+
+TEST_CASE("RTree allocators", "Pooled nodes match heap nodes")
+{
+    auto boxes = makeBoxes(5000, 42);
+    auto queries = makeBoxes(200, 7);
+    for (auto &q : queries) {
+        q.max[0] += 200;
+        q.max[1] += 200;
+    }
+
+    HeapTree heap;
+    PoolTree pool;
+    fill(heap, boxes, 0, 5000);
+    fill(pool, boxes, 0, 5000);
+    REQUIRE(pool.Count() == 5000);
+
+    SECTION("Search") {
+        for (auto &q : queries)
+            REQUIRE(search(pool, q) == search(heap, q));
+    }
+
+    SECTION("Remove") {
+        for (int i = 0; i < 5000; i += 3) {
+            heap.Remove(boxes[i].min, boxes[i].max, i);
+            pool.Remove(boxes[i].min, boxes[i].max, i);
+        }
+        REQUIRE(pool.Count() == heap.Count());
+        for (auto &q : queries)
+            REQUIRE(search(pool, q) == search(heap, q));
+
+        // freed nodes are recycled
+        fill(heap, boxes, 0, 5000);
+        fill(pool, boxes, 0, 5000);
+        for (auto &q : queries)
+            REQUIRE(search(pool, q) == search(heap, q));
+    }
+
+    SECTION("RemoveAll") {
+        for (int round = 0; round < 3; ++round) {
+            heap.RemoveAll();
+            pool.RemoveAll();
+            REQUIRE(pool.Count() == 0);
+            REQUIRE(search(pool, queries[0]).empty());
+
+            fill(heap, boxes, round * 1000, round * 1000 + 2000);
+            fill(pool, boxes, round * 1000, round * 1000 + 2000);
+            REQUIRE(pool.Count() == 2000);
+            for (auto &q : queries)
+                REQUIRE(search(pool, q) == search(heap, q));
+        }
+    }
+}
+
+// Chain of internal nodes deeper than MAXDEPTH, the siblings of each link
+// are leaves holding one entry. Insert() would need billions of entries
+// to build a tree this deep.
+class DeepTree : public HeapTree {
+public:
+    explicit DeepTree (int depth) {
+        Node *node = m_root;
+        int id = 0;
+
+        node->m_level = depth - 1;
+        while (node->IsInternalNode()) {
+            node->m_count = MAXNODES;
+            for (int b = 0; b < MAXNODES; ++b) {
+                Branch &branch = node->m_branch[b];
+                branch.m_rect = whole();
+                branch.m_child = AllocNode();
+                branch.m_child->m_count = 0;
+                branch.m_child->m_level = (b == 0 ? node->m_level - 1 : 0);
+                if (b > 0) {
+                    branch.m_child->m_count = 1;
+                    branch.m_child->m_branch[0].m_rect = whole();
+                    branch.m_child->m_branch[0].m_data = id++;
+                }
+            }
+            node = node->m_branch[0].m_child;
+        }
+        nbEntries = id;
+    }
+
+    int nbEntries;
+
+private:
+    static Rect whole () {
+        Rect rect = {{0, 0}, {100, 100}};
+        return rect;
+    }
+};
+
+TEST_CASE("RTree depth", "Trees deeper than MAXDEPTH are searched")
+{
+    DeepTree tree(HeapTree::MAXDEPTH + 8);
+    Box box = {{10, 10}, {20, 20}};
+
+    auto ids = search(tree, box);
+    REQUIRE(ids.size() == (size_t) tree.nbEntries);
+    for (int i = 0; i < tree.nbEntries; ++i)
+        REQUIRE(ids[i] == i);
+
+    // the visitor still stops the search
+    int nbVisited = 0;
+    auto stopAt3 = [&nbVisited](intptr_t &) { return ++nbVisited < 3; };
+    REQUIRE(tree.Visit(box.min, box.max, stopAt3) == 3);
+}
+
+// POPMUSIC inner loop : the sub-problem tree is emptied, refilled with the
+// candidates of the sub-problem, then the search moves labels around
+template <class TREE>
+static long popmusicLoop (TREE &tree, const std::vector<Box> &boxes, int nbIterations, int subSize)
+{
+    long found = 0;
+    int num = (int) boxes.size();
+    int capacity = 0;
+    intptr_t *hits = nullptr;
+
+    for (int it = 0; it < nbIterations; ++it) {
+        int first = (it * 7919) % (num - subSize);
+
+        tree.RemoveAll();
+        fill(tree, boxes, first, first + subSize);
+
+        for (int move = 0; move < subSize / 4; ++move) {
+            int i = first + (move * 31) % subSize;
+            const Box &b = boxes[i];
+            found += tree.Collect(b.min, b.max, &hits, &capacity);
+            tree.Remove(b.min, b.max, i);
+            tree.Insert(b.min, b.max, i);
+        }
+    }
+    delete[] hits;
+    return found;
+}
+
+TEST_CASE("RTree benchmark", "[.][benchmark]")
+{
+    auto boxes = makeBoxes(100000, 42);
+
+    HeapTree heap;
+    PoolTree pool;
+
+    SECTION("POPMUSIC 200 candidates") {
+        BENCHMARK("Heap") {
+            return popmusicLoop(heap, boxes, 100, 200);
+        };
+        BENCHMARK("Pool") {
+            return popmusicLoop(pool, boxes, 100, 200);
+        };
+    }
+    SECTION("POPMUSIC 2000 candidates") {
+        BENCHMARK("Heap") {
+            return popmusicLoop(heap, boxes, 10, 2000);
+        };
+        BENCHMARK("Pool") {
+            return popmusicLoop(pool, boxes, 10, 2000);
+        };
+    }
+}
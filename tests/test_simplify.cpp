@@ -0,0 +1,176 @@
+//
+// Douglas-Peucker simplification of lines and polygons
+//
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include "Geom.h"
+#include "pal/pal.h"
+#include "pal/layer.h"
+#include "pal/label.h"
+#include "coordcache.h"
+#include "pointset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Jagged island, as found in coastlines layers
+static void makeCoast (int num, double cx, double cy, double radius, std::vector<double> &x, std::vector<double> &y)
+{
+    x.resize(num);
+    y.resize(num);
+
+    for (int i = 0; i < num; ++i) {
+        double a = 2 * M_PI * i / num;
+        double r = radius * (1 + 0.1 * sin(7 * a) + 0.01 * sin(97 * a) + 0.002 * sin(1009 * a));
+        x[i] = cx + r * cos(a);
+        y[i] = cy + r * sin(a);
+    }
+}
+
+static std::string coastWkt (int num, double cx, double cy, double radius)
+{
+    std::vector<double> x, y;
+    makeCoast(num, cx, cy, radius, x, y);
+
+    std::ostringstream wkt;
+    wkt.precision(12);
+    wkt << "POLYGON((";
+    for (int i = 0; i <= num; ++i)
+        wkt << (i ? "," : "") << x[i % num] << " " << y[i % num];
+    wkt << "))";
+    return wkt.str();
+}
+
+TEST_CASE("PointSet simplification", "Douglas-Peucker")
+{
+    std::vector<double> x, y;
+    makeCoast(20000, 0, 0, 1000, x, y);
+    pal::PointSet ring(20000, x.data(), y.data());
+
+    SECTION("Tolerance") {
+        const double tolerance = 0.5;
+        pal::PointSet *simple = ring.simplify(tolerance);
+
+        REQUIRE(simple != nullptr);
+        REQUIRE(simple->getNbPoints() >= 3);
+        REQUIRE(simple->getNbPoints() < 20000 / 4);
+        REQUIRE(simple->getType() == ring.getType());
+
+        // removed points stay close to the simplified ring
+        double worst = 0;
+        for (int i = 0; i < 20000; ++i)
+            worst = std::max(worst, simple->getDist(x[i], y[i], nullptr, nullptr));
+        REQUIRE(worst <= tolerance * tolerance + 1e-9);
+
+        delete simple;
+    }
+
+    SECTION("Cache") {
+        pal::CoordCache cache(1 << 20);
+        double *cx = new double[20000];
+        double *cy = new double[20000];
+        std::copy(x.begin(), x.end(), cx);
+        std::copy(y.begin(), y.end(), cy);
+
+        auto geom = reinterpret_cast<pal::PalGeometry*>(&ring);
+        pal::CoordEntry *entry = cache.insert(geom, 0, 20000, cx, cy, 0, nullptr, false, true);
+        size_t size = cache.getSize();
+
+        pal::PointSet **simple = cache.getSimplified(entry, &ring, nullptr, 1);
+        REQUIRE(simple[0] != nullptr);
+        REQUIRE(cache.getSimplified(entry, &ring, nullptr, 1) == simple);
+        REQUIRE(cache.getSize() > size);
+
+        // copies of the first tolerance remain valid while the entry is used
+        int nbPoints = simple[0]->getNbPoints();
+        pal::PointSet **coarse = cache.getSimplified(entry, &ring, nullptr, 2);
+        REQUIRE(coarse[0]->getNbPoints() <= nbPoints);
+        REQUIRE(simple[0]->getNbPoints() == nbPoints);
+        REQUIRE(cache.getSimplified(entry, &ring, nullptr, 1) == simple);
+        size_t bothSize = cache.getSize();
+
+        // only the last tolerance is kept once released
+        cache.release(entry);
+        REQUIRE(cache.getSize() < bothSize);
+        entry = cache.acquire(geom, 0);
+        REQUIRE(cache.getSimplified(entry, &ring, nullptr, 1) == simple);
+        cache.release(entry);
+
+        // freed with the coordinates
+        cache.setMaxSize(0);
+        REQUIRE(cache.getSize() == 0);
+    }
+
+    SECTION("Nothing to remove") {
+        double sx[4] = {0, 10, 10, 0};
+        double sy[4] = {0, 0, 10, 10};
+        pal::PointSet square(4, sx, sy);
+
+        REQUIRE(square.simplify(1) == nullptr);
+    }
+}
+
+// Towns labelled around islands with high-vertex coastlines
+static long labelCoasts (pal::Pal &pal, double scale, double extent)
+{
+    pal::PalStat *stats;
+    double bbox[4] = {0, 0, extent, extent};
+
+    std::list<pal::Label*> *labels = pal.labeller(scale, bbox, &stats, false);
+    long n = labels->size();
+
+    for (auto label : *labels)
+        delete label;
+    delete labels;
+    delete stats;
+    return n;
+}
+
+static void benchCoasts (double tolerance)
+{
+    const int num = 4;
+    const double dx = 10000;
+
+    pal::Pal pal;
+    pal.setCandidateCacheSize(0);
+    pal.setSimplifyTolerance(tolerance);
+
+    pal::Layer *coasts = pal.addLayer("coasts", -1, -1, pal::P_FREE, pal::PIXEL, 0.5, true, true, true);
+    pal::Layer *towns = pal.addLayer("towns", -1, -1, pal::P_POINT, pal::PIXEL, 0.5, false, true, true);
+
+    for (int i = 0; i < num * num; ++i) {
+        double cx = (i % num + 0.5) * dx;
+        double cy = (i / num + 0.5) * dx;
+        std::ostringstream id;
+        id << "C:" << i;
+        coasts->registerFeature(id.str().c_str(), new Geom(coastWkt(20000, cx, cy, dx / 3).c_str()), 60, 20);
+
+        for (int j = 0; j < 8; ++j) {
+            std::ostringstream town, wkt;
+            town << "T:" << i << ":" << j;
+            wkt << "POINT(" << cx + dx / 3 * cos(j) << " " << cy + dx / 3 * sin(j) << ")";
+            towns->registerFeature(town.str().c_str(), new Geom(wkt.str().c_str()), 40, 12);
+        }
+    }
+
+    std::ostringstream name;
+    name << "1:100000, tolerance " << tolerance << " px";
+    BENCHMARK(name.str().c_str()) {
+        return labelCoasts(pal, 100000, num * dx);
+    };
+}
+
+TEST_CASE("Simplification benchmark", "[.][benchmark]")
+{
+    SECTION("Full resolution") {
+        benchCoasts(0);
+    }
+    SECTION("Simplified") {
+        benchCoasts(0.5);
+    }
+}
@@ -0,0 +1,232 @@
+//
+// Layer snapshots
+//
+
+#include <catch2/catch.hpp>
+
+#include "Geom.h"
+#include "pal/pal.h"
+#include "pal/layer.h"
+#include "pal/label.h"
+#include "pal/palexception.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Squares, some of them with a hole, and a few multipolygons
+static std::map<std::string, std::string> makeGeometries ()
+{
+    const int num = 8;
+    const double dx = 100;
+    std::map<std::string, std::string> geometries;
+
+    for (int y = 0; y < num; ++y) {
+        for (int x = 0; x < num; ++x) {
+            std::ostringstream wkt;
+            std::ostringstream id;
+            double x0 = x * dx;
+            double y0 = y * dx;
+
+            id << "S:" << (y * num + x);
+            if ((x + y) % 5 == 0) {
+                wkt << "MULTIPOLYGON(((" << x0 << " " << y0 << "," << x0 + 40 << " " << y0 << ","
+                    << x0 + 40 << " " << y0 + 40 << "," << x0 << " " << y0 + 40 << "," << x0 << " " << y0 << ")),(("
+                    << x0 + 50 << " " << y0 + 50 << "," << x0 + 90 << " " << y0 + 50 << ","
+                    << x0 + 90 << " " << y0 + 90 << "," << x0 + 50 << " " << y0 + 90 << "," << x0 + 50 << " " << y0 + 50 << ")))";
+            } else {
+                wkt << "POLYGON((" << x0 << " " << y0 << "," << x0 + dx << " " << y0 << ","
+                    << x0 + dx << " " << y0 + dx << "," << x0 << " " << y0 + dx << "," << x0 << " " << y0 << ")";
+                if ((x + y) % 3 == 0) {
+                    wkt << ",(" << x0 + 20 << " " << y0 + 20 << "," << x0 + 20 << " " << y0 + 60 << ","
+                        << x0 + 60 << " " << y0 + 60 << "," << x0 + 60 << " " << y0 + 20 << "," << x0 + 20 << " " << y0 + 20 << ")";
+                }
+                wkt << ")";
+            }
+            geometries[id.str()] = wkt.str();
+        }
+    }
+    return geometries;
+}
+
+struct Geometries {
+    std::map<std::string, std::string> wkt;
+    std::vector<std::unique_ptr<Geom>> loaded;
+};
+
+static pal::PalGeometry *getGeometry (const char *geom_id, void *ctx)
+{
+    Geometries *geometries = static_cast<Geometries*>(ctx);
+    auto it = geometries->wkt.find(geom_id);
+    if (it == geometries->wkt.end())
+        return nullptr;
+
+    geometries->loaded.emplace_back(new Geom(it->second.c_str()));
+    return geometries->loaded.back().get();
+}
+
+static std::vector<std::string> label (pal::Pal &pal)
+{
+    pal::PalStat *stats;
+    double bbox[4] = {0, 0, 800, 800};
+
+    std::list<pal::Label*> *labels = pal.labeller(5000, bbox, &stats, false);
+
+    std::vector<std::string> result;
+    for (auto label : *labels) {
+        std::ostringstream line;
+        line.precision(17);
+        line << label->getFeatureId() << " " << label->getOrigX() << " " << label->getOrigY()
+             << " " << label->getRotation();
+        result.push_back(line.str());
+        delete label;
+    }
+    std::sort(result.begin(), result.end());
+
+    delete labels;
+    delete stats;
+    return result;
+}
+
+template <class T>
+static void append (std::string &content, T value)
+{
+    content.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Internal node at the top of a chain of first children, with empty siblings
+static void appendChain (std::string &rtree, int level, int maxNodes)
+{
+    append<int>(rtree, level);
+    append<int>(rtree, level > 0 ? maxNodes : 0);
+    for (int b = 0; level > 0 && b < maxNodes; ++b) {
+        append<double>(rtree, -1e9);
+        append<double>(rtree, -1e9);
+        append<double>(rtree, 1e9);
+        append<double>(rtree, 1e9);
+        if (b == 0) {
+            appendChain(rtree, level - 1, maxNodes);
+        } else {
+            append<int>(rtree, level - 1);
+            append<int>(rtree, 0);
+        }
+    }
+}
+
+// R-tree section of a layer, deeper than any tree the layer would build
+static std::string deepRTree (int depth)
+{
+    const int maxNodes = 8;
+    std::string rtree;
+
+    // RTree<Feature*, double, 2, double> header
+    append<int>(rtree, ('R' << 0) | ('T' << 8) | ('R' << 16) | ('E' << 24));
+    append<int>(rtree, sizeof(void*));
+    append<int>(rtree, 2);
+    append<int>(rtree, sizeof(double));
+    append<int>(rtree, sizeof(double));
+    append<int>(rtree, maxNodes);
+    append<int>(rtree, maxNodes / 2);
+
+    appendChain(rtree, depth - 1, maxNodes);
+    return rtree;
+}
+
+static bool throwsInvalidSnapshot (const char *fileName, Geometries *geometries)
+{
+    pal::Pal pal;
+    try {
+        pal.loadLayer(fileName, getGeometry, geometries);
+    } catch (pal::PalException::InvalidSnapshot *e) {
+        delete e;
+        return true;
+    }
+    return false;
+}
+
+static std::string readFile (const char *fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile (const char *fileName, const std::string &content)
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), content.size());
+}
+
+TEST_CASE("Layer snapshot", "Loaded layers give the labels of registered layers")
+{
+    const char *fileName = "test_snapshot.snap";
+    const char *brokenName = "test_snapshot_broken.snap";
+
+    Geometries geometries;
+    geometries.wkt = makeGeometries();
+
+    std::vector<std::unique_ptr<Geom>> registered;
+    pal::Pal pal;
+    pal::Layer *layer = pal.addLayer("squares", -1, -1, pal::P_FREE, pal::PIXEL, 0.5, true, true, true);
+    for (auto &g : geometries.wkt) {
+        registered.emplace_back(new Geom(g.second.c_str()));
+        layer->registerFeature(g.first.c_str(), registered.back().get(), 60, 20);
+    }
+
+    auto reference = label(pal);
+    REQUIRE_FALSE(reference.empty());
+
+    SECTION("With coordinates") {
+        layer->saveSnapshot(fileName, true);
+        {
+            pal::Pal loaded;
+            loaded.loadLayer(fileName);
+            REQUIRE(label(loaded) == reference);
+        }
+        std::remove(fileName);
+    }
+
+    SECTION("Without coordinates") {
+        layer->saveSnapshot(fileName, false);
+        {
+            pal::Pal loaded;
+            loaded.loadLayer(fileName, getGeometry, &geometries);
+            REQUIRE(label(loaded) == reference);
+        }
+        std::remove(fileName);
+    }
+
+    SECTION("Broken files") {
+        layer->saveSnapshot(fileName, true);
+        std::string content = readFile(fileName);
+        REQUIRE(content.size() > 64);
+
+        writeFile(brokenName, content.substr(0, content.size() / 2));
+        CHECK(throwsInvalidSnapshot(brokenName, &geometries));
+
+        writeFile(brokenName, content.substr(0, 16));
+        CHECK(throwsInvalidSnapshot(brokenName, &geometries));
+
+        std::string badMagic = content;
+        badMagic[0] = 'X';
+        writeFile(brokenName, badMagic);
+        CHECK(throwsInvalidSnapshot(brokenName, &geometries));
+
+        pal::SnapshotHeader header;
+        memcpy(&header, content.data(), sizeof(header));
+        writeFile(brokenName, content.substr(0, header.rtree) + deepRTree(60));
+        CHECK(throwsInvalidSnapshot(brokenName, &geometries));
+
+        CHECK(throwsInvalidSnapshot("test_snapshot_missing.snap", &geometries));
+
+        std::remove(brokenName);
+        std::remove(fileName);
+    }
+}